@@ -0,0 +1,262 @@
+#include <JuceHeader.h>
+#include "TSAllocationTrap.h"
+
+#if TS_TRAP_RT_ALLOCATIONS
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+#if defined (_MSC_VER)
+ #include <malloc.h>
+#endif
+
+#if TS_TRAP_CRT_HOOK
+ #include <crtdbg.h>
+#endif
+
+namespace
+{
+   #if defined (__GNUC__)
+    // initial-exec keeps the TLS access itself from ever calling malloc.
+    __attribute__ ((tls_model ("initial-exec"))) static thread_local int trapDepth = 0;
+   #else
+    static thread_local int trapDepth = 0;
+   #endif
+
+    std::atomic<int> numViolations { 0 };
+
+    inline void noteHeapActivity() noexcept
+    {
+        if (trapDepth > 0)
+        {
+            numViolations.fetch_add (1, std::memory_order_relaxed);
+
+            // Disarm while reporting, the assertion's own logging may allocate.
+            const auto depth = trapDepth;
+            trapDepth = 0;
+            jassertfalse; // heap allocation or release on the audio thread
+            trapDepth = depth;
+        }
+    }
+}
+
+#if TS_TRAP_CRT_HOOK
+// Every malloc, realloc and free of the debug CRT passes here, operator new's included
+namespace
+{
+    _CRT_ALLOC_HOOK previousAllocHook = nullptr;
+
+    int __cdecl allocHook (int allocType, void* userData, size_t size, int blockType, long requestNumber,
+                           const unsigned char* fileName, int lineNumber)
+    {
+        // The CRT's own bookkeeping blocks are not ours
+        if (blockType != _CRT_BLOCK)
+            noteHeapActivity();
+
+        return previousAllocHook != nullptr ? previousAllocHook (allocType, userData, size, blockType, requestNumber, fileName, lineNumber)
+                                            : 1;
+    }
+
+    const bool allocHookInstalled = [] { previousAllocHook = _CrtSetAllocHook (allocHook); return true; }();
+}
+#endif
+
+AllocationTrap::Scope::Scope() noexcept    { ++trapDepth; }
+AllocationTrap::Scope::~Scope() noexcept   { --trapDepth; }
+
+int AllocationTrap::getNumViolations() noexcept
+{
+    return numViolations.load (std::memory_order_relaxed);
+}
+
+//==============================================================================
+#if TS_TRAP_MALLOC
+
+#if ! defined (__GLIBC__)
+ #error "TS_TRAP_MALLOC interposes glibc's malloc; build without it on other C libraries"
+#endif
+
+// Executables only (see TSAllocationTrap.h). operator new comes here through malloc.
+extern "C"
+{
+    void* __libc_malloc (size_t);
+    void* __libc_calloc (size_t, size_t);
+    void* __libc_realloc (void*, size_t);
+    void* __libc_memalign (size_t, size_t);
+    void* __libc_valloc (size_t);
+    void* __libc_pvalloc (size_t);
+    void  __libc_free (void*);
+
+    void* malloc (size_t size)
+    {
+        noteHeapActivity();
+        return __libc_malloc (size);
+    }
+
+    void* calloc (size_t num, size_t size)
+    {
+        noteHeapActivity();
+        return __libc_calloc (num, size);
+    }
+
+    void* realloc (void* ptr, size_t size)
+    {
+        noteHeapActivity();
+        return __libc_realloc (ptr, size);
+    }
+
+    // Aligned operator new, juce::HeapBlock's aligned cousins and SIMD buffers come here
+    int posix_memalign (void** result, size_t alignment, size_t size)
+    {
+        if (alignment % sizeof (void*) != 0 || (alignment & (alignment - 1)) != 0)
+            return EINVAL;
+
+        noteHeapActivity();
+
+        if (auto* ptr = __libc_memalign (alignment, size))
+        {
+            *result = ptr;
+            return 0;
+        }
+
+        return ENOMEM;
+    }
+
+    void* aligned_alloc (size_t alignment, size_t size)
+    {
+        noteHeapActivity();
+        return __libc_memalign (alignment, size);
+    }
+
+    void* memalign (size_t alignment, size_t size)
+    {
+        noteHeapActivity();
+        return __libc_memalign (alignment, size);
+    }
+
+    void* valloc (size_t size)
+    {
+        noteHeapActivity();
+        return __libc_valloc (size);
+    }
+
+    void* pvalloc (size_t size)
+    {
+        noteHeapActivity();
+        return __libc_pvalloc (size);
+    }
+
+    void free (void* ptr)
+    {
+        if (ptr != nullptr)
+            noteHeapActivity();
+
+        __libc_free (ptr);
+    }
+}
+
+#else
+
+// With the CRT hook, operator new and delete are counted where they reach malloc and free
+#if TS_TRAP_CRT_HOOK
+ #define TS_NOTE_OPERATOR_NEW
+#else
+ #define TS_NOTE_OPERATOR_NEW noteHeapActivity();
+#endif
+
+namespace
+{
+    void* allocateAligned (std::size_t size, std::align_val_t alignment) noexcept
+    {
+        const auto bytes = size != 0 ? size : 1;
+
+       #if defined (_MSC_VER)
+        return _aligned_malloc (bytes, static_cast<std::size_t> (alignment));
+       #else
+        void* ptr = nullptr;
+        return posix_memalign (&ptr, std::max (sizeof (void*), static_cast<std::size_t> (alignment)), bytes) == 0 ? ptr : nullptr;
+       #endif
+    }
+
+    void releaseAligned (void* ptr) noexcept
+    {
+       #if defined (_MSC_VER)
+        _aligned_free (ptr);
+       #else
+        std::free (ptr);
+       #endif
+    }
+}
+
+void* operator new (std::size_t size)
+{
+    TS_NOTE_OPERATOR_NEW
+
+    if (auto* ptr = std::malloc (size != 0 ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size)                                   { return operator new (size); }
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept     { TS_NOTE_OPERATOR_NEW return std::malloc (size != 0 ? size : 1); }
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept   { TS_NOTE_OPERATOR_NEW return std::malloc (size != 0 ? size : 1); }
+
+void* operator new (std::size_t size, std::align_val_t alignment)
+{
+    TS_NOTE_OPERATOR_NEW
+
+    if (auto* ptr = allocateAligned (size, alignment))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size, std::align_val_t alignment)                                  { return operator new (size, alignment); }
+void* operator new (std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept    { TS_NOTE_OPERATOR_NEW return allocateAligned (size, alignment); }
+void* operator new[] (std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept  { TS_NOTE_OPERATOR_NEW return allocateAligned (size, alignment); }
+
+void operator delete (void* ptr) noexcept
+{
+   #if ! TS_TRAP_CRT_HOOK
+    if (ptr != nullptr)
+        noteHeapActivity();
+   #endif
+
+    std::free (ptr);
+}
+
+void operator delete[] (void* ptr) noexcept                                       { operator delete (ptr); }
+void operator delete (void* ptr, std::size_t) noexcept                            { operator delete (ptr); }
+void operator delete[] (void* ptr, std::size_t) noexcept                          { operator delete (ptr); }
+void operator delete (void* ptr, const std::nothrow_t&) noexcept                  { operator delete (ptr); }
+void operator delete[] (void* ptr, const std::nothrow_t&) noexcept                { operator delete (ptr); }
+
+void operator delete (void* ptr, std::align_val_t) noexcept
+{
+   #if ! TS_TRAP_CRT_HOOK
+    if (ptr != nullptr)
+        noteHeapActivity();
+   #endif
+
+    releaseAligned (ptr);
+}
+
+void operator delete[] (void* ptr, std::align_val_t alignment) noexcept                          { operator delete (ptr, alignment); }
+void operator delete (void* ptr, std::size_t, std::align_val_t alignment) noexcept               { operator delete (ptr, alignment); }
+void operator delete[] (void* ptr, std::size_t, std::align_val_t alignment) noexcept             { operator delete (ptr, alignment); }
+void operator delete (void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept     { operator delete (ptr, alignment); }
+void operator delete[] (void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept   { operator delete (ptr, alignment); }
+
+#endif
+
+#else
+
+AllocationTrap::Scope::Scope() noexcept    {}
+AllocationTrap::Scope::~Scope() noexcept   {}
+
+int AllocationTrap::getNumViolations() noexcept    { return 0; }
+
+#endif
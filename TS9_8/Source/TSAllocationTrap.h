@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+
+// Debug/test aid for keeping the audio callback allocation-free.
+//
+// Build with TS_TRAP_RT_ALLOCATIONS=1 (the plugin's and TSBench's Debug
+// configurations do this) and every heap allocation or release made by a
+// thread while an AllocationTrap::Scope is alive on it is counted and raises a
+// jassert. processBlock() opens a scope for its whole body, so any change that
+// quietly brings an allocation back onto the audio thread is caught the first
+// time the code runs; `TSBench allocations` runs processBlock through every
+// setting and fails if anything was.
+//
+// The global operator new/delete are replaced, which in a plugin catches the
+// plugin's own allocations and leaves the host's alone. On Linux that needs the
+// plugin linked with -Wl,-Bsymbolic-functions, or its calls resolve to the
+// host's operator new and nothing is trapped.
+//
+// The replacements include the C++17 aligned and nothrow forms. juce::HeapBlock
+// and AudioBuffer::setSize() call malloc directly, though, which only these catch:
+//
+//  - MSVC Debug builds (_DEBUG) hook the debug CRT with _CrtSetAllocHook, which
+//    sees every malloc, realloc and free, operator new's included. With the
+//    DLL runtime that is the whole process's heap, but only a thread inside a
+//    Scope is counted, so the host's allocations elsewhere are left alone.
+//
+//  - An executable can interpose the malloc family on glibc with
+//    TS_TRAP_MALLOC=1, the aligned allocators (posix_memalign, aligned_alloc,
+//    memalign) included. Never in a plugin: from a dlopen'ed library that
+//    would take over the host's allocator, or be bypassed by it.
+
+#ifndef TS_TRAP_RT_ALLOCATIONS
+ #define TS_TRAP_RT_ALLOCATIONS 0
+#endif
+
+#ifndef TS_TRAP_MALLOC
+ #define TS_TRAP_MALLOC 0
+#endif
+
+#ifndef TS_TRAP_CRT_HOOK
+ #if defined (_MSC_VER) && defined (_DEBUG)
+  #define TS_TRAP_CRT_HOOK 1
+ #else
+  #define TS_TRAP_CRT_HOOK 0
+ #endif
+#endif
+
+struct AllocationTrap
+{
+    // Arms the trap for the calling thread until it goes out of scope.
+    struct Scope
+    {
+        Scope() noexcept;
+        ~Scope() noexcept;
+
+        Scope (const Scope&) = delete;
+        Scope& operator= (const Scope&) = delete;
+    };
+
+    // False when built without TS_TRAP_RT_ALLOCATIONS, when nothing is counted
+    static constexpr bool isEnabled() noexcept    { return TS_TRAP_RT_ALLOCATIONS != 0; }
+
+    // Total number of allocations/releases trapped so far, on any thread.
+    static int getNumViolations() noexcept;
+};
+
+#if TS_TRAP_RT_ALLOCATIONS
+ #define TS_SCOPED_ALLOCATION_TRAP AllocationTrap::Scope allocationTrapScope;
+#else
+ #define TS_SCOPED_ALLOCATION_TRAP
+#endif
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "TSCircuit.h"
+
+// One second order section per lane, for many independent streams at once.
+//
+// Coefficients and state are arrays indexed by lane and the samples are
+// interleaved in frames (frame n holds sample n of every lane), so the inner
+// loop carries nothing from one lane to the next and vectorises for any lane
+// count. Transposed direct form II, like dsp::IIR::Filter:
+//
+//     y = b0 x + s1,  s1 = b1 x - a1 y + s2,  s2 = b2 x - a2 y
+template <typename SampleType>
+class BiquadBank
+{
+public:
+    // Allocates. Every lane starts as a pass through.
+    void prepare (size_t numLanes)
+    {
+        lanes = numLanes;
+
+        for (auto* array : { &b1, &b2, &a1, &a2, &s1, &s2 })
+            array->assign (lanes, SampleType (0));
+
+        b0.assign (lanes, SampleType (1));
+    }
+
+    void release()
+    {
+        for (auto* array : { &b0, &b1, &b2, &a1, &a2, &s1, &s2 })
+            std::vector<SampleType>().swap (*array);
+
+        lanes = 0;
+    }
+
+    void reset() noexcept
+    {
+        std::fill (s1.begin(), s1.end(), SampleType (0));
+        std::fill (s2.begin(), s2.end(), SampleType (0));
+    }
+
+    size_t getNumLanes() const noexcept    { return lanes; }
+
+    void setCoefficients (size_t lane, const BiquadCoefficients& c) noexcept
+    {
+        b0[lane] = SampleType (c.b0);
+        b1[lane] = SampleType (c.b1);
+        b2[lane] = SampleType (c.b2);
+        a1[lane] = SampleType (c.a1);
+        a2[lane] = SampleType (c.a2);
+    }
+
+    // Scales what the lane has stored, as when its b coefficients are scaled by
+    // the same factor mid stream
+    void scaleState (size_t lane, SampleType factor) noexcept
+    {
+        s1[lane] *= factor;
+        s2[lane] *= factor;
+    }
+
+    // input and output may be the same frames
+    void process (const SampleType* input, SampleType* output, size_t numFrames) noexcept
+    {
+        const auto* B0 = b0.data();
+        const auto* B1 = b1.data();
+        const auto* B2 = b2.data();
+        const auto* A1 = a1.data();
+        const auto* A2 = a2.data();
+        auto* S1 = s1.data();
+        auto* S2 = s2.data();
+
+        for (size_t n = 0; n < numFrames; ++n)
+        {
+            const auto* x = input + n * lanes;
+            auto* y = output + n * lanes;
+
+            for (size_t lane = 0; lane < lanes; ++lane)
+            {
+                const auto in = x[lane];
+                const auto out = B0[lane] * in + S1[lane];
+
+                S1[lane] = B1[lane] * in - A1[lane] * out + S2[lane];
+                S2[lane] = B2[lane] * in - A2[lane] * out;
+                y[lane] = out;
+            }
+        }
+    }
+
+private:
+    std::vector<SampleType> b0, b1, b2, a1, a2;
+    std::vector<SampleType> s1, s2;
+    size_t lanes = 0;
+};
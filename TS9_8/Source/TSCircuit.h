@@ -0,0 +1,247 @@
+#pragma once
+
+// Component values of the modelled pedal and the closed form bilinear transform
+// designs of its two filter stages. Kept free of JUCE so the designs can be
+// evaluated anywhere (coefficient tables, tools).
+
+#include <algorithm>
+#include <cmath>
+
+//==============================================================================
+// Circuit values for the OpAmp drive section
+struct DriveStageValues
+{
+    float Rpot = 550E3f; // normally 500
+    float Rf = 51E3f;
+    float Cf = 51E-12f;
+    float R1 = 4700.0f;
+    float C1 = 0.047E-6f;
+};
+
+// Circuit values for the OpAmp tone section
+struct ToneStageValues
+{
+    float Rf = 1E3f;
+    float Rpot = 20E3f;
+    float R10k = 10E3f;
+    float R1k = 1E3f;
+    float R220 = 220.0f;
+    float C4 = 0.22E-6f;
+    float Ctone = 0.22E-6f;
+};
+
+//==============================================================================
+// Normalised biquad coefficients (a0 == 1), in the order dsp::IIR::Coefficients stores them.
+// Kept in double so the double precision path gets the full pole placement; the
+// float path rounds them as it loads its filters.
+struct BiquadCoefficients
+{
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+};
+
+// Drive stage: non-inverting gain 1 + Zf / Z1 with Zf = (Rf + drive * Rpot) || Cf
+// and Z1 = R1 + 1 / sC1. Evaluated in double, the C * R * Fs^2 products span
+// too many decades to be formed accurately in float.
+//
+// The products of component values alone are gathered first, so a circuit known
+// at compile time has them folded (see the Circuit overloads below).
+struct DriveFilterTerms
+{
+    double Rf, Rpot, C1, Cf, C1R1, C1CfR1;
+};
+
+constexpr DriveFilterTerms getDriveFilterTerms (const DriveStageValues& c) noexcept
+{
+    return { double (c.Rf), double (c.Rpot), double (c.C1), double (c.Cf),
+             double (c.C1) * double (c.R1),
+             double (c.C1) * double (c.Cf) * double (c.R1) };
+}
+
+inline BiquadCoefficients designDriveFilter (const DriveFilterTerms& t, double drive, double sampleRate) noexcept
+{
+    const double k = 2.0 * sampleRate;
+    const double Rdrive = t.Rpot * drive + t.Rf;
+
+    const double A = t.C1CfR1 * Rdrive * k * k;
+    const double p = t.C1R1 * k;
+    const double q = t.C1 * Rdrive * k;
+    const double r = t.Cf * Rdrive * k;
+
+    const double b0 =  A + p + q + r + 1.0;
+    const double b1 = -2.0 * A + 2.0;
+    const double b2 =  A - p - q - r + 1.0;
+
+    const double a0 =  A + p + r + 1.0;
+    const double a1 = -2.0 * A + 2.0;
+    const double a2 =  A - p - r + 1.0;
+
+    return { b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0 };
+}
+
+inline BiquadCoefficients designDriveFilter (const DriveStageValues& c, double drive, double sampleRate) noexcept
+{
+    return designDriveFilter (getDriveFilterTerms (c), drive, sampleRate);
+}
+
+// Tone stage: the tone pot splits into Rpot1 = tone * Rpot and Rpot2 = (1 - tone) * Rpot,
+// which always sum to Rpot
+struct ToneFilterTerms
+{
+    double Rf, Rpot, R220Rpot, CtoneR10k, N0, C4CtoneR10kR1k, C4R10kR1kRpot, CtoneR10kR1k, CtoneR10kPlusR1k, D0;
+};
+
+constexpr ToneFilterTerms getToneFilterTerms (const ToneStageValues& c) noexcept
+{
+    const double R10k = c.R10k;
+    const double R1k = c.R1k;
+    const double S = c.Rpot;
+
+    return { double (c.Rf), S, double (c.R220) * S,
+             double (c.Ctone) * R10k,
+             R10k * S,
+             double (c.C4) * double (c.Ctone) * R10k * R1k,
+             double (c.C4) * R10k * R1k * S,
+             double (c.Ctone) * R10k * R1k,
+             double (c.Ctone) * (R10k + R1k),
+             (R10k + R1k) * S };
+}
+
+inline BiquadCoefficients designToneFilter (const ToneFilterTerms& t, double tone, double sampleRate) noexcept
+{
+    const double k = 2.0 * sampleRate;
+    const double Rpot1 = t.Rpot * tone;
+    const double Rpot2 = t.Rpot * (1.0 - tone);
+    const double Q = t.R220Rpot + Rpot1 * Rpot2;
+
+    const double N1 = t.CtoneR10k * k * (Q + t.Rf * Rpot1);
+    const double N0 = t.N0;
+
+    const double D2 = t.C4CtoneR10kR1k * Q * k * k;
+    const double D1 = k * (t.C4R10kR1kRpot + t.CtoneR10kR1k * Rpot2 + t.CtoneR10kPlusR1k * Q);
+    const double D0 = t.D0;
+
+    const double b0 =  N1 + N0;
+    const double b1 =  2.0 * N0;
+    const double b2 = -N1 + N0;
+
+    const double a0 =  D2 + D1 + D0;
+    const double a1 = -2.0 * D2 + 2.0 * D0;
+    const double a2 =  D2 - D1 + D0;
+
+    return { b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0 };
+}
+
+inline BiquadCoefficients designToneFilter (const ToneStageValues& c, double tone, double sampleRate) noexcept
+{
+    return designToneFilter (getToneFilterTerms (c), tone, sampleRate);
+}
+
+// Straight line between two designs, as the coefficient tables and model
+// switches blend them; between neighbouring stable designs it stays stable
+inline BiquadCoefficients interpolateCoefficients (const BiquadCoefficients& a, const BiquadCoefficients& b, double alpha) noexcept
+{
+    return { a.b0 + alpha * (b.b0 - a.b0),
+             a.b1 + alpha * (b.b1 - a.b1),
+             a.b2 + alpha * (b.b2 - a.b2),
+             a.a1 + alpha * (b.a1 - a.a1),
+             a.a2 + alpha * (b.a2 - a.a2) };
+}
+
+//==============================================================================
+// Output network after the level pot: Rseries to the jack and Rground from the
+// jack to ground, into the input of whatever follows
+struct OutputStageValues
+{
+    float Rseries = 100.0f;
+    float Rground = 10E3f;
+    float Rload = 1E6f; // a typical amp input
+};
+
+constexpr double getOutputGain (const OutputStageValues& c) noexcept
+{
+    const double shunt = double (c.Rground) * double (c.Rload) / (double (c.Rground) + double (c.Rload));
+    return shunt / (double (c.Rseries) + shunt);
+}
+
+//==============================================================================
+// The pedal variants, each a compile time description of the whole circuit.
+// The TS808 and TS9 share their drive and tone sections and differ in the output
+// network; the custom circuit is this plugin's own, with a larger drive pot and
+// no output network, as it has always sounded.
+struct TS808Circuit
+{
+    static constexpr const char* name = "TS808";
+    static constexpr DriveStageValues drive { 500E3f, 51E3f, 51E-12f, 4700.0f, 0.047E-6f };
+    static constexpr ToneStageValues tone {};
+    static constexpr OutputStageValues output { 100.0f, 10E3f, 1E6f };
+};
+
+struct TS9Circuit
+{
+    static constexpr const char* name = "TS9";
+    static constexpr DriveStageValues drive { 500E3f, 51E3f, 51E-12f, 4700.0f, 0.047E-6f };
+    static constexpr ToneStageValues tone {};
+    static constexpr OutputStageValues output { 470.0f, 100E3f, 1E6f };
+};
+
+struct CustomCircuit
+{
+    static constexpr const char* name = "Custom";
+    static constexpr DriveStageValues drive {};
+    static constexpr ToneStageValues tone {};
+    static constexpr OutputStageValues output { 0.0f, 10E3f, 1E6f };
+};
+
+enum class CircuitModel
+{
+    ts808,
+    ts9,
+    custom
+};
+
+constexpr int numCircuitModels = 3;
+
+// Calls function with a default constructed description of the model's circuit
+template <typename Function>
+decltype (auto) visitCircuit (CircuitModel model, Function&& function)
+{
+    switch (model)
+    {
+        case CircuitModel::ts808:   return function (TS808Circuit());
+        case CircuitModel::ts9:     return function (TS9Circuit());
+        default:                    return function (CustomCircuit());
+    }
+}
+
+// The designs with the circuit as a template parameter: every product of
+// component values is a compile time constant, leaving only the terms that
+// depend on the parameter and the rate
+template <typename Circuit>
+BiquadCoefficients designDriveFilter (double drive, double sampleRate) noexcept
+{
+    static constexpr DriveFilterTerms terms = getDriveFilterTerms (Circuit::drive);
+    return designDriveFilter (terms, drive, sampleRate);
+}
+
+template <typename Circuit>
+BiquadCoefficients designToneFilter (double tone, double sampleRate) noexcept
+{
+    static constexpr ToneFilterTerms terms = getToneFilterTerms (Circuit::tone);
+    return designToneFilter (terms, tone, sampleRate);
+}
+
+//==============================================================================
+// Samples until the impulse response of a stable biquad has decayed by
+// attenuationDb, from the radius of its slowest pole
+inline double getDecaySamples (const BiquadCoefficients& c, double attenuationDb) noexcept
+{
+    const double discriminant = c.a1 * c.a1 - 4.0 * c.a2;
+
+    const double radius = discriminant < 0.0 ? std::sqrt (c.a2)
+                                             : 0.5 * (std::abs (c.a1) + std::sqrt (discriminant));
+
+    if (radius <= 0.0)
+        return 2.0;
+
+    return std::max (2.0, attenuationDb / (-20.0 * std::log10 (std::min (radius, 1.0 - 1.0e-12))));
+}
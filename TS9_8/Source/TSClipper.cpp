@@ -0,0 +1,754 @@
+#include "TSClipper.h"
+#include "TSFastMath.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#if defined (__x86_64__) || defined (_M_X64)
+ #define TS_CLIPPER_X86 1
+ #include <immintrin.h>
+ #if defined (_MSC_VER) && ! defined (__clang__)
+  #include <intrin.h>
+  #define TS_TARGET_AVX2
+ #else
+  #define TS_TARGET_AVX2 __attribute__ ((target ("avx2")))
+ #endif
+#else
+ #define TS_CLIPPER_X86 0
+#endif
+
+namespace
+{
+    // Above this sqrt (u^2 + 1) == u in float, and u^2 would eventually overflow
+    constexpr float largeArgument = 4294967296.0f; // 2^32
+
+    using FastMath::ln2;
+    using FastMath::sqrtHalfBits;
+    using FastMath::floatToBits;
+
+    // Series coefficients of 2 * atanh (t) / t in t^2, as in FastMath::log
+    constexpr float c1 = 2.0f / 3.0f;
+    constexpr float c2 = 2.0f / 5.0f;
+    constexpr float c3 = 2.0f / 7.0f;
+
+    //==============================================================================
+    // log (1 + j / size) and the step to the next entry, indexed by the top
+    // mantissa bits. Depends on nothing, so it is filled once at load time.
+    struct MantissaLogTable
+    {
+        static constexpr int indexBits = 8;
+        static constexpr int size = 1 << indexBits;
+        static constexpr int fractionBits = 23 - indexBits;
+        static constexpr uint32_t fractionMask = (1u << fractionBits) - 1;
+        static constexpr float fractionScale = 1.0f / float (1u << fractionBits);
+
+        MantissaLogTable() noexcept
+        {
+            for (int j = 0; j < size; ++j)
+            {
+                const auto lo = std::log1p (double (j) / size);
+                const auto hi = std::log1p (double (j + 1) / size);
+
+                base[j] = float (lo);
+                slope[j] = float (hi - lo);
+            }
+        }
+
+        float base[size];
+        float slope[size];
+    };
+
+    const MantissaLogTable mantissaLogTable;
+
+    // Below 1000 * (2 * Is * R2) log (2u) no longer matches asinh (u), but the
+    // limit passes x through unchanged there anyway
+    constexpr float tableThresholdRatio = 1000.0f;
+
+    struct TableParameters
+    {
+        float offset;
+        float threshold;
+    };
+
+    inline TableParameters getTableParameters (float R2) noexcept
+    {
+        const auto k = 2.0 * double (DiodeClipper::Is) * double (R2);
+        return { float (double (DiodeClipper::nvt) * std::log (2.0 / k)), float (tableThresholdRatio * k) };
+    }
+
+    // log (w) for positive normal w
+    inline float tableLog (float w) noexcept
+    {
+        const auto bits = floatToBits (w);
+        const auto exponent = float (int32_t (bits >> 23) - 127);
+        const auto index = (bits >> MantissaLogTable::fractionBits) & (MantissaLogTable::size - 1);
+        const auto fraction = float (bits & MantissaLogTable::fractionMask) * MantissaLogTable::fractionScale;
+
+        return mantissaLogTable.base[index] + fraction * mantissaLogTable.slope[index] + exponent * ln2;
+    }
+}
+
+//==============================================================================
+void DiodeClipper::LaneParameters::resize (size_t numLanes, float R2)
+{
+    invK.resize (numLanes);
+    tableOffset.resize (numLanes);
+    tableThreshold.resize (numLanes);
+
+    for (size_t lane = 0; lane < numLanes; ++lane)
+        set (lane, R2);
+}
+
+void DiodeClipper::LaneParameters::set (size_t lane, float R2) noexcept
+{
+    const auto table = getTableParameters (R2);
+
+    invK[lane] = 1.0f / (2.0f * Is * R2);
+    tableOffset[lane] = table.offset;
+    tableThreshold[lane] = table.threshold;
+}
+
+//==============================================================================
+float DiodeClipper::fastAsinh (float u) noexcept
+{
+    const auto root = u < largeArgument ? std::sqrt (u * u + 1.0f) : u;
+    return FastMath::log (u + root);
+}
+
+double DiodeClipper::getLimitVoltage (double R2) noexcept
+{
+    // x = nvt * asinh (x / k) by fixed point iteration: the slope there is about
+    // nvt / x, so each step gains more than a digit, and 0 is an unstable root
+    const auto invK = 1.0 / (2.0 * double (Is) * R2);
+    auto x = 0.6;
+
+    for (int i = 0; i < 4; ++i)
+        x = double (nvt) * std::asinh (x * invK);
+
+    return x;
+}
+
+void DiodeClipper::processReference (const float* input, float* destination, size_t numSamples, float R2) noexcept
+{
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+        auto U = nvt * std::asinh (input[i] / (2.0f * Is * R2));
+
+        if (std::fabs (U) > std::fabs (input[i]))
+            U = input[i];
+
+        destination[i] += U;
+    }
+}
+
+void DiodeClipper::processDouble (const double* input, double* destination, size_t numSamples, double R2) noexcept
+{
+    const auto invK = 1.0 / (2.0 * double (Is) * R2);
+
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+        const auto x = input[i];
+        const auto ax = std::fabs (x);
+        const auto U = std::min (ax, double (nvt) * std::asinh (ax * invK));
+
+        destination[i] += std::copysign (U, x);
+    }
+}
+
+void DiodeClipper::processScalar (const float* input, float* destination, size_t numSamples, float R2) noexcept
+{
+    const auto invK = 1.0f / (2.0f * Is * R2);
+
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+        const auto x = input[i];
+        const auto ax = std::fabs (x);
+        const auto U = std::min (ax, nvt * fastAsinh (ax * invK));
+
+        destination[i] += std::copysign (U, x);
+    }
+}
+
+void DiodeClipper::processTableScalar (const float* input, float* destination, size_t numSamples, float R2) noexcept
+{
+    const auto table = getTableParameters (R2);
+
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+        const auto x = input[i];
+        const auto ax = std::fabs (x);
+        const auto U = ax < table.threshold ? ax : std::min (ax, nvt * tableLog (ax) + table.offset);
+
+        destination[i] += std::copysign (U, x);
+    }
+}
+
+void DiodeClipper::processDoubleFrames (const double* input, double* destination, size_t numFrames, size_t numLanes,
+                                        const double* inverseK) noexcept
+{
+    for (size_t n = 0; n < numFrames; ++n)
+    {
+        const auto* x = input + n * numLanes;
+        auto* y = destination + n * numLanes;
+
+        for (size_t lane = 0; lane < numLanes; ++lane)
+        {
+            const auto ax = std::fabs (x[lane]);
+            const auto U = std::min (ax, double (nvt) * std::asinh (ax * inverseK[lane]));
+
+            y[lane] += std::copysign (U, x[lane]);
+        }
+    }
+}
+
+//==============================================================================
+namespace
+{
+    // Frame versions of the portable kernels. Rows are processed whole, so the
+    // loops have nothing carried between lanes.
+    void processReferenceFrames (const float* input, float* destination, size_t numFrames, size_t numLanes,
+                                 const DiodeClipper::LaneParameters& parameters) noexcept
+    {
+        const auto* invK = parameters.invK.data();
+
+        for (size_t n = 0; n < numFrames; ++n)
+        {
+            const auto* x = input + n * numLanes;
+            auto* y = destination + n * numLanes;
+
+            for (size_t lane = 0; lane < numLanes; ++lane)
+            {
+                auto U = DiodeClipper::nvt * std::asinh (x[lane] * invK[lane]);
+
+                if (std::fabs (U) > std::fabs (x[lane]))
+                    U = x[lane];
+
+                y[lane] += U;
+            }
+        }
+    }
+
+    void processScalarFrames (const float* input, float* destination, size_t numFrames, size_t numLanes,
+                              const DiodeClipper::LaneParameters& parameters) noexcept
+    {
+        const auto* invK = parameters.invK.data();
+
+        for (size_t n = 0; n < numFrames; ++n)
+        {
+            const auto* x = input + n * numLanes;
+            auto* y = destination + n * numLanes;
+
+            for (size_t lane = 0; lane < numLanes; ++lane)
+            {
+                const auto ax = std::fabs (x[lane]);
+                const auto U = std::min (ax, DiodeClipper::nvt * DiodeClipper::fastAsinh (ax * invK[lane]));
+
+                y[lane] += std::copysign (U, x[lane]);
+            }
+        }
+    }
+
+    void processTableScalarFrames (const float* input, float* destination, size_t numFrames, size_t numLanes,
+                                   const DiodeClipper::LaneParameters& parameters) noexcept
+    {
+        const auto* offset = parameters.tableOffset.data();
+        const auto* threshold = parameters.tableThreshold.data();
+
+        for (size_t n = 0; n < numFrames; ++n)
+        {
+            const auto* x = input + n * numLanes;
+            auto* y = destination + n * numLanes;
+
+            for (size_t lane = 0; lane < numLanes; ++lane)
+            {
+                const auto ax = std::fabs (x[lane]);
+                const auto U = ax < threshold[lane] ? ax : std::min (ax, DiodeClipper::nvt * tableLog (ax) + offset[lane]);
+
+                y[lane] += std::copysign (U, x[lane]);
+            }
+        }
+    }
+}
+
+//==============================================================================
+#if TS_CLIPPER_X86
+
+namespace
+{
+    // Clipped voltage for four samples, with the sign of x
+    inline __m128 clipSse2 (__m128 x, __m128 invK) noexcept
+    {
+        const auto signMask = _mm_set1_ps (-0.0f);
+        const auto sign = _mm_and_ps (x, signMask);
+        const auto ax = _mm_andnot_ps (signMask, x);
+
+        const auto u = _mm_mul_ps (ax, invK);
+        const auto isLarge = _mm_cmpge_ps (u, _mm_set1_ps (largeArgument));
+        const auto root = _mm_or_ps (_mm_and_ps (isLarge, u),
+                                     _mm_andnot_ps (isLarge, _mm_sqrt_ps (_mm_add_ps (_mm_mul_ps (u, u), _mm_set1_ps (1.0f)))));
+
+        const auto U = _mm_min_ps (ax, _mm_mul_ps (_mm_set1_ps (DiodeClipper::nvt), FastMath::log (_mm_add_ps (u, root))));
+        return _mm_or_ps (U, sign);
+    }
+
+    void processSse2 (const float* input, float* destination, size_t numSamples, float R2) noexcept
+    {
+        const auto invK = _mm_set1_ps (1.0f / (2.0f * DiodeClipper::Is * R2));
+
+        size_t i = 0;
+
+        for (; i + 4 <= numSamples; i += 4)
+            _mm_storeu_ps (destination + i, _mm_add_ps (_mm_loadu_ps (destination + i), clipSse2 (_mm_loadu_ps (input + i), invK)));
+
+        DiodeClipper::processScalar (input + i, destination + i, numSamples - i, R2);
+    }
+
+    void processFramesSse2 (const float* input, float* destination, size_t numFrames, size_t numLanes,
+                            const DiodeClipper::LaneParameters& parameters) noexcept
+    {
+        for (size_t n = 0; n < numFrames; ++n)
+        {
+            const auto row = n * numLanes;
+
+            for (size_t lane = 0; lane < numLanes; lane += 4)
+                _mm_storeu_ps (destination + row + lane, _mm_add_ps (_mm_loadu_ps (destination + row + lane),
+                                                                     clipSse2 (_mm_loadu_ps (input + row + lane),
+                                                                               _mm_loadu_ps (parameters.invK.data() + lane))));
+        }
+    }
+
+    // SSE2 has no gather, so the table entries are loaded one lane at a time
+    inline __m128 clipTableSse2 (__m128 x, __m128 offset, __m128 threshold) noexcept
+    {
+        const auto signMask = _mm_set1_ps (-0.0f);
+        const auto sign = _mm_and_ps (x, signMask);
+        const auto ax = _mm_andnot_ps (signMask, x);
+
+        const auto bits = _mm_castps_si128 (ax);
+        const auto exponent = _mm_cvtepi32_ps (_mm_sub_epi32 (_mm_srli_epi32 (bits, 23), _mm_set1_epi32 (127)));
+        const auto fraction = _mm_mul_ps (_mm_cvtepi32_ps (_mm_and_si128 (bits, _mm_set1_epi32 ((int) MantissaLogTable::fractionMask))),
+                                          _mm_set1_ps (MantissaLogTable::fractionScale));
+
+        alignas (16) uint32_t indices[4];
+        _mm_store_si128 (reinterpret_cast<__m128i*> (indices),
+                         _mm_and_si128 (_mm_srli_epi32 (bits, MantissaLogTable::fractionBits), _mm_set1_epi32 (MantissaLogTable::size - 1)));
+
+        const auto base = _mm_setr_ps (mantissaLogTable.base[indices[0]], mantissaLogTable.base[indices[1]],
+                                       mantissaLogTable.base[indices[2]], mantissaLogTable.base[indices[3]]);
+        const auto slope = _mm_setr_ps (mantissaLogTable.slope[indices[0]], mantissaLogTable.slope[indices[1]],
+                                        mantissaLogTable.slope[indices[2]], mantissaLogTable.slope[indices[3]]);
+
+        const auto log = _mm_add_ps (_mm_add_ps (base, _mm_mul_ps (fraction, slope)), _mm_mul_ps (exponent, _mm_set1_ps (ln2)));
+        const auto curve = _mm_min_ps (ax, _mm_add_ps (_mm_mul_ps (_mm_set1_ps (DiodeClipper::nvt), log), offset));
+
+        const auto isSmall = _mm_cmplt_ps (ax, threshold);
+        const auto U = _mm_or_ps (_mm_and_ps (isSmall, ax), _mm_andnot_ps (isSmall, curve));
+        return _mm_or_ps (U, sign);
+    }
+
+    void processTableSse2 (const float* input, float* destination, size_t numSamples, float R2) noexcept
+    {
+        const auto table = getTableParameters (R2);
+        const auto offset = _mm_set1_ps (table.offset);
+        const auto threshold = _mm_set1_ps (table.threshold);
+
+        size_t i = 0;
+
+        for (; i + 4 <= numSamples; i += 4)
+            _mm_storeu_ps (destination + i, _mm_add_ps (_mm_loadu_ps (destination + i),
+                                                        clipTableSse2 (_mm_loadu_ps (input + i), offset, threshold)));
+
+        DiodeClipper::processTableScalar (input + i, destination + i, numSamples - i, R2);
+    }
+
+    void processTableFramesSse2 (const float* input, float* destination, size_t numFrames, size_t numLanes,
+                                 const DiodeClipper::LaneParameters& parameters) noexcept
+    {
+        for (size_t n = 0; n < numFrames; ++n)
+        {
+            const auto row = n * numLanes;
+
+            for (size_t lane = 0; lane < numLanes; lane += 4)
+                _mm_storeu_ps (destination + row + lane, _mm_add_ps (_mm_loadu_ps (destination + row + lane),
+                                                                     clipTableSse2 (_mm_loadu_ps (input + row + lane),
+                                                                                    _mm_loadu_ps (parameters.tableOffset.data() + lane),
+                                                                                    _mm_loadu_ps (parameters.tableThreshold.data() + lane))));
+        }
+    }
+
+    TS_TARGET_AVX2 inline __m256 fastLogAvx2 (__m256 w) noexcept
+    {
+        const auto bits = _mm256_add_epi32 (_mm256_castps_si256 (w), _mm256_set1_epi32 (0x3f800000 - (int) sqrtHalfBits));
+        const auto exponent = _mm256_cvtepi32_ps (_mm256_sub_epi32 (_mm256_srli_epi32 (bits, 23), _mm256_set1_epi32 (127)));
+        const auto m = _mm256_castsi256_ps (_mm256_add_epi32 (_mm256_and_si256 (bits, _mm256_set1_epi32 (0x007fffff)),
+                                                              _mm256_set1_epi32 ((int) sqrtHalfBits)));
+
+        const auto one = _mm256_set1_ps (1.0f);
+        const auto t = _mm256_div_ps (_mm256_sub_ps (m, one), _mm256_add_ps (m, one));
+        const auto t2 = _mm256_mul_ps (t, t);
+
+        auto series = _mm256_add_ps (_mm256_set1_ps (c2), _mm256_mul_ps (t2, _mm256_set1_ps (c3)));
+        series = _mm256_add_ps (_mm256_set1_ps (c1), _mm256_mul_ps (t2, series));
+        series = _mm256_add_ps (_mm256_set1_ps (2.0f), _mm256_mul_ps (t2, series));
+
+        return _mm256_add_ps (_mm256_mul_ps (t, series), _mm256_mul_ps (exponent, _mm256_set1_ps (ln2)));
+    }
+
+    TS_TARGET_AVX2 inline __m256 clipAvx2 (__m256 x, __m256 invK) noexcept
+    {
+        const auto signMask = _mm256_set1_ps (-0.0f);
+        const auto sign = _mm256_and_ps (x, signMask);
+        const auto ax = _mm256_andnot_ps (signMask, x);
+
+        const auto u = _mm256_mul_ps (ax, invK);
+        const auto root = _mm256_blendv_ps (_mm256_sqrt_ps (_mm256_add_ps (_mm256_mul_ps (u, u), _mm256_set1_ps (1.0f))), u,
+                                            _mm256_cmp_ps (u, _mm256_set1_ps (largeArgument), _CMP_GE_OQ));
+
+        const auto U = _mm256_min_ps (ax, _mm256_mul_ps (_mm256_set1_ps (DiodeClipper::nvt), fastLogAvx2 (_mm256_add_ps (u, root))));
+        return _mm256_or_ps (U, sign);
+    }
+
+    TS_TARGET_AVX2 void processAvx2 (const float* input, float* destination, size_t numSamples, float R2) noexcept
+    {
+        const auto invK = _mm256_set1_ps (1.0f / (2.0f * DiodeClipper::Is * R2));
+
+        size_t i = 0;
+
+        for (; i + 8 <= numSamples; i += 8)
+            _mm256_storeu_ps (destination + i, _mm256_add_ps (_mm256_loadu_ps (destination + i), clipAvx2 (_mm256_loadu_ps (input + i), invK)));
+
+        DiodeClipper::processScalar (input + i, destination + i, numSamples - i, R2);
+    }
+
+    // Eight lanes at a time, and a final four when the lane count is not a multiple of eight
+    TS_TARGET_AVX2 void processFramesAvx2 (const float* input, float* destination, size_t numFrames, size_t numLanes,
+                                           const DiodeClipper::LaneParameters& parameters) noexcept
+    {
+        const auto* invK = parameters.invK.data();
+
+        for (size_t n = 0; n < numFrames; ++n)
+        {
+            const auto* x = input + n * numLanes;
+            auto* y = destination + n * numLanes;
+            size_t lane = 0;
+
+            for (; lane + 8 <= numLanes; lane += 8)
+                _mm256_storeu_ps (y + lane, _mm256_add_ps (_mm256_loadu_ps (y + lane), clipAvx2 (_mm256_loadu_ps (x + lane), _mm256_loadu_ps (invK + lane))));
+
+            if (lane < numLanes)
+                _mm_storeu_ps (y + lane, _mm_add_ps (_mm_loadu_ps (y + lane), clipSse2 (_mm_loadu_ps (x + lane), _mm_loadu_ps (invK + lane))));
+        }
+    }
+
+    TS_TARGET_AVX2 inline __m256 clipTableAvx2 (__m256 x, __m256 offset, __m256 threshold) noexcept
+    {
+        const auto signMask = _mm256_set1_ps (-0.0f);
+        const auto sign = _mm256_and_ps (x, signMask);
+        const auto ax = _mm256_andnot_ps (signMask, x);
+
+        const auto bits = _mm256_castps_si256 (ax);
+        const auto exponent = _mm256_cvtepi32_ps (_mm256_sub_epi32 (_mm256_srli_epi32 (bits, 23), _mm256_set1_epi32 (127)));
+        const auto fraction = _mm256_mul_ps (_mm256_cvtepi32_ps (_mm256_and_si256 (bits, _mm256_set1_epi32 ((int) MantissaLogTable::fractionMask))),
+                                             _mm256_set1_ps (MantissaLogTable::fractionScale));
+        const auto index = _mm256_and_si256 (_mm256_srli_epi32 (bits, MantissaLogTable::fractionBits),
+                                             _mm256_set1_epi32 (MantissaLogTable::size - 1));
+
+        const auto base = _mm256_i32gather_ps (mantissaLogTable.base, index, 4);
+        const auto slope = _mm256_i32gather_ps (mantissaLogTable.slope, index, 4);
+
+        const auto log = _mm256_add_ps (_mm256_add_ps (base, _mm256_mul_ps (fraction, slope)), _mm256_mul_ps (exponent, _mm256_set1_ps (ln2)));
+        const auto curve = _mm256_min_ps (ax, _mm256_add_ps (_mm256_mul_ps (_mm256_set1_ps (DiodeClipper::nvt), log), offset));
+        const auto U = _mm256_blendv_ps (curve, ax, _mm256_cmp_ps (ax, threshold, _CMP_LT_OQ));
+        return _mm256_or_ps (U, sign);
+    }
+
+    TS_TARGET_AVX2 void processTableAvx2 (const float* input, float* destination, size_t numSamples, float R2) noexcept
+    {
+        const auto table = getTableParameters (R2);
+        const auto offset = _mm256_set1_ps (table.offset);
+        const auto threshold = _mm256_set1_ps (table.threshold);
+
+        size_t i = 0;
+
+        for (; i + 8 <= numSamples; i += 8)
+            _mm256_storeu_ps (destination + i, _mm256_add_ps (_mm256_loadu_ps (destination + i),
+                                                              clipTableAvx2 (_mm256_loadu_ps (input + i), offset, threshold)));
+
+        DiodeClipper::processTableScalar (input + i, destination + i, numSamples - i, R2);
+    }
+
+    TS_TARGET_AVX2 void processTableFramesAvx2 (const float* input, float* destination, size_t numFrames, size_t numLanes,
+                                                const DiodeClipper::LaneParameters& parameters) noexcept
+    {
+        const auto* offset = parameters.tableOffset.data();
+        const auto* threshold = parameters.tableThreshold.data();
+
+        for (size_t n = 0; n < numFrames; ++n)
+        {
+            const auto* x = input + n * numLanes;
+            auto* y = destination + n * numLanes;
+            size_t lane = 0;
+
+            for (; lane + 8 <= numLanes; lane += 8)
+                _mm256_storeu_ps (y + lane, _mm256_add_ps (_mm256_loadu_ps (y + lane),
+                                                           clipTableAvx2 (_mm256_loadu_ps (x + lane), _mm256_loadu_ps (offset + lane),
+                                                                          _mm256_loadu_ps (threshold + lane))));
+
+            if (lane < numLanes)
+                _mm_storeu_ps (y + lane, _mm_add_ps (_mm_loadu_ps (y + lane),
+                                                     clipTableSse2 (_mm_loadu_ps (x + lane), _mm_loadu_ps (offset + lane),
+                                                                    _mm_loadu_ps (threshold + lane))));
+        }
+    }
+
+    bool cpuHasAvx2() noexcept
+    {
+       #if defined (_MSC_VER) && ! defined (__clang__)
+        int info[4];
+        __cpuid (info, 0);
+
+        if (info[0] < 7)
+            return false;
+
+        __cpuid (info, 1);
+        const bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv (0) & 6) == 6;
+
+        __cpuidex (info, 7, 0);
+        return osSavesYmm && (info[1] & (1 << 5)) != 0;
+       #else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports ("avx2");
+       #endif
+    }
+}
+
+#endif
+
+//==============================================================================
+DiodeClipper::Implementation DiodeClipper::getBestImplementation() noexcept
+{
+   #if TS_CLIPPER_X86
+    static const bool hasAvx2 = cpuHasAvx2();
+    return hasAvx2 ? Implementation::avx2 : Implementation::sse2;
+   #else
+    return Implementation::scalar;
+   #endif
+}
+
+DiodeClipper::Implementation DiodeClipper::getBestTableImplementation() noexcept
+{
+    switch (getBestImplementation())
+    {
+        case Implementation::avx2:  return Implementation::tableAvx2;
+        case Implementation::sse2:  return Implementation::tableSse2;
+        default:                    return Implementation::tableScalar;
+    }
+}
+
+DiodeClipper::Kernel DiodeClipper::getKernel (Implementation implementation) noexcept
+{
+    switch (implementation)
+    {
+        case Implementation::reference:   return processReference;
+        case Implementation::scalar:      return processScalar;
+        case Implementation::tableScalar: return processTableScalar;
+       #if TS_CLIPPER_X86
+        case Implementation::sse2:        return processSse2;
+        case Implementation::avx2:        return getBestImplementation() == Implementation::avx2 ? processAvx2 : nullptr;
+        case Implementation::tableSse2:   return processTableSse2;
+        case Implementation::tableAvx2:   return getBestImplementation() == Implementation::avx2 ? processTableAvx2 : nullptr;
+       #endif
+        default:                          return nullptr;
+    }
+}
+
+DiodeClipper::FrameKernel DiodeClipper::getFrameKernel (Implementation implementation) noexcept
+{
+    switch (implementation)
+    {
+        case Implementation::reference:   return processReferenceFrames;
+        case Implementation::scalar:      return processScalarFrames;
+        case Implementation::tableScalar: return processTableScalarFrames;
+       #if TS_CLIPPER_X86
+        case Implementation::sse2:        return processFramesSse2;
+        case Implementation::avx2:        return getBestImplementation() == Implementation::avx2 ? processFramesAvx2 : nullptr;
+        case Implementation::tableSse2:   return processTableFramesSse2;
+        case Implementation::tableAvx2:   return getBestImplementation() == Implementation::avx2 ? processTableFramesAvx2 : nullptr;
+       #endif
+        default:                          return nullptr;
+    }
+}
+
+const char* DiodeClipper::getName (Implementation implementation) noexcept
+{
+    switch (implementation)
+    {
+        case Implementation::reference:   return "reference";
+        case Implementation::scalar:      return "scalar";
+        case Implementation::sse2:        return "sse2";
+        case Implementation::avx2:        return "avx2";
+        case Implementation::tableScalar: return "table";
+        case Implementation::tableSse2:   return "table sse2";
+        case Implementation::tableAvx2:   return "table avx2";
+        default:                          return "unknown";
+    }
+}
+
+//==============================================================================
+namespace
+{
+    // Inputs closer than this are treated as equal: the divided differences of F1
+    // and F2 lose about 1e-16 * F / tolerance^order to rounding, the midpoint
+    // fallback only the curvature times the square of the gap
+    constexpr double antiderivativeTolerance = 1.0e-5;
+
+    struct Curve
+    {
+        double limit, lambda, c1, c2;
+
+        double f (double x) const noexcept
+        {
+            const auto a = std::fabs (x);
+            return a <= limit ? x : std::copysign (double (DiodeClipper::nvt) * (std::log (a) + lambda), x);
+        }
+
+        double F1 (double x) const noexcept
+        {
+            const auto a = std::fabs (x);
+            return a <= limit ? 0.5 * a * a : double (DiodeClipper::nvt) * a * (std::log (a) + lambda - 1.0) + c1;
+        }
+
+        double F2 (double x) const noexcept
+        {
+            const auto a = std::fabs (x);
+
+            if (a <= limit)
+                return x * x * x / 6.0;
+
+            return std::copysign (double (DiodeClipper::nvt) * a * a * (0.5 * (std::log (a) + lambda) - 0.75) + c1 * a + c2, x);
+        }
+
+        // (F2 (x0) - F2 (x1)) / (x0 - x1), given F2 at both
+        double D1 (double x0, double x1, double F2x0, double F2x1) const noexcept
+        {
+            const auto difference = x0 - x1;
+            return std::fabs (difference) > antiderivativeTolerance ? (F2x0 - F2x1) / difference : F1 (0.5 * (x0 + x1));
+        }
+    };
+}
+
+void DiodeClipper::Antiderivative::prepare (size_t numLanes, double R2)
+{
+    lanes.assign (numLanes, {});
+
+    for (size_t lane = 0; lane < numLanes; ++lane)
+        set (lane, R2);
+}
+
+void DiodeClipper::Antiderivative::release()
+{
+    std::vector<Lane>().swap (lanes);
+}
+
+void DiodeClipper::Antiderivative::reset() noexcept
+{
+    // F1, F2 and their differences are all 0 at 0
+    for (auto& lane : lanes)
+    {
+        lane.x1 = lane.x2 = lane.dry1 = lane.dry2 = 0.0;
+        lane.F1x1 = lane.F2x1 = lane.D1 = 0.0;
+    }
+}
+
+void DiodeClipper::Antiderivative::set (size_t index, double R2) noexcept
+{
+    auto& lane = lanes[index];
+    const auto L = getLimitVoltage (R2);
+    const auto n = double (nvt);
+
+    lane.limit = L;
+    lane.lambda = std::log (1.0 / (double (Is) * R2));
+
+    // F1 and F2 continuous at the limit
+    lane.c1 = 0.5 * L * L - n * L * (std::log (L) + lane.lambda - 1.0);
+    lane.c2 = L * L * L / 6.0 - n * L * L * (0.5 * (std::log (L) + lane.lambda) - 0.75) - lane.c1 * L;
+
+    const Curve curve { lane.limit, lane.lambda, lane.c1, lane.c2 };
+    lane.F1x1 = curve.F1 (lane.x1);
+    lane.F2x1 = curve.F2 (lane.x1);
+    lane.D1 = curve.D1 (lane.x1, lane.x2, lane.F2x1, curve.F2 (lane.x2));
+}
+
+void DiodeClipper::Antiderivative::process (AntiAliasing order, const float* input, float* destination, size_t numFrames) noexcept
+{
+    processFrames (order, input, destination, numFrames);
+}
+
+void DiodeClipper::Antiderivative::process (AntiAliasing order, const double* input, double* destination, size_t numFrames) noexcept
+{
+    processFrames (order, input, destination, numFrames);
+}
+
+template <typename SampleType>
+void DiodeClipper::Antiderivative::processFrames (AntiAliasing order, const SampleType* input, SampleType* destination,
+                                                  size_t numFrames) noexcept
+{
+    const auto numLanes = lanes.size();
+
+    for (size_t n = 0; n < numFrames; ++n)
+    {
+        const auto* x = input + n * numLanes;
+        auto* y = destination + n * numLanes;
+
+        for (size_t index = 0; index < numLanes; ++index)
+        {
+            auto& lane = lanes[index];
+            const Curve curve { lane.limit, lane.lambda, lane.c1, lane.c2 };
+            const auto x0 = double (x[index]);
+            const auto dry = double (y[index]);
+
+            if (order == AntiAliasing::firstOrder)
+            {
+                const auto F1x0 = curve.F1 (x0);
+                const auto difference = x0 - lane.x1;
+                const auto U = std::fabs (difference) > antiderivativeTolerance ? (F1x0 - lane.F1x1) / difference
+                                                                                : curve.f (0.5 * (x0 + lane.x1));
+
+                y[index] = SampleType (0.5 * (dry + lane.dry1) + U);
+                lane.F1x1 = F1x0;
+            }
+            else
+            {
+                const auto F2x0 = curve.F2 (x0);
+                const auto D1 = curve.D1 (x0, lane.x1, F2x0, lane.F2x1);
+                const auto difference = x0 - lane.x2;
+                double U;
+
+                if (std::fabs (difference) > antiderivativeTolerance)
+                {
+                    U = 2.0 * (D1 - lane.D1) / difference;
+                }
+                else
+                {
+                    // x[n] and x[n-2] alike: the divided difference around their mean and x[n-1]
+                    const auto mean = 0.5 * (x0 + lane.x2);
+                    const auto delta = mean - lane.x1;
+
+                    U = std::fabs (delta) > antiderivativeTolerance ? 2.0 / delta * (curve.F1 (mean) + (lane.F2x1 - curve.F2 (mean)) / delta)
+                                                                    : curve.f (0.5 * (mean + lane.x1));
+                }
+
+                y[index] = SampleType ((dry + lane.dry1 + lane.dry2) / 3.0 + U);
+                lane.F2x1 = F2x0;
+                lane.D1 = D1;
+                lane.x2 = lane.x1;
+                lane.dry2 = lane.dry1;
+            }
+
+            lane.x1 = x0;
+            lane.dry1 = dry;
+        }
+    }
+}
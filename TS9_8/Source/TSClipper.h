@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// The diode clipper of the drive stage:
+//
+//     U = nvt * asinh (x / (2 * Is * R2)),  limited so that |U| <= |x|
+//
+// where x is the drive filter output and R2 the drive resistance. Every kernel
+// adds the clipped signal onto the destination (the op-amp output is the input
+// plus the voltage across the diodes).
+//
+// Besides the reference loop, which calls std::asinh per sample, there are
+// scalar, SSE2 and AVX2 kernels built on a fast asinh:
+//
+//     asinh (u) = log (u + sqrt (u^2 + 1)),  u >= 0
+//
+// with the log reduced to m * 2^e, m in [sqrt(1/2), sqrt(2)), and
+// log (m) = 2 * atanh (t), t = (m - 1) / (m + 1), from a four term odd series.
+// The series truncation error is below 3e-8; together with float rounding the
+// clipped output stays within maxAbsoluteError volts of the reference for any
+// input below 1e9 V. The |U| <= |x| limit is a branch free min() and sign select.
+//
+// The table kernels replace the curve by a lookup. Wherever the limit does not
+// already pass x straight through, u = |x| / (2 * Is * R2) is above 1000 (at
+// least 1e5 for the real circuit), where asinh (u) = log (2u) to within 1/(4u^2).
+// That splits the curve into a part of |x| alone and a drive dependent offset:
+//
+//     U = nvt * log (|x|) + nvt * log (1 / (Is * R2))
+//
+// The offset is computed once per call. log (|x|) takes the float exponent
+// exactly and log of the mantissa from a 256 entry table, linearly interpolated
+// (error below nvt / (8 * 256^2) = 5e-8 V). Per sample that is two table loads
+// and a multiply-add instead of a sqrt, a divide and a polynomial, and the
+// output stays within the same maxAbsoluteError of the reference.
+//
+// The frame kernels run the same curves over many independent streams at once,
+// samples interleaved in frames (frame n holds sample n of every lane), each
+// lane with its own drive. Their per lane constants are worked out ahead, when
+// a lane's R2 changes, so no log is taken per call.
+struct DiodeClipper
+{
+    static constexpr float Is = 1E-14f;
+    static constexpr float nvt = 26.E-3f;
+
+    // Worst case |fast - reference| of the clipped voltage
+    static constexpr float maxAbsoluteError = 2.0E-7f;
+
+    enum class Implementation
+    {
+        reference,
+        scalar,
+        sse2,
+        avx2,
+        tableScalar,
+        tableSse2,
+        tableAvx2
+    };
+
+    using Kernel = void (*) (const float* input, float* destination, size_t numSamples, float R2) noexcept;
+
+    // Per lane constants of the frame kernels
+    struct LaneParameters
+    {
+        std::vector<float> invK, tableOffset, tableThreshold;
+
+        // Allocates, every lane at the given R2
+        void resize (size_t numLanes, float R2);
+
+        // Takes a log; call only when the lane's drive moves
+        void set (size_t lane, float R2) noexcept;
+    };
+
+    // numLanes must be a multiple of 4
+    using FrameKernel = void (*) (const float* input, float* destination, size_t numFrames, size_t numLanes,
+                                  const LaneParameters&) noexcept;
+
+    // The fastest kernel the running CPU supports, detected once at runtime
+    static Implementation getBestImplementation() noexcept;
+
+    // The fastest table kernel the running CPU supports
+    static Implementation getBestTableImplementation() noexcept;
+
+    // Returns nullptr for an implementation this build or CPU cannot run
+    static Kernel getKernel (Implementation) noexcept;
+
+    // Returns nullptr for an implementation this build or CPU cannot run
+    static FrameKernel getFrameKernel (Implementation) noexcept;
+
+    static const char* getName (Implementation) noexcept;
+
+    static void processReference (const float* input, float* destination, size_t numSamples, float R2) noexcept;
+    static void processScalar (const float* input, float* destination, size_t numSamples, float R2) noexcept;
+    static void processTableScalar (const float* input, float* destination, size_t numSamples, float R2) noexcept;
+
+    // The exact curve in double, for the double precision signal path. It has no
+    // fast variant: double is picked where accuracy matters more than speed.
+    static void processDouble (const double* input, double* destination, size_t numSamples, double R2) noexcept;
+
+    // The same over frames, lane l with inverseK[l] = 1 / (2 * Is * R2)
+    static void processDoubleFrames (const double* input, double* destination, size_t numFrames, size_t numLanes,
+                                     const double* inverseK) noexcept;
+
+    // Scalar version of the fast asinh, for u >= 0
+    static float fastAsinh (float u) noexcept;
+
+    // The |x| at which the curve crosses x: below it the |U| <= |x| limit passes
+    // x straight through, above it the diodes conduct. About 0.55 V for the real
+    // circuit. Takes a few asinh, so work it out when R2 moves.
+    static double getLimitVoltage (double R2) noexcept;
+
+    //==============================================================================
+    // Antiderivative anti-aliasing (ADAA), in place of the curve itself. First
+    // order outputs the mean of the curve between consecutive inputs,
+    //
+    //     y[n] = (F1 (x[n]) - F1 (x[n-1])) / (x[n] - x[n-1])
+    //
+    // and second order the divided difference of F2 over the last three, which
+    // takes out far more of the aliasing from the clipping's harmonics than the
+    // curve sampled at the same rate. Both use the closed form antiderivatives.
+    // Above the limit voltage u is past 1000, where asinh (u) = log (2u) as for the
+    // table kernels, so with a = |x| and lambda = log (1 / (Is * R2)):
+    //
+    //     F1 = nvt * a * (log (a) + lambda - 1) + c1
+    //     F2 = sign (x) * (nvt * a^2 * ((log (a) + lambda) / 2 - 3/4) + c1 * a + c2)
+    //
+    // and a^2 / 2 and x^3 / 6 below it, c1 and c2 joining the pieces. Where two
+    // inputs are too close to divide by their difference, the curve or F1 at the
+    // midpoint stands in. Everything runs in double, which the differences need.
+    //
+    // ADAA delays the clipped signal by half a sample per order and smooths it: a
+    // straight line comes out as the mean of the last two (first order) or three
+    // (second order) inputs. The op-amp output is the input plus the clipped
+    // signal, so the input goes through the same mean, and below the limit the
+    // stage stays linear and time aligned.
+    enum class AntiAliasing
+    {
+        none,
+        firstOrder,
+        secondOrder
+    };
+
+    class Antiderivative
+    {
+    public:
+        // Allocates, every lane at the given R2 and without history
+        void prepare (size_t numLanes, double R2);
+        void release();
+
+        // Clears the history of every lane
+        void reset() noexcept;
+
+        // Takes a few asinh; call only when the lane's drive moves. The lane's
+        // history is carried over to the new curve, so the output does not jump.
+        void set (size_t lane, double R2) noexcept;
+
+        // Like the frame kernels over numLanes = the prepared lanes, except that
+        // the destination frames are also averaged as described above
+        void process (AntiAliasing, const float* input, float* destination, size_t numFrames) noexcept;
+        void process (AntiAliasing, const double* input, double* destination, size_t numFrames) noexcept;
+
+        // In samples at the rate it runs
+        static double getDelay (AntiAliasing order) noexcept    { return 0.5 * double (int (order)); }
+
+    private:
+        struct Lane
+        {
+            // The curve
+            double limit = 0.0, lambda = 0.0, c1 = 0.0, c2 = 0.0;
+
+            // The last two inputs and destination samples, F1 and F2 of the last
+            // input and the last first divided difference of F2
+            double x1 = 0.0, x2 = 0.0, dry1 = 0.0, dry2 = 0.0;
+            double F1x1 = 0.0, F2x1 = 0.0, D1 = 0.0;
+        };
+
+        template <typename SampleType>
+        void processFrames (AntiAliasing, const SampleType* input, SampleType* destination, size_t numFrames) noexcept;
+
+        std::vector<Lane> lanes;
+    };
+};
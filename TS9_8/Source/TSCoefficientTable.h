@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "TSCircuit.h"
+
+// Biquad coefficients precomputed over a parameter range for one sample rate.
+//
+// Drive and tone are quantised to 0.001 steps, so each filter only has a
+// thousand or so distinct designs. build() evaluates all of them once (from
+// prepareToPlay, never on the audio thread) and a parameter change becomes a
+// table lookup. interpolate() blends neighbouring entries for values between
+// steps, such as smoothed or modulated parameters; the entries are close enough
+// that the blended filters stay stable.
+class CoefficientTable
+{
+public:
+    // Evaluates design (parameterValue) at every step of [rangeStart, rangeEnd]
+    template <typename DesignFunction>
+    void build (float rangeStart, float rangeEnd, float stepSize, DesignFunction&& design)
+    {
+        start = rangeStart;
+        numSteps = std::max (1, int ((rangeEnd - rangeStart) / stepSize + 0.5f));
+        stepsPerUnit = float (numSteps) / (rangeEnd - rangeStart);
+
+        entries.resize (size_t (numSteps + 1));
+
+        for (int i = 0; i <= numSteps; ++i)
+            entries[size_t (i)] = design (double (rangeStart) + double (i) * double (rangeEnd - rangeStart) / double (numSteps));
+    }
+
+    bool isEmpty() const noexcept    { return entries.empty(); }
+
+    const std::vector<BiquadCoefficients>& getEntries() const noexcept    { return entries; }
+
+    // Entry for the step nearest to value
+    const BiquadCoefficients& lookup (float value) const noexcept
+    {
+        const auto position = std::clamp ((value - start) * stepsPerUnit, 0.0f, float (numSteps));
+        return entries[size_t (position + 0.5f)];
+    }
+
+    // Linear blend of the two entries either side of value
+    BiquadCoefficients interpolate (float value) const noexcept
+    {
+        const auto position = std::clamp ((value - start) * stepsPerUnit, 0.0f, float (numSteps));
+        const auto index = std::min (int (position), numSteps - 1);
+        const auto alpha = double (position - float (index));
+
+        return interpolateCoefficients (entries[size_t (index)], entries[size_t (index + 1)], alpha);
+    }
+
+private:
+    std::vector<BiquadCoefficients> entries;
+    float start = 0.0f;
+    float stepsPerUnit = 1.0f;
+    int numSteps = 1;
+};
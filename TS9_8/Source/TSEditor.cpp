@@ -1,10 +1,85 @@
 #include "TSProcessor.h"
 #include "TSEditor.h"
 
+//==============================================================================
+KnobFilmstrips::KnobFilmstrips()
+{
+    knobImage = ImageCache::getFromMemory (BinaryData::TS808Knob_png, BinaryData::TS808Knob_pngSize);
+}
+
+const Image& KnobFilmstrips::getFilmstrip (int diameter)
+{
+    auto& filmstrip = filmstrips[diameter];
+
+    if (filmstrip.isNull() && knobImage.isValid())
+    {
+        // Scaling the 576 pixel source down once keeps each rotation cheap
+        const auto knob = knobImage.rescaled (diameter, diameter, Graphics::highResamplingQuality);
+        const auto centre = diameter * 0.5f;
+
+        filmstrip = Image (Image::ARGB, diameter * framesPerRow, diameter * ((numFrames + framesPerRow - 1) / framesPerRow), true);
+        Graphics g (filmstrip);
+        g.setImageResamplingQuality (Graphics::highResamplingQuality);
+
+        for (int frame = 0; frame < numFrames; ++frame)
+        {
+            // 145 degrees either side of twelve o'clock
+            const auto angle = jmap ((float) frame / (float) (numFrames - 1), -145.0f, 145.0f) * MathConstants<float>::pi / 180.0f;
+
+            const auto area = getFrameArea (frame, diameter);
+
+            // The rotated corners would otherwise spill into the neighbouring frames
+            Graphics::ScopedSaveState state (g);
+            g.reduceClipRegion (area);
+            g.drawImageTransformed (knob, AffineTransform::rotation (angle, centre, centre)
+                                              .translated ((float) area.getX(), (float) area.getY()));
+        }
+    }
+
+    return filmstrip;
+}
+
+//==============================================================================
+void KnobLookAndFeel::drawRotarySlider(juce::Graphics& g, int x, int y, int width, int height, float sliderPos,
+    const float rotaryStartAngle, const float rotaryEndAngle, Slider& slider)
+{
+	if (filmstrips->isValid())
+	{
+		const float radius = jmin(width / 2.0f, height / 2.0f);
+		const float centerX = x + width * 0.5f;
+		const float centerY = y + height * 0.5f;
+		const int rx = (int) (centerX - radius - 1.0f);
+		const int ry = (int) (centerY - radius);
+		const int size = 2 * (int) radius;
+
+		// Frames are rendered at the physical size so the blit is one to one on high DPI displays
+		const int diameter = jmax(1, roundToInt(size * g.getInternalContext().getPhysicalPixelScaleFactor()));
+		const Image& filmstrip = filmstrips->getFilmstrip(diameter);
+		const int frameId = jlimit(0, KnobFilmstrips::numFrames - 1, roundToInt(sliderPos * (KnobFilmstrips::numFrames - 1)));
+
+		const auto frame = KnobFilmstrips::getFrameArea(frameId, diameter);
+
+		g.drawImage(filmstrip, rx, ry, size, size, frame.getX(), frame.getY(), diameter, diameter);
+	}
+	else
+	{
+		static const float textPpercent = 0.35f;
+		Rectangle<float> text_bounds(1.0f + width * (1.0f - textPpercent) / 2.0f,
+		0.5f * height, width * textPpercent, 0.5f * height);
+		
+		g.setColour(Colours::white);
+		
+		g.drawFittedText(String("Image Not Found"), text_bounds.getSmallestIntegerContainer(),
+		Justification::horizontallyCentred | Justification::centred, 1);
+	}
+}
+
 //==============================================================================
 TSAudioProcessorEditor::TSAudioProcessorEditor (TSAudioProcessor& p, AudioProcessorValueTreeState& vts)
-    : AudioProcessorEditor (&p), parameters(vts), audioProcessor (p), LookAndFeel_V4()
+    : AudioProcessorEditor (&p), parameters(vts), audioProcessor (p), meter_display (p), LookAndFeel_V4()
 {
+    // The cached background covers every pixel
+    setOpaque(true);
     setSize(400, 600);
 
     drive_slider.setTextBoxStyle(Slider::TextEntryBoxPosition::NoTextBox, true, 0, 0);
@@ -16,7 +91,6 @@ TSAudioProcessorEditor::TSAudioProcessorEditor (TSAudioProcessor& p, AudioProces
         auto value = drive_slider.getValue();
         auto valueToDisplay = drive_slider.valueToProportionOfLength(value) * 10.0;
 		drive_value_label.setText(String::toDecimalStringWithSignificantFigures(valueToDisplay, 2), NotificationType::dontSendNotification);
-        audioProcessor.updateFilterState();
     };
 	
     tone_slider.setTextBoxStyle(Slider::TextEntryBoxPosition::NoTextBox, true, 0, 0);
@@ -29,7 +103,6 @@ TSAudioProcessorEditor::TSAudioProcessorEditor (TSAudioProcessor& p, AudioProces
         auto value = tone_slider.getValue();
         auto valueToDisplay = tone_slider.valueToProportionOfLength(value) * 10.0;
 		tone_value_label.setText(String::toDecimalStringWithSignificantFigures(valueToDisplay, 2), NotificationType::dontSendNotification);
-        audioProcessor.updateFilterState();
     };
 
     level_slider.setTextBoxStyle(Slider::TextEntryBoxPosition::NoTextBox, true, 0, 0);
@@ -40,7 +113,6 @@ TSAudioProcessorEditor::TSAudioProcessorEditor (TSAudioProcessor& p, AudioProces
     level_slider.setDoubleClickReturnValue(true, 0.5);
     level_slider.onValueChange = [this] {
 		level_value_label.setText(String::toDecimalStringWithSignificantFigures(level_slider.getValue() * 10.0, 2), NotificationType::dontSendNotification);
-        audioProcessor.updateFilterState();
     };
 
     drive_label.setText("DRIVE", juce::NotificationType::dontSendNotification);
@@ -86,10 +158,62 @@ TSAudioProcessorEditor::TSAudioProcessorEditor (TSAudioProcessor& p, AudioProces
     addAndMakeVisible(level_slider);
     addAndMakeVisible(level_label);
     addAndMakeVisible(level_value_label);
+    addAndMakeVisible(meter_display);
    
     driveAttachment.reset (new AudioProcessorValueTreeState::SliderAttachment (parameters, "drive", drive_slider));
     toneAttachment.reset (new AudioProcessorValueTreeState::SliderAttachment (parameters, "tone", tone_slider));
     levelAttachment.reset (new AudioProcessorValueTreeState::SliderAttachment (parameters, "level", level_slider));
+
+    // Combo boxes need their items before they are attached
+    if (auto* choice = dynamic_cast<AudioParameterChoice*> (parameters.getParameter ("oversampling")))
+        oversampling_box.addItemList (choice->choices, 1);
+
+    if (auto* choice = dynamic_cast<AudioParameterChoice*> (parameters.getParameter ("oversamplingFilter")))
+        oversampling_filter_box.addItemList (choice->choices, 1);
+
+    if (auto* choice = dynamic_cast<AudioParameterChoice*> (parameters.getParameter ("driveModel")))
+        drive_model_box.addItemList (choice->choices, 1);
+
+    if (auto* choice = dynamic_cast<AudioParameterChoice*> (parameters.getParameter ("circuitModel")))
+        circuit_model_box.addItemList (choice->choices, 1);
+
+    if (auto* choice = dynamic_cast<AudioParameterChoice*> (parameters.getParameter ("clipperAntiAliasing")))
+        anti_aliasing_box.addItemList (choice->choices, 1);
+
+    addAndMakeVisible(oversampling_box);
+    addAndMakeVisible(oversampling_filter_box);
+    addAndMakeVisible(drive_model_box);
+    addAndMakeVisible(circuit_model_box);
+    addAndMakeVisible(anti_aliasing_box);
+
+    oversamplingAttachment.reset (new AudioProcessorValueTreeState::ComboBoxAttachment (parameters, "oversampling", oversampling_box));
+    oversamplingFilterAttachment.reset (new AudioProcessorValueTreeState::ComboBoxAttachment (parameters, "oversamplingFilter", oversampling_filter_box));
+    driveModelAttachment.reset (new AudioProcessorValueTreeState::ComboBoxAttachment (parameters, "driveModel", drive_model_box));
+    circuitModelAttachment.reset (new AudioProcessorValueTreeState::ComboBoxAttachment (parameters, "circuitModel", circuit_model_box));
+    antiAliasingAttachment.reset (new AudioProcessorValueTreeState::ComboBoxAttachment (parameters, "clipperAntiAliasing", anti_aliasing_box));
+
+    power_button.setClickingTogglesState(true);
+    power_button.setColour(TextButton::buttonOnColourId, Colours::darkred);
+    addAndMakeVisible(power_button);
+
+    if (auto* bypass = parameters.getParameter ("bypass"))
+    {
+        powerAttachment.reset (new ParameterAttachment (*bypass, [this] (float bypassed)
+        {
+            power_button.setToggleState(bypassed < 0.5f, NotificationType::dontSendNotification);
+            power_button.setButtonText(bypassed < 0.5f ? "ON" : "OFF");
+        }));
+
+        powerAttachment->sendInitialUpdate();
+    }
+
+    for (auto* component : std::initializer_list<Component*> { &drive_slider, &tone_slider, &level_slider, &power_button })
+        component->addMouseListener(this, false);
+
+    power_button.onClick = [this] {
+        if (powerAttachment != nullptr)
+            powerAttachment->setValueAsCompleteGesture(power_button.getToggleState() ? 0.0f : 1.0f);
+    };
     
     /*addAndMakeVisible(signature_label);
     signature_label.setText("by PHILIP COLANGELO", NotificationType::dontSendNotification);
@@ -103,9 +227,56 @@ TSAudioProcessorEditor::~TSAudioProcessorEditor()
 {
 }
 
+void TSAudioProcessorEditor::mouseDown (const MouseEvent& e)
+{
+    if (! e.mods.isPopupMenu())
+        return;
+
+    if (e.eventComponent == &drive_slider)
+        showMidiMenu(TSAudioProcessor::MidiTarget::drive, drive_slider);
+    else if (e.eventComponent == &tone_slider)
+        showMidiMenu(TSAudioProcessor::MidiTarget::tone, tone_slider);
+    else if (e.eventComponent == &level_slider)
+        showMidiMenu(TSAudioProcessor::MidiTarget::level, level_slider);
+    else if (e.eventComponent == &power_button)
+        showMidiMenu(TSAudioProcessor::MidiTarget::bypass, power_button);
+}
+
+void TSAudioProcessorEditor::showMidiMenu (TSAudioProcessor::MidiTarget target, Component& targetComponent)
+{
+    const auto controller = audioProcessor.getMidiController(target);
+
+    PopupMenu menu;
+    menu.addSectionHeader(controller >= 0 ? "MIDI CC " + String(controller) : "No MIDI CC");
+
+    if (audioProcessor.isLearningMidi(target))
+        menu.addItem("Cancel MIDI Learn", [this] { audioProcessor.cancelMidiLearn(); });
+    else
+        menu.addItem("MIDI Learn", [this, target] { audioProcessor.learnMidiController(target); });
+
+    menu.addItem("Clear MIDI CC", controller >= 0, false, [this, target] { audioProcessor.setMidiController(target, -1); });
+
+    menu.showMenuAsync(PopupMenu::Options().withTargetComponent(&targetComponent));
+}
+
 //==============================================================================
 void TSAudioProcessorEditor::paint (juce::Graphics& g)
 {
+    const auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+
+    if (background.isNull() || scale != backgroundScale)
+        renderBackground(scale);
+
+    g.drawImage(background, getLocalBounds().toFloat());
+}
+
+void TSAudioProcessorEditor::renderBackground (float scale)
+{
+    backgroundScale = scale;
+    background = Image(Image::RGB, jmax(1, roundToInt(getWidth() * scale)), jmax(1, roundToInt(getHeight() * scale)), false);
+
+    Graphics g(background);
+    g.addTransform(AffineTransform::scale(scale));
 
     Font logo_font = Font("Bebas Neue", 86.0f, Font::plain);
     String TS("Tube  ");
@@ -113,9 +284,7 @@ void TSAudioProcessorEditor::paint (juce::Graphics& g)
 
 	g.fillAll(juce::Colour::fromRGB(48, 182, 116));
 
-    File desktop = File::getSpecialLocation(File::SpecialLocationType::userDesktopDirectory);
-    File textureImageFile = desktop.getFullPathName() + "/JUCEProjects/TubeSchemer/Media/MetalTexture.png";
-    Image bgImg = ImageCache::getFromFile(textureImageFile);
+    Image bgImg = ImageCache::getFromMemory(BinaryData::MetalTexture_png, BinaryData::MetalTexture_pngSize);
     Rectangle<float> targetArea(getWidth(), getHeight());
     g.setOpacity(0.20f);
     g.drawImage(bgImg, targetArea, RectanglePlacement::Flags::xLeft | RectanglePlacement::Flags::yTop);
@@ -150,6 +319,9 @@ void TSAudioProcessorEditor::paint (juce::Graphics& g)
 
 void TSAudioProcessorEditor::resized()
 {
+    // Drawn again at the new size on the next paint
+    background = {};
+
     auto r = getLocalBounds();
 
     int knob_y_offset = 75;
@@ -187,6 +359,22 @@ void TSAudioProcessorEditor::resized()
     level_value_label.setCentrePosition(level_slider.getX() + level_slider.getWidth() / 2, 
         level_slider.getY() - 10);
 
+    meter_display.setBounds(20, 140, r.getWidth() - 40, 28);
+
+    power_button.setSize(56, 28);
+    power_button.setCentrePosition(r.getWidth() / 2, r.getHeight() / 3 + knob_y_offset - 25);
+
+    circuit_model_box.setSize(80, 24);
+    circuit_model_box.setCentrePosition(r.getWidth() / 2, r.getHeight() / 3 + knob_y_offset + 10);
+
+    auto quality_bounds = r.withTrimmedBottom(45).removeFromBottom(28).reduced(10, 0);
+    oversampling_box.setBounds(quality_bounds.removeFromLeft(70));
+    drive_model_box.setBounds(quality_bounds.removeFromRight(150));
+    oversampling_filter_box.setBounds(quality_bounds.reduced(5, 0));
+
+    // Under the drive model, which it belongs with
+    anti_aliasing_box.setBounds(r.withTrimmedBottom(45 + 28 + 6).removeFromBottom(28).reduced(10, 0).removeFromRight(150));
+
     auto sig_bounds = r.removeFromBottom(40);
     sig_bounds = sig_bounds.removeFromRight(r.getWidth() - 15);
     signature_label.setBounds(sig_bounds);
@@ -2,69 +2,53 @@
 
 #include <JuceHeader.h>
 #include "TSProcessor.h"
+#include "TSMeterDisplay.h"
 
 using namespace juce; 
 
-class KnobLookAndFeel : public LookAndFeel_V4
+// The knob turned through its whole travel, pre-rendered as a grid of square
+// frames, one grid per pixel size. Shared by every editor in the process, so the
+// image is decoded and rotated once and a knob repaint is a single blit.
+//
+// A grid rather than a column keeps each image square: a 250 pixel knob is a
+// 2000 x 2000 image, where a column of its frames would be 16000 pixels tall,
+// past what most GPUs take as one texture.
+class KnobFilmstrips
 {
 public:
-    KnobLookAndFeel() {
-		File desktop = File::getSpecialLocation(File::SpecialLocationType::userDesktopDirectory);
-		File ts808_knob_image_file = desktop.getFullPathName() + "/JUCEProjects/TubeSchemer/Media/TS808Knob.png";
-		knob_img = ImageCache::getFromFile(ts808_knob_image_file);
+    // 290 degrees of travel, under 5 degrees a frame
+    static constexpr int numFrames = 64;
+    static constexpr int framesPerRow = 8;
+
+    KnobFilmstrips();
+
+    bool isValid() const noexcept    { return knobImage.isValid(); }
+
+    // numFrames frames of diameter x diameter pixels, from fully left to fully right,
+    // row by row
+    const Image& getFilmstrip (int diameter);
+
+    // Where a frame sits in the filmstrip of that diameter
+    static Rectangle<int> getFrameArea (int frame, int diameter) noexcept
+    {
+        return { (frame % framesPerRow) * diameter, (frame / framesPerRow) * diameter, diameter, diameter };
     }
-  
+
+private:
+    Image knobImage;
+    std::map<int, Image> filmstrips;
+
+    JUCE_DECLARE_NON_COPYABLE (KnobFilmstrips)
+};
+
+class KnobLookAndFeel : public LookAndFeel_V4
+{
+public:
     void drawRotarySlider(juce::Graphics& g, int x, int y, int width, int height, float sliderPos,
-        const float rotaryStartAngle, const float rotaryEndAngle, Slider& slider) override {
-
-		if (knob_img.isValid())
-		{ 
-			float valueToUse = sliderPos; 
-
-			const double rotation = (valueToUse - slider.getMinimum()) / (slider.getMaximum() - slider.getMinimum());
-			
-			const int frames = knob_img.getHeight() / knob_img.getWidth();
-			const int frameId = (int)ceil(rotation * ((double)frames - 1.0));
-			const float radius = jmin(width / 2.0f, height / 2.0f);
-			const float centerX = x + width * 0.5f;
-			const float centerY = y + height * 0.5f;
-			const float rx = centerX - radius - 1.0f;
-			const float ry = centerY - radius;
-
-			float min = -145.0f * MathConstants<float>::pi / 180.0f;
-			float max = 145.0f * MathConstants<float>::pi / 180.0f;
-			float rad = jmap<float>(static_cast<float>(valueToUse / slider.getMaximum()), min, max);
-			
-		    AffineTransform rotator;
-
-			g.addTransform(rotator.rotated(rad, (float)(centerX), (float)(centerY)));
-			
-			g.drawImage(knob_img,
-				(int) rx,
-				(int) ry,
-				2 * (int) radius,
-				2 * (int) radius,
-				0,
-				frameId * knob_img.getWidth(),
-				knob_img.getWidth(),
-				knob_img.getWidth());
-
-		}
-		else
-		{
-			static const float textPpercent = 0.35f;
-			Rectangle<float> text_bounds(1.0f + width * (1.0f - textPpercent) / 2.0f,
-			0.5f * height, width * textPpercent, 0.5f * height);
-			
-			g.setColour(Colours::white);
-			
-			g.drawFittedText(String("Image Not Found"), text_bounds.getSmallestIntegerContainer(),
-			Justification::horizontallyCentred | Justification::centred, 1);
-		}
-    }
-    
-	Image knob_img;
+        const float rotaryStartAngle, const float rotaryEndAngle, Slider& slider) override;
 
+private:
+    SharedResourcePointer<KnobFilmstrips> filmstrips;
 };
 
 //==============================================================================
@@ -79,8 +63,16 @@ public:
     //==============================================================================
     void paint (Graphics&) override;
     void resized() override;
+
+    // Right clicks on the knobs and the power switch, for their MIDI menus
+    void mouseDown (const MouseEvent&) override;
     
 private:
+    // Draws the static parts (colour, texture, border and logo) into background
+    void renderBackground (float scale);
+
+    // Learn or clear the controller of one target
+    void showMidiMenu (TSAudioProcessor::MidiTarget target, Component& targetComponent);
 
     TSAudioProcessor& audioProcessor;
 
@@ -101,8 +93,33 @@ private:
 	Label level_value_label;
     std::unique_ptr<AudioProcessorValueTreeState::SliderAttachment> levelAttachment;
 
+    ComboBox oversampling_box;
+    std::unique_ptr<AudioProcessorValueTreeState::ComboBoxAttachment> oversamplingAttachment;
+
+    ComboBox oversampling_filter_box;
+    std::unique_ptr<AudioProcessorValueTreeState::ComboBoxAttachment> oversamplingFilterAttachment;
+
+    // A power switch: on is the "bypass" parameter off
+    TextButton power_button;
+    std::unique_ptr<ParameterAttachment> powerAttachment;
+
+    ComboBox drive_model_box;
+    std::unique_ptr<AudioProcessorValueTreeState::ComboBoxAttachment> driveModelAttachment;
+
+    ComboBox circuit_model_box;
+    std::unique_ptr<AudioProcessorValueTreeState::ComboBoxAttachment> circuitModelAttachment;
+
+    ComboBox anti_aliasing_box;
+    std::unique_ptr<AudioProcessorValueTreeState::ComboBoxAttachment> antiAliasingAttachment;
+
 	Label signature_label;
 
+    MeterDisplay meter_display;
+
+    // Everything paint() draws, at the physical pixel size it was last painted at
+    Image background;
+    float backgroundScale = 0.0f;
+
     AudioProcessorValueTreeState& parameters;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TSAudioProcessorEditor)
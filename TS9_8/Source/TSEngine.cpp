@@ -0,0 +1,1027 @@
+#include "TSEngine.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined (__x86_64__) || defined (_M_X64)
+ #include <immintrin.h>
+ #define TS_ENGINE_X86 1
+#else
+ #define TS_ENGINE_X86 0
+#endif
+
+namespace
+{
+    // The filter and allpass tails decay into denormals, which cost hundreds of
+    // cycles each on x86. Flushes them to zero for the length of a call, like
+    // juce::ScopedNoDenormals, for callers that are not inside a JUCE callback.
+    struct ScopedFlushDenormals
+    {
+       #if TS_ENGINE_X86
+        ScopedFlushDenormals() noexcept    : previous (_mm_getcsr())    { _mm_setcsr (previous | flushBits); }
+        ~ScopedFlushDenormals() noexcept                                { _mm_setcsr (previous); }
+
+        static constexpr unsigned int flushBits = 0x8040; // FTZ | DAZ
+        unsigned int previous;
+       #endif
+    };
+
+    size_t roundUp (size_t value, size_t multiple) noexcept
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    void addWeighted (BiquadCoefficients& sum, const BiquadCoefficients& c, double weight) noexcept
+    {
+        sum.b0 += weight * c.b0;
+        sum.b1 += weight * c.b1;
+        sum.b2 += weight * c.b2;
+        sum.a1 += weight * c.a1;
+        sum.a2 += weight * c.a2;
+    }
+}
+
+//==============================================================================
+template <typename SampleType>
+void TSEngine<SampleType>::Ramps::prepare (size_t numLanes, int numRampSamples)
+{
+    rampLength = numRampSamples;
+    current.assign (numLanes, 0.0f);
+    target.assign (numLanes, 0.0f);
+    step.assign (numLanes, 0.0f);
+    countdown.assign (numLanes, 0);
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::Ramps::release()
+{
+    current = {};
+    target = {};
+    step = {};
+    countdown = {};
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::Ramps::setTarget (size_t lane, float value) noexcept
+{
+    if (value == target[lane])
+        return;
+
+    target[lane] = value;
+
+    if (rampLength <= 0)
+    {
+        current[lane] = value;
+        countdown[lane] = 0;
+        return;
+    }
+
+    countdown[lane] = rampLength;
+    step[lane] = (value - current[lane]) / float (rampLength);
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::Ramps::skip (size_t lane, int numSamples) noexcept
+{
+    if (numSamples >= countdown[lane])
+    {
+        current[lane] = target[lane];
+        countdown[lane] = 0;
+        return;
+    }
+
+    current[lane] += step[lane] * float (numSamples);
+    countdown[lane] -= numSamples;
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::Ramps::finish() noexcept
+{
+    current = target;
+    std::fill (countdown.begin(), countdown.end(), 0);
+}
+
+template <typename SampleType>
+bool TSEngine<SampleType>::Ramps::isSmoothing() const noexcept
+{
+    return std::any_of (countdown.begin(), countdown.end(), [] (int remaining) { return remaining > 0; });
+}
+
+//==============================================================================
+template <typename SampleType>
+void TSEngine<SampleType>::prepare (const Settings& newSettings)
+{
+    settings = newSettings;
+    settings.numStreams = std::max<size_t> (1, settings.numStreams);
+    settings.tileSize = std::max<size_t> (1, settings.tileSize);
+    settings.overSamplingStages = std::clamp (settings.overSamplingStages, 0, Oversampler<SampleType>::maxStages);
+
+    // Whole SIMD registers: 4 floats or 2 doubles, as the frame kernels want
+    lanes = roundUp (settings.numStreams, registerLanes);
+
+    overSampler.prepare (lanes, settings.overSamplingStages, settings.overSamplingFilter, settings.tileSize);
+
+    const auto factor = overSampler.getFactor();
+    const auto overSampledRate = settings.sampleRate * double (factor);
+
+    for (int model = 0; model < numCircuitModels; ++model)
+    {
+        visitCircuit (CircuitModel (model), [&] (auto circuit)
+        {
+            designCircuit<decltype (circuit)> (circuits[size_t (model)], settings.sampleRate, overSampledRate);
+        });
+    }
+
+    const auto& selected = circuits[size_t (circuitModel)];
+
+    // The slowest poles over every circuit, drive and tone setting, drive at the oversampled rate
+    double driveDecay = 0.0, toneDecay = 0.0;
+
+    for (const auto& designs : circuits)
+    {
+        for (const auto& coefficients : designs.driveTable.getEntries())
+            driveDecay = std::max (driveDecay, getDecaySamples (coefficients, 120.0));
+
+        for (const auto& coefficients : designs.toneTable.getEntries())
+            toneDecay = std::max (toneDecay, getDecaySamples (coefficients, 120.0));
+    }
+
+    // The antiderivative delays by half a sample per order at the oversampled
+    // rate; padded up to whole samples at the host rate, the dry path and the
+    // reported latency line up with the output exactly
+    const auto clipperHalfSamples = int (2.0 * DiodeClipper::Antiderivative::getDelay (settings.clipperAntiAliasing));
+    clipperLatency = (clipperHalfSamples + 2 * int (factor) - 1) / (2 * int (factor));
+    waveDigitalPadding = 2 * int (factor) * clipperLatency;
+    filterAndClipperPadding = waveDigitalPadding - clipperHalfSamples;
+
+    tailSamples = overSampler.getTailInSamples() + clipperLatency + int (std::ceil (driveDecay / double (factor) + toneDecay));
+
+    driveFilter.prepare (lanes);
+    toneFilter.prepare (lanes);
+
+    clipperLanes.resize (lanes, selected.drive.Rf);
+    antiderivative.prepare (lanes, selected.drive.Rf);
+    inverseK.assign (lanes, 0.0);
+    limitVoltage.assign (lanes, SampleType (0));
+    heavyClipVoltage.assign (lanes, SampleType (0));
+    diodeLimitVoltage.assign (lanes, SampleType (0));
+    diodeHeavyClipVoltage.assign (lanes, SampleType (0));
+
+    if (frameKernel == nullptr)
+        frameKernel = DiodeClipper::getFrameKernel (DiodeClipper::getBestImplementation());
+
+    waveDigitalStages.resize (lanes / registerLanes);
+
+    for (auto& stage : waveDigitalStages)
+        stage.prepare (selected.drive, overSampledRate);
+
+    // As juce::LinearSmoothedValue::reset (sampleRate, seconds)
+    const auto rampLength = int (std::floor (settings.smoothingSeconds * settings.sampleRate));
+
+    for (auto* ramps : { &drive, &tone, &level })
+        ramps->prepare (lanes, rampLength);
+
+    const StreamParameters defaults;
+    levelValues.assign (lanes, defaults.level);
+
+    for (size_t lane = 0; lane < lanes; ++lane)
+    {
+        drive.target[lane] = defaults.drive;
+        tone.target[lane] = defaults.tone;
+        level.target[lane] = defaults.level * float (selected.outputGain);
+    }
+
+    toneGains.assign (lanes, 1.0f);
+    frames.assign (settings.tileSize * lanes, SampleType (0));
+    driven.assign (settings.tileSize * factor * lanes, SampleType (0));
+    sliceFrames = std::max<size_t> (1, fusedSliceBytes / (factor * lanes * sizeof (SampleType)));
+    dryDelay.assign (size_t (getLatencySamples()) * lanes, SampleType (0));
+    clipperPaddingDelay.assign (waveDigitalPadding > 0 ? size_t (waveDigitalPadding / 2 + 1) * lanes : 0, SampleType (0));
+    dryFrames.assign (settings.tileSize * lanes, SampleType (0));
+
+    meters.assign (settings.numStreams, {});
+    limitedCounts.assign (lanes, 0);
+    heavilyClippedCounts.assign (lanes, 0);
+
+    reset();
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::release()
+{
+    overSampler.release();
+    driveFilter.release();
+    toneFilter.release();
+    clipperLanes = {};
+    antiderivative.release();
+    inverseK = {};
+    limitVoltage = {};
+    heavyClipVoltage = {};
+    diodeLimitVoltage = {};
+    diodeHeavyClipVoltage = {};
+    waveDigitalStages = {};
+
+    for (auto* ramps : { &drive, &tone, &level })
+        ramps->release();
+
+    levelValues = {};
+    toneGains = {};
+
+    for (auto& designs : circuits)
+        designs = {};
+
+    frames = {};
+    driven = {};
+    dryDelay = {};
+    dryFrames = {};
+    clipperPaddingDelay = {};
+    meters = {};
+    limitedCounts = {};
+    heavilyClippedCounts = {};
+    lanes = 0;
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::reset() noexcept
+{
+    resetProcessing();
+
+    for (auto* ramps : { &drive, &tone, &level })
+        ramps->finish();
+
+    // A circuit switch in progress lands on the selected circuit
+    circuitWeights.fill (0.0f);
+    circuitWeights[size_t (circuitModel)] = 1.0f;
+    circuitCountdown = 0;
+
+    // The next tile folds the level back in if it can
+    std::fill (toneGains.begin(), toneGains.end(), 1.0f);
+    levelFolded = false;
+
+    for (size_t lane = 0; lane < lanes; ++lane)
+    {
+        setDriveLane (lane, drive.current[lane]);
+        setToneLane (lane, tone.current[lane]);
+    }
+
+    std::fill (dryDelay.begin(), dryDelay.end(), SampleType (0));
+    dryPosition = 0;
+    dryGain = bypassed ? 1.0f : 0.0f;
+    dryCountdown = 0;
+
+    processingIdle = false;
+    sleeping = false;
+    silentSamples = 0;
+    samplesUntilUpdate = 0;
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::resetProcessing() noexcept
+{
+    overSampler.reset();
+    driveFilter.reset();
+    toneFilter.reset();
+    antiderivative.reset();
+
+    for (auto& stage : waveDigitalStages)
+        stage.reset();
+
+    std::fill (clipperPaddingDelay.begin(), clipperPaddingDelay.end(), SampleType (0));
+    clipperPaddingPosition = 0;
+}
+
+//==============================================================================
+template <typename SampleType>
+void TSEngine<SampleType>::setStreamParameters (size_t stream, const StreamParameters& parameters) noexcept
+{
+    if (stream >= settings.numStreams || lanes == 0)
+        return;
+
+    drive.setTarget (stream, parameters.drive);
+    tone.setTarget (stream, parameters.tone);
+
+    levelValues[stream] = parameters.level;
+    level.setTarget (stream, parameters.level * float (circuits[size_t (circuitModel)].outputGain));
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::setAllStreamParameters (const StreamParameters& parameters) noexcept
+{
+    for (size_t stream = 0; stream < settings.numStreams; ++stream)
+        setStreamParameters (stream, parameters);
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::setDriveModel (DriveModel newModel) noexcept
+{
+    if (newModel == driveModel)
+        return;
+
+    driveModel = newModel;
+
+    // The model that did not run has stale state
+    driveFilter.reset();
+    antiderivative.reset();
+
+    for (auto& stage : waveDigitalStages)
+        stage.reset();
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::setCircuitModel (CircuitModel newModel) noexcept
+{
+    if (newModel == circuitModel)
+        return;
+
+    circuitModel = newModel;
+
+    // Unprepared, prepare() starts on the new circuit
+    if (lanes == 0)
+        return;
+
+    const auto& designs = circuits[size_t (circuitModel)];
+
+    // The variants share R1, C1 and Cf, so this leaves the wave digital stages
+    // as they were; the drive resistance blends with the filters
+    for (auto& stage : waveDigitalStages)
+        stage.setCircuit (designs.drive, settings.sampleRate * double (overSampler.getFactor()));
+
+    for (size_t lane = 0; lane < lanes; ++lane)
+        level.setTarget (lane, levelValues[lane] * float (designs.outputGain));
+
+    // Over the same length as the parameter ramps
+    const auto rampLength = drive.rampLength;
+
+    for (size_t model = 0; model < circuitWeights.size(); ++model)
+    {
+        const auto target = model == size_t (circuitModel) ? 1.0f : 0.0f;
+
+        if (rampLength <= 0)
+            circuitWeights[model] = target;
+        else
+            circuitSteps[model] = (target - circuitWeights[model]) / float (rampLength);
+    }
+
+    circuitCountdown = std::max (0, rampLength);
+
+    if (circuitCountdown == 0)
+    {
+        for (size_t lane = 0; lane < lanes; ++lane)
+        {
+            setDriveLane (lane, drive.current[lane]);
+            setToneLane (lane, tone.current[lane]);
+        }
+    }
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::setBypassed (bool shouldBeBypassed) noexcept
+{
+    if (shouldBeBypassed == bypassed)
+        return;
+
+    bypassed = shouldBeBypassed;
+
+    // The same length as the parameter ramps
+    const auto target = bypassed ? 1.0f : 0.0f;
+    const auto rampLength = drive.rampLength;
+
+    if (rampLength <= 0)
+    {
+        dryGain = target;
+        dryCountdown = 0;
+        return;
+    }
+
+    dryStep = (target - dryGain) / float (rampLength);
+    dryCountdown = rampLength;
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::setSleepEnabled (bool shouldSleep) noexcept
+{
+    sleepEnabled = shouldSleep;
+
+    // The state was cleared on the way to sleep, so processing can pick up at once
+    if (! sleepEnabled)
+        sleeping = false;
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::setClipper (DiodeClipper::Implementation implementation) noexcept
+{
+    const auto kernel = DiodeClipper::getFrameKernel (implementation);
+    frameKernel = kernel != nullptr ? kernel : DiodeClipper::getFrameKernel (DiodeClipper::Implementation::scalar);
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::setCoefficientUpdateInterval (int numSamples) noexcept
+{
+    coefficientUpdateInterval = std::max (1, numSamples);
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::resetMeters() noexcept
+{
+    std::fill (meters.begin(), meters.end(), TSMeterReading());
+}
+
+//==============================================================================
+template <typename SampleType>
+template <typename Circuit>
+void TSEngine<SampleType>::designCircuit (CircuitDesigns& designs, double sampleRate, double overSampledRate)
+{
+    designs.drive = Circuit::drive;
+    designs.driveTable.build (0.0f, 1.0f, parameterInterval,
+                              [=] (double value) { return designDriveFilter<Circuit> (value, overSampledRate); });
+    designs.toneTable.build (0.0f, 1.0f, parameterInterval,
+                             [=] (double value) { return designToneFilter<Circuit> (value, sampleRate); });
+    designs.outputGain = getOutputGain (Circuit::output);
+}
+
+//==============================================================================
+// Each lane runs the circuits' designs by their weights: one circuit's own, or
+// while switching, a blend of two or more. The blend stays stable, as every
+// design is and the stable region of (a1, a2) is a triangle.
+template <typename SampleType>
+void TSEngine<SampleType>::setDriveLane (size_t lane, float value) noexcept
+{
+    BiquadCoefficients coefficients { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    double R2 = 0.0;
+
+    for (size_t model = 0; model < circuits.size(); ++model)
+    {
+        const auto weight = double (circuitWeights[model]);
+
+        if (weight == 0.0)
+            continue;
+
+        const auto& designs = circuits[model];
+        addWeighted (coefficients, designs.driveTable.interpolate (value), weight);
+        R2 += weight * (double (designs.drive.Rf) + double (value) * double (designs.drive.Rpot));
+    }
+
+    driveFilter.setCoefficients (lane, coefficients);
+
+    if (std::is_same<SampleType, float>::value)
+        clipperLanes.set (lane, float (R2));
+    else
+        inverseK[lane] = 1.0 / (2.0 * double (DiodeClipper::Is) * R2);
+
+    if (settings.clipperAntiAliasing != DiodeClipper::AntiAliasing::none)
+        antiderivative.set (lane, R2);
+
+    const auto limit = DiodeClipper::getLimitVoltage (R2);
+    limitVoltage[lane] = SampleType (limit);
+    heavyClipVoltage[lane] = SampleType (limit * double (heavyClipRatio));
+
+    auto& stage = waveDigitalStages[lane / registerLanes];
+    stage.setDriveResistance (lane % registerLanes, SampleType (R2));
+
+    const auto diodeLimit = DiodeClipper::getLimitVoltage (double (stage.getDiodeResistance (lane % registerLanes)));
+    diodeLimitVoltage[lane] = SampleType (diodeLimit);
+    diodeHeavyClipVoltage[lane] = SampleType (diodeLimit * double (heavyClipRatio));
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::setToneLane (size_t lane, float value) noexcept
+{
+    BiquadCoefficients coefficients { 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+    for (size_t model = 0; model < circuits.size(); ++model)
+        if (circuitWeights[model] != 0.0f)
+            addWeighted (coefficients, circuits[model].toneTable.interpolate (value), double (circuitWeights[model]));
+
+    const auto gain = double (toneGains[lane]);
+    coefficients.b0 *= gain;
+    coefficients.b1 *= gain;
+    coefficients.b2 *= gain;
+
+    toneFilter.setCoefficients (lane, coefficients);
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::updateLevelFolding() noexcept
+{
+    // A zero gain would lose the filter states, so those levels stay unfolded
+    const bool fold = ! level.isSmoothing()
+                        && std::none_of (level.current.begin(), level.current.end(), [] (float gain) { return gain == 0.0f; });
+
+    if (! fold && ! levelFolded)
+        return;
+
+    for (size_t lane = 0; lane < lanes; ++lane)
+    {
+        const auto gain = fold ? level.current[lane] : 1.0f;
+
+        if (gain == toneGains[lane])
+            continue;
+
+        toneFilter.scaleState (lane, SampleType (gain) / SampleType (toneGains[lane]));
+        toneGains[lane] = gain;
+        setToneLane (lane, tone.current[lane]);
+    }
+
+    levelFolded = fold;
+}
+
+template <typename SampleType>
+bool TSEngine<SampleType>::isSmoothing() const noexcept
+{
+    return drive.isSmoothing() || tone.isSmoothing() || circuitCountdown > 0;
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::advanceSmoothing (int numSamples) noexcept
+{
+    TS_PROFILE_LAP (profiler)
+
+    // Mid switch every lane moves, whatever its parameters do
+    const bool switching = circuitCountdown > 0;
+
+    if (switching)
+    {
+        if (numSamples >= circuitCountdown)
+        {
+            circuitWeights.fill (0.0f);
+            circuitWeights[size_t (circuitModel)] = 1.0f;
+            circuitCountdown = 0;
+        }
+        else
+        {
+            for (size_t model = 0; model < circuitWeights.size(); ++model)
+                circuitWeights[model] += circuitSteps[model] * float (numSamples);
+
+            circuitCountdown -= numSamples;
+        }
+    }
+
+    for (size_t lane = 0; lane < lanes; ++lane)
+    {
+        const bool driveMoves = drive.countdown[lane] > 0;
+        const bool toneMoves = tone.countdown[lane] > 0;
+
+        if (driveMoves)
+            drive.skip (lane, numSamples);
+
+        if (toneMoves)
+            tone.skip (lane, numSamples);
+
+        if (driveMoves || switching)
+            setDriveLane (lane, drive.current[lane]);
+
+        if (toneMoves || switching)
+            setToneLane (lane, tone.current[lane]);
+    }
+
+    TS_PROFILE_MARK (smoothing)
+}
+
+//==============================================================================
+template <typename SampleType>
+void TSEngine<SampleType>::process (const SampleType* const* inputs, SampleType* const* outputs, size_t numSamples) noexcept
+{
+    process (inputs, outputs, 0, numSamples);
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::process (const SampleType* const* inputs, SampleType* const* outputs,
+                                    size_t startSample, size_t numSamples) noexcept
+{
+    if (lanes == 0)
+        return;
+
+    ScopedFlushDenormals flushDenormals;
+
+    for (size_t offset = 0; offset < numSamples; offset += settings.tileSize)
+        processTile (inputs, outputs, startSample + offset, std::min (settings.tileSize, numSamples - offset));
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::processTile (const SampleType* const* inputs, SampleType* const* outputs,
+                                         size_t offset, size_t numSamples) noexcept
+{
+    if (sleeping)
+    {
+        if (getInputPeak (inputs, offset, numSamples) <= SampleType (silenceThreshold))
+        {
+            writeSilence (outputs, offset, numSamples);
+            return;
+        }
+
+        sleeping = false;
+    }
+
+    const auto inputPeak = readInputs (inputs, offset, numSamples);
+
+    if (isFullyBypassed())
+    {
+        processingIdle = true;
+    }
+    else
+    {
+        // Back from bypass the signal path starts from silence, under the crossfade
+        if (processingIdle)
+        {
+            resetProcessing();
+            processingIdle = false;
+        }
+
+        updateLevelFolding();
+
+        // While drive, tone or the circuit are moving, the filters are redesigned every
+        // coefficientUpdateInterval samples, counted across calls so that however
+        // finely a caller splits its blocks the redesigns stay as sparse. Steady
+        // blocks go through in one pass.
+        if (isSmoothing())
+        {
+            for (size_t start = 0; start < numSamples;)
+            {
+                if (samplesUntilUpdate <= 0)
+                {
+                    advanceSmoothing (coefficientUpdateInterval);
+                    samplesUntilUpdate = coefficientUpdateInterval;
+                }
+
+                const auto length = std::min (size_t (samplesUntilUpdate), numSamples - start);
+                processSubBlock (frames.data() + start * lanes, length);
+
+                samplesUntilUpdate -= int (length);
+                start += length;
+            }
+        }
+        else
+        {
+            processSubBlock (frames.data(), numSamples);
+            samplesUntilUpdate = 0;
+        }
+    }
+
+    const auto outputPeak = writeOutputs (outputs, offset, numSamples);
+
+    // Silent in for the whole tail and silent out: nothing is left ringing
+    silentSamples = inputPeak <= SampleType (silenceThreshold) ? silentSamples + numSamples : 0;
+
+    if (sleepEnabled && silentSamples >= size_t (tailSamples) && outputPeak <= SampleType (silenceThreshold))
+    {
+        reset();
+        sleeping = true;
+    }
+}
+
+template <typename SampleType>
+SampleType TSEngine<SampleType>::readInputs (const SampleType* const* inputs, size_t offset, size_t numSamples) noexcept
+{
+    TS_PROFILE_LAP (profiler)
+    auto* data = frames.data();
+    SampleType tilePeak (0);
+
+    for (size_t stream = 0; stream < settings.numStreams; ++stream)
+    {
+        const auto* input = inputs[stream] + offset;
+        SampleType peak (0);
+
+        if (meteringEnabled)
+        {
+            SampleType squares (0);
+
+            for (size_t n = 0; n < numSamples; ++n)
+            {
+                const auto x = input[n];
+                data[n * lanes + stream] = x;
+                peak = std::max (peak, std::abs (x));
+                squares += x * x;
+            }
+
+            auto& meter = meters[stream];
+            meter.inputPeak = std::max (meter.inputPeak, float (peak));
+            meter.inputSquares += double (squares);
+            meter.numSamples += numSamples;
+        }
+        else
+        {
+            for (size_t n = 0; n < numSamples; ++n)
+            {
+                const auto x = input[n];
+                data[n * lanes + stream] = x;
+                peak = std::max (peak, std::abs (x));
+            }
+        }
+
+        tilePeak = std::max (tilePeak, peak);
+    }
+
+    // Padding lanes carry silence, which every stage maps to silence
+    for (size_t n = 0; n < numSamples; ++n)
+        std::fill (data + n * lanes + settings.numStreams, data + (n + 1) * lanes, SampleType (0));
+
+    // The dry signal for bypass, delayed by the latency
+    auto* dry = dryFrames.data();
+    const auto delayLength = dryDelay.size() / lanes;
+
+    if (delayLength == 0)
+    {
+        std::copy (data, data + numSamples * lanes, dry);
+    }
+    else
+    {
+        for (size_t n = 0; n < numSamples; ++n)
+        {
+            auto* slot = dryDelay.data() + dryPosition * lanes;
+            std::copy (slot, slot + lanes, dry + n * lanes);
+            std::copy (data + n * lanes, data + (n + 1) * lanes, slot);
+
+            if (++dryPosition == delayLength)
+                dryPosition = 0;
+        }
+    }
+
+    TS_PROFILE_MARK (input)
+    return tilePeak;
+}
+
+template <typename SampleType>
+SampleType TSEngine<SampleType>::writeOutputs (SampleType* const* outputs, size_t offset, size_t numSamples) noexcept
+{
+    TS_PROFILE_LAP (profiler)
+    auto* data = frames.data();
+    SampleType tilePeak (0);
+
+    if (! isFullyBypassed() && ! levelFolded)
+        applyLevel (data, numSamples);
+
+    mixDry (data, numSamples);
+
+    for (size_t stream = 0; stream < settings.numStreams; ++stream)
+    {
+        auto* output = outputs[stream] + offset;
+        SampleType peak (0);
+
+        if (meteringEnabled)
+        {
+            SampleType squares (0);
+
+            for (size_t n = 0; n < numSamples; ++n)
+            {
+                const auto y = data[n * lanes + stream];
+                output[n] = y;
+                peak = std::max (peak, std::abs (y));
+                squares += y * y;
+            }
+
+            auto& meter = meters[stream];
+            meter.outputPeak = std::max (meter.outputPeak, float (peak));
+            meter.outputSquares += double (squares);
+        }
+        else
+        {
+            for (size_t n = 0; n < numSamples; ++n)
+            {
+                const auto y = data[n * lanes + stream];
+                output[n] = y;
+                peak = std::max (peak, std::abs (y));
+            }
+        }
+
+        tilePeak = std::max (tilePeak, peak);
+    }
+
+    TS_PROFILE_MARK (output)
+    return tilePeak;
+}
+
+template <typename SampleType>
+SampleType TSEngine<SampleType>::getInputPeak (const SampleType* const* inputs, size_t offset, size_t numSamples) const noexcept
+{
+    SampleType peak (0);
+
+    for (size_t stream = 0; stream < settings.numStreams; ++stream)
+    {
+        const auto* input = inputs[stream] + offset;
+
+        for (size_t n = 0; n < numSamples; ++n)
+            peak = std::max (peak, std::abs (input[n]));
+    }
+
+    return peak;
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::writeSilence (SampleType* const* outputs, size_t offset, size_t numSamples) noexcept
+{
+    for (size_t stream = 0; stream < settings.numStreams; ++stream)
+        std::fill (outputs[stream] + offset, outputs[stream] + offset + numSamples, SampleType (0));
+
+    // The meters keep time while asleep, with nothing above the threshold to show
+    if (meteringEnabled)
+        for (auto& meter : meters)
+            meter.numSamples += numSamples;
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::mixDry (SampleType* block, size_t numFrames) noexcept
+{
+    const auto* dry = dryFrames.data();
+
+    if (dryCountdown == 0)
+    {
+        if (bypassed)
+            std::copy (dry, dry + numFrames * lanes, block);
+
+        return;
+    }
+
+    for (size_t n = 0; n < numFrames; ++n)
+    {
+        if (dryCountdown > 0)
+        {
+            if (--dryCountdown == 0)
+                dryGain = bypassed ? 1.0f : 0.0f;
+            else
+                dryGain += dryStep;
+        }
+
+        const auto gain = SampleType (dryGain);
+
+        for (size_t lane = 0; lane < lanes; ++lane)
+        {
+            const auto i = n * lanes + lane;
+            block[i] += gain * (dry[i] - block[i]);
+        }
+    }
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::processSubBlock (SampleType* block, size_t numFrames) noexcept
+{
+    // Unfused, the whole sub-block is one slice
+    const auto length = fusedProcessing ? sliceFrames : numFrames;
+
+    for (size_t start = 0; start < numFrames; start += length)
+        processSlice (block + start * lanes, std::min (length, numFrames - start));
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::processSlice (SampleType* block, size_t numFrames) noexcept
+{
+    TS_PROFILE_LAP (profiler)
+
+    auto* overSampled = overSampler.processUp (block, numFrames);
+    const auto numOverSampled = numFrames * overSampler.getFactor();
+    TS_PROFILE_MARK (upsample)
+
+    if (driveModel == DriveModel::waveDigital)
+    {
+        // Recursive sample by sample. Stepping every register within each frame
+        // lets one register's solve overlap the next's.
+        for (size_t n = 0; n < numOverSampled; ++n)
+        {
+            auto* frame = overSampled + n * lanes;
+
+            for (size_t i = 0; i < waveDigitalStages.size(); ++i)
+            {
+                auto& stage = waveDigitalStages[i];
+                stage.processFrames (frame + i * registerLanes, 1, lanes);
+
+                // What drove the diodes is gone from the frame, so it is kept aside for the meters
+                if (meteringEnabled)
+                    stage.getDiodeDrive().store (driven.data() + n * lanes + i * registerLanes);
+            }
+        }
+
+        if (meteringEnabled)
+            meterClipper (driven.data(), numOverSampled, diodeLimitVoltage.data(), diodeHeavyClipVoltage.data());
+
+        padClipper (overSampled, numOverSampled, waveDigitalPadding);
+        TS_PROFILE_MARK (waveDigital)
+    }
+    else
+    {
+        // The op-amp output is its input plus the voltage across the diodes
+        driveFilter.process (overSampled, driven.data(), numOverSampled);
+        TS_PROFILE_MARK (driveFilter)
+
+        if (meteringEnabled)
+            meterClipper (driven.data(), numOverSampled, limitVoltage.data(), heavyClipVoltage.data());
+
+        if (settings.clipperAntiAliasing != DiodeClipper::AntiAliasing::none)
+            antiderivative.process (settings.clipperAntiAliasing, driven.data(), overSampled, numOverSampled);
+        else
+            clip (driven.data(), overSampled, numOverSampled);
+
+        padClipper (overSampled, numOverSampled, filterAndClipperPadding);
+        TS_PROFILE_MARK (clipper)
+    }
+
+    overSampler.processDown (block, numFrames);
+    TS_PROFILE_MARK (downsample)
+
+    toneFilter.process (block, block, numFrames);
+    TS_PROFILE_MARK (toneFilter)
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::clip (const float* input, float* destination, size_t numFrames) noexcept
+{
+    frameKernel (input, destination, numFrames, lanes, clipperLanes);
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::clip (const double* input, double* destination, size_t numFrames) noexcept
+{
+    DiodeClipper::processDoubleFrames (input, destination, numFrames, lanes, inverseK.data());
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::padClipper (SampleType* block, size_t numFrames, int halfSamples) noexcept
+{
+    if (halfSamples == 0)
+        return;
+
+    const auto length = clipperPaddingDelay.size() / lanes;
+    const auto early = size_t (halfSamples / 2), late = size_t ((halfSamples + 1) / 2);
+
+    for (size_t n = 0; n < numFrames; ++n)
+    {
+        auto* frame = block + n * lanes;
+        std::copy (frame, frame + lanes, clipperPaddingDelay.data() + clipperPaddingPosition * lanes);
+
+        const auto* a = clipperPaddingDelay.data() + (clipperPaddingPosition + length - early) % length * lanes;
+        const auto* b = clipperPaddingDelay.data() + (clipperPaddingPosition + length - late) % length * lanes;
+
+        for (size_t lane = 0; lane < lanes; ++lane)
+            frame[lane] = SampleType (0.5) * (a[lane] + b[lane]);
+
+        if (++clipperPaddingPosition == length)
+            clipperPaddingPosition = 0;
+    }
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::applyLevel (SampleType* block, size_t numFrames) noexcept
+{
+    // A plain gain per lane once the level has settled
+    if (! level.isSmoothing())
+    {
+        const auto* gain = level.current.data();
+
+        for (size_t n = 0; n < numFrames; ++n)
+            for (size_t lane = 0; lane < lanes; ++lane)
+                block[n * lanes + lane] *= SampleType (gain[lane]);
+
+        return;
+    }
+
+    // Per sample steps while it moves, as LinearSmoothedValue::getNextValue()
+    for (size_t n = 0; n < numFrames; ++n)
+    {
+        for (size_t lane = 0; lane < lanes; ++lane)
+        {
+            if (level.countdown[lane] > 0)
+            {
+                if (--level.countdown[lane] == 0)
+                    level.current[lane] = level.target[lane];
+                else
+                    level.current[lane] += level.step[lane];
+            }
+
+            block[n * lanes + lane] *= SampleType (level.current[lane]);
+        }
+    }
+}
+
+template <typename SampleType>
+void TSEngine<SampleType>::meterClipper (const SampleType* input, size_t numFrames,
+                                         const SampleType* limit, const SampleType* heavy) noexcept
+{
+    auto* limited = limitedCounts.data();
+    auto* heavilyClipped = heavilyClippedCounts.data();
+
+    // Branch free counts per lane, which vectorise like the kernels
+    for (size_t n = 0; n < numFrames; ++n)
+    {
+        const auto* x = input + n * lanes;
+
+        for (size_t lane = 0; lane < lanes; ++lane)
+        {
+            const auto ax = std::abs (x[lane]);
+            limited[lane] += uint32_t (ax <= limit[lane]);
+            heavilyClipped[lane] += uint32_t (ax > heavy[lane]);
+        }
+    }
+
+    for (size_t stream = 0; stream < settings.numStreams; ++stream)
+    {
+        auto& meter = meters[stream];
+        meter.numClipperSamples += numFrames;
+        meter.numLimited += limited[stream];
+        meter.numHeavilyClipped += heavilyClipped[stream];
+    }
+
+    std::fill (limitedCounts.begin(), limitedCounts.end(), 0u);
+    std::fill (heavilyClippedCounts.begin(), heavilyClippedCounts.end(), 0u);
+}
+
+//==============================================================================
+template class TSEngine<float>;
+template class TSEngine<double>;
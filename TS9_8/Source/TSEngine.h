@@ -0,0 +1,403 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "TSBiquad.h"
+#include "TSCircuit.h"
+#include "TSClipper.h"
+#include "TSCoefficientTable.h"
+#include "TSOversampler.h"
+#include "TSProfiler.h"
+#include "TSWaveDigital.h"
+
+// What a TSEngine is prepared for, the same for either sample type
+struct TSEngineSettings
+{
+    double sampleRate = 44100.0;
+
+    // process() runs the chain over tiles of at most this many samples, whatever
+    // length it is called with, so its memory and the working set of each stage
+    // depend on the tile and not on the host's block size. Small tiles keep a
+    // tile's frames at the oversampled rate in cache; large ones spread the per
+    // tile costs thinner (see TSBench tiles).
+    static constexpr size_t defaultTileSize = 128;
+    size_t tileSize = defaultTileSize;
+
+    size_t numStreams = 2;
+
+    // 0 to Oversampler::maxStages, a factor of 2^stages
+    int overSamplingStages = 1;
+    OversamplingFilter overSamplingFilter = OversamplingFilter::linearPhaseFIR;
+
+    // Antiderivative anti-aliasing of the diode clipper (see DiodeClipper::Antiderivative),
+    // which lets a lower oversampling factor reach the same aliasing. Not for the
+    // wave digital model, which solves the diodes implicitly.
+    DiodeClipper::AntiAliasing clipperAntiAliasing = DiodeClipper::AntiAliasing::none;
+
+    double smoothingSeconds = 0.05;
+};
+
+// Levels and clipper activity a TSEngine measured, accumulated until taken. Two
+// readings merge into one covering both, whether later samples of one stream or
+// other streams.
+struct TSMeterReading
+{
+    float inputPeak = 0.0f;
+    float outputPeak = 0.0f;
+    double inputSquares = 0.0;
+    double outputSquares = 0.0;
+    uint64_t numSamples = 0;
+
+    // Oversampled clipper inputs, those the |U| <= |x| limit passed straight
+    // through and those driven hard into the diodes. The wave digital model
+    // counts the voltage its feedback network drives across the diodes, against
+    // the limit for the resistance they see.
+    uint64_t numClipperSamples = 0;
+    uint64_t numLimited = 0;
+    uint64_t numHeavilyClipped = 0;
+
+    void merge (const TSMeterReading& other) noexcept
+    {
+        inputPeak = std::max (inputPeak, other.inputPeak);
+        outputPeak = std::max (outputPeak, other.outputPeak);
+        inputSquares += other.inputSquares;
+        outputSquares += other.outputSquares;
+        numSamples += other.numSamples;
+        numClipperSamples += other.numClipperSamples;
+        numLimited += other.numLimited;
+        numHeavilyClipped += other.numHeavilyClipped;
+    }
+
+    float getInputRms() const noexcept     { return numSamples > 0 ? float (std::sqrt (inputSquares / double (numSamples))) : 0.0f; }
+    float getOutputRms() const noexcept    { return numSamples > 0 ? float (std::sqrt (outputSquares / double (numSamples))) : 0.0f; }
+
+    float getLimitedFraction() const noexcept          { return numClipperSamples > 0 ? float (double (numLimited) / double (numClipperSamples)) : 0.0f; }
+    float getHeavilyClippedFraction() const noexcept   { return numClipperSamples > 0 ? float (double (numHeavilyClipped) / double (numClipperSamples)) : 0.0f; }
+};
+
+//==============================================================================
+// The complete Tube Screamer signal path, free of JUCE, for any number of
+// independent streams:
+//
+//     upsample -> drive filter + diode clipper (or the wave digital drive stage)
+//              -> downsample -> tone filter -> level
+//
+// Each stream has its own drive, tone and level, smoothed per stream. All state
+// is kept as struct of arrays with one lane per stream (filter coefficients and
+// histories, clipper constants, smoothers), and the samples travel interleaved
+// in frames, so every stage advances all streams in one call: a kernel over a
+// frame runs across lanes and vectorises whatever the stream count. Lanes are
+// padded to a whole SIMD register; the padding carries silence.
+//
+// The plugin runs one engine with a stream per channel; a server can run
+// hundreds of streams through one. Nothing here allocates or locks after
+// prepare(), and process() may be called from a realtime thread. The setters
+// are not synchronised with process(); call them from the same thread.
+template <typename SampleType>
+class TSEngine
+{
+public:
+    using Settings = TSEngineSettings;
+
+    // Normalised 0..1, as the plugin parameters
+    struct StreamParameters
+    {
+        float drive = 0.5f;
+        float tone = 0.8f;
+        float level = 0.5f;
+    };
+
+    enum class DriveModel
+    {
+        filterAndClipper,
+        waveDigital
+    };
+
+    // Allocates and designs everything, every stream at the default parameters.
+    // Never call this on a realtime thread.
+    void prepare (const Settings&);
+
+    // Frees everything prepare() allocated
+    void release();
+
+    // Clears every filter and model history and jumps every ramp to its target
+    void reset() noexcept;
+
+    bool isPrepared() const noexcept                { return lanes > 0; }
+    const Settings& getSettings() const noexcept    { return settings; }
+    int getLatencySamples() const noexcept          { return overSampler.getLatencyInSamples() + clipperLatency; }
+
+    // Samples until the response to an impulse has died away by 120 dB, at any
+    // drive and tone: the oversampler's tail plus the decay of the slowest
+    // drive and tone filter poles
+    int getTailSamples() const noexcept             { return tailSamples; }
+
+    // New targets for one stream, reached over the smoothing time
+    void setStreamParameters (size_t stream, const StreamParameters&) noexcept;
+    void setAllStreamParameters (const StreamParameters&) noexcept;
+
+    // The model that takes over starts from silence
+    void setDriveModel (DriveModel) noexcept;
+    DriveModel getDriveModel() const noexcept    { return driveModel; }
+
+    // Which circuit variant runs (see TSCircuit.h). Every variant is designed in
+    // prepare(), so a switch allocates nothing: the filters, the clipper and the
+    // output gain blend from one variant's designs to the other's over the
+    // smoothing time, without clearing any state.
+    void setCircuitModel (CircuitModel) noexcept;
+    CircuitModel getCircuitModel() const noexcept    { return circuitModel; }
+
+    // Which clipper kernel the float engine runs; the double engine always
+    // evaluates the exact curve. Falls back to the scalar kernel if the CPU
+    // cannot run the one asked for.
+    void setClipper (DiodeClipper::Implementation) noexcept;
+
+    // Fused (the default), each sub-block goes through every stage in slices of
+    // at most fusedSliceBytes of oversampled frames, so a slice stays in L1 from
+    // the upsampler to the tone filter instead of each stage streaming the whole
+    // tile. Unfused runs a stage over the whole sub-block before the next. Both
+    // give the same output; the unfused path is kept for comparison.
+    void setFusedProcessing (bool shouldFuse) noexcept    { fusedProcessing = shouldFuse; }
+    bool isFusedProcessing() const noexcept               { return fusedProcessing; }
+
+    static constexpr size_t fusedSliceBytes = 8192;
+
+    // While drive or tone are smoothing, their filters are redesigned every this many samples
+    void setCoefficientUpdateInterval (int numSamples) noexcept;
+    int getCoefficientUpdateInterval() const noexcept    { return coefficientUpdateInterval; }
+
+    // Crossfades over the smoothing time to the input, delayed by the latency so
+    // neither the level nor the timing jumps, and once faded skips all of the
+    // processing. Coming back, the signal path starts from silence.
+    void setBypassed (bool shouldBeBypassed) noexcept;
+    bool isBypassed() const noexcept    { return bypassed; }
+
+    // With sleep enabled (the default), once every input has stayed below
+    // silenceThreshold for the tail length and the outputs have died away below
+    // it too, the state is cleared and process() writes silence, only checking
+    // the inputs, until a sample above the threshold arrives
+    void setSleepEnabled (bool shouldSleep) noexcept;
+    bool isSleeping() const noexcept    { return sleeping; }
+
+    // -120 dB
+    static constexpr float silenceThreshold = 1.0e-6f;
+
+    // While enabled, process() measures every stream into its meter (see
+    // TSMeterReading) on the way in and out of the frames, for a few percent of
+    // the processing time
+    void setMeteringEnabled (bool shouldMeter) noexcept    { meteringEnabled = shouldMeter; }
+    bool isMeteringEnabled() const noexcept                { return meteringEnabled; }
+
+    // What was measured of one stream since the meters were last reset
+    const TSMeterReading& getMeter (size_t stream) const noexcept    { return meters[stream]; }
+    void resetMeters() noexcept;
+
+    // Clipper inputs past this many times the limit voltage count as heavily
+    // clipped: the diodes then take out more than 11 dB
+    static constexpr float heavyClipRatio = 4.0f;
+
+    // Where process() adds up its stage timings, when built with
+    // TS_PROFILE_STAGES=1; nullptr to stop. The profiler must be prepared. The
+    // caller opens the record of each callback (TS_PROFILE_CALLBACK) around all
+    // of the process() calls it makes for it.
+    void setProfiler (StageProfiler* newProfiler) noexcept    { profiler = newProfiler; }
+
+    // One planar buffer per stream. inputs and outputs may be the same buffers.
+    void process (const SampleType* const* inputs, SampleType* const* outputs, size_t numSamples) noexcept;
+
+    // The same over samples startSample to startSample + numSamples of the buffers,
+    // for callers that split a block to change parameters at exact samples. The
+    // redesign interval carries across calls, so splitting costs no extra redesigns.
+    void process (const SampleType* const* inputs, SampleType* const* outputs, size_t startSample, size_t numSamples) noexcept;
+
+private:
+    // The parameter quantisation the coefficient tables are built for
+    static constexpr float parameterInterval = 0.001f;
+
+    // Per lane linear ramps, the struct of arrays form of juce::LinearSmoothedValue
+    struct Ramps
+    {
+        std::vector<float> current, target, step;
+        std::vector<int> countdown;
+        int rampLength = 0;
+
+        void prepare (size_t numLanes, int numRampSamples);
+        void release();
+        void setTarget (size_t lane, float value) noexcept;
+        void skip (size_t lane, int numSamples) noexcept;
+        void finish() noexcept;
+        bool isSmoothing() const noexcept;
+    };
+
+    // One Newton step keeps the diode solve within 2e-4 V in float (see
+    // WaveDigital::DiodePairRoot); double takes three to reach its own precision
+    static constexpr int waveDigitalIterations = std::is_same<SampleType, double>::value ? 3 : 1;
+
+    // Lanes are padded to whole 16 byte registers, and each wave digital stage
+    // runs one register of them
+    static constexpr size_t registerLanes = 16 / sizeof (SampleType);
+
+    using WaveDigitalStage = WaveDigital::DriveStage<WaveDigital::Lanes<SampleType, registerLanes>, waveDigitalIterations>;
+
+    // At most tileSize samples
+    void processTile (const SampleType* const* inputs, SampleType* const* outputs, size_t offset, size_t numSamples) noexcept;
+
+    // Planar buffers into the frames and back, metering on the way; writeOutputs applies the level
+    // unless it is folded into the tone filters.
+    // Both return the peak over every stream. readInputs also runs the dry delay.
+    SampleType readInputs (const SampleType* const* inputs, size_t offset, size_t numSamples) noexcept;
+    SampleType writeOutputs (SampleType* const* outputs, size_t offset, size_t numSamples) noexcept;
+
+    // While asleep: the input peak without touching the frames, and silence out
+    SampleType getInputPeak (const SampleType* const* inputs, size_t offset, size_t numSamples) const noexcept;
+    void writeSilence (SampleType* const* outputs, size_t offset, size_t numSamples) noexcept;
+
+    // Clears the histories of the signal path, not the dry delay
+    void resetProcessing() noexcept;
+
+    // Fully bypassed and not fading: nothing but the dry delay runs
+    bool isFullyBypassed() const noexcept    { return bypassed && dryCountdown == 0; }
+
+    // Blends the delayed input into the frames by the bypass crossfade
+    void mixDry (SampleType* frames, size_t numFrames) noexcept;
+    void processSubBlock (SampleType* frames, size_t numFrames) noexcept;
+
+    // Upsampling, drive, downsampling and the tone filter over frames in place
+    void processSlice (SampleType* frames, size_t numFrames) noexcept;
+
+    // One circuit variant's designs at the prepared rates
+    struct CircuitDesigns
+    {
+        DriveStageValues drive;
+        CoefficientTable driveTable;    // at the oversampled rate
+        CoefficientTable toneTable;
+        double outputGain = 1.0;
+    };
+
+    template <typename Circuit>
+    static void designCircuit (CircuitDesigns&, double sampleRate, double overSampledRate);
+
+    bool isSmoothing() const noexcept;
+
+    // Advances the drive, tone and circuit ramps by numSamples and redesigns the lanes that moved
+    void advanceSmoothing (int numSamples) noexcept;
+
+    void setDriveLane (size_t lane, float drive) noexcept;
+    void setToneLane (size_t lane, float tone) noexcept;
+
+    // Float runs the selected frame kernel, double the exact curve
+    void clip (const float* input, float* destination, size_t numFrames) noexcept;
+    void clip (const double* input, double* destination, size_t numFrames) noexcept;
+
+    void applyLevel (SampleType* frames, size_t numFrames) noexcept;
+
+    // A settled, nonzero level is folded into the tone filters' b coefficients,
+    // saving writeOutputs a pass; while it ramps, applyLevel runs instead.
+    // Rescales the filter states on a change, so the output carries on smoothly.
+    void updateLevelFolding() noexcept;
+
+    // Counts the clipper inputs below the limit voltage and past heavyClipRatio times it
+    void meterClipper (const SampleType* input, size_t numFrames, const SampleType* limit, const SampleType* heavy) noexcept;
+
+    // Delays oversampled frames by halfSamples / 2 samples, averaging the two
+    // frames either side for an odd count, through clipperPaddingDelay
+    void padClipper (SampleType* frames, size_t numFrames, int halfSamples) noexcept;
+
+    Settings settings;
+
+    // Streams rounded up to a whole SIMD register
+    size_t lanes = 0;
+
+    Oversampler<SampleType> overSampler;
+    BiquadBank<SampleType> driveFilter, toneFilter;
+
+    // Every quantised drive and tone design of every circuit variant
+    std::array<CircuitDesigns, numCircuitModels> circuits;
+    CircuitModel circuitModel = CircuitModel::custom;
+
+    // How much of each variant's designs the lanes run: one-hot, or ramping
+    // linearly towards it after a switch
+    std::array<float, numCircuitModels> circuitWeights {}, circuitSteps {};
+    int circuitCountdown = 0;
+
+    // Clipper constants per lane: the float kernels' table, or 1 / (2 Is R2) in double
+    DiodeClipper::LaneParameters clipperLanes;
+    std::vector<double> inverseK;
+    DiodeClipper::FrameKernel frameKernel = nullptr;
+
+    // Runs instead of the kernels while clipperAntiAliasing is on. Its delay is
+    // padded to whole samples at the host rate, clipperLatency of them, which
+    // count towards the latency. Each drive model is padded by what it lacks of
+    // that, in half samples at the oversampled rate: the wave digital model,
+    // which never runs the antiderivative, by all of it.
+    DiodeClipper::Antiderivative antiderivative;
+    int clipperLatency = 0;
+    int filterAndClipperPadding = 0, waveDigitalPadding = 0;
+
+    // A ring of oversampled frames for the padding
+    std::vector<SampleType> clipperPaddingDelay;
+    size_t clipperPaddingPosition = 0;
+
+    // Per lane |x| of the clipper limit, and heavyClipRatio times it
+    std::vector<SampleType> limitVoltage, heavyClipVoltage;
+
+    // The same for the wave digital diodes, from the resistance they see
+    std::vector<SampleType> diodeLimitVoltage, diodeHeavyClipVoltage;
+
+    // One per register of lanes, stepped together frame by frame
+    std::vector<WaveDigitalStage> waveDigitalStages;
+    DriveModel driveModel = DriveModel::filterAndClipper;
+
+    Ramps drive, tone, level;
+
+    // The level parameter per lane; the level ramps run it times the output gain
+    std::vector<float> levelValues;
+
+    // The gain per lane folded into the tone filters, 1 while unfolded
+    std::vector<float> toneGains;
+    bool levelFolded = false;
+
+    // Interleaved frames of one tile, and the drive filter output at the oversampled rate
+    std::vector<SampleType> frames, driven;
+
+    bool fusedProcessing = true;
+
+    // Base rate frames per slice while fused
+    size_t sliceFrames = 1;
+
+    int coefficientUpdateInterval = 32;
+
+    // Samples until the next redesign while smoothing
+    int samplesUntilUpdate = 0;
+
+    // The input delayed by the latency: a ring of latency frames, and the current tile's dry frames
+    std::vector<SampleType> dryDelay, dryFrames;
+    size_t dryPosition = 0;
+
+    // Bypass crossfade, 0 all processed to 1 all dry
+    bool bypassed = false;
+    float dryGain = 0.0f;
+    float dryStep = 0.0f;
+    int dryCountdown = 0;
+
+    // The signal path was skipped and holds stale state
+    bool processingIdle = false;
+
+    bool sleepEnabled = true;
+    bool sleeping = false;
+    size_t silentSamples = 0;
+    int tailSamples = 0;
+
+    StageProfiler* profiler = nullptr;
+
+    bool meteringEnabled = false;
+    std::vector<TSMeterReading> meters;
+
+    // Per lane clipper counts of the current tile
+    std::vector<uint32_t> limitedCounts, heavilyClippedCounts;
+};
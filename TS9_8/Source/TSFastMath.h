@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined (__x86_64__) || defined (_M_X64)
+ #define TS_FAST_MATH_SSE2 1
+ #include <immintrin.h>
+#else
+ #define TS_FAST_MATH_SSE2 0
+#endif
+
+// Float log and exp accurate to a few ulp over the ranges the DSP uses, built
+// from plain arithmetic and bit manipulation so they inline (and vectorise)
+// without a library call.
+namespace FastMath
+{
+    inline float bitsToFloat (uint32_t bits) noexcept    { float f; std::memcpy (&f, &bits, sizeof (f)); return f; }
+    inline uint32_t floatToBits (float f) noexcept       { uint32_t bits; std::memcpy (&bits, &f, sizeof (bits)); return bits; }
+
+    constexpr float ln2 = 0.693147180559945f;
+
+    constexpr uint32_t sqrtHalfBits = 0x3f3504f3; // sqrt (1/2)
+
+    // log (w) for positive normal w. The argument is reduced to m * 2^e with
+    // m in [sqrt(1/2), sqrt(2)), and log (m) = 2 * atanh (t), t = (m - 1) / (m + 1),
+    // from a four term odd series (truncation error below 3e-8).
+    inline float log (float w) noexcept
+    {
+        // Series coefficients of 2 * atanh (t) / t in t^2
+        constexpr float c1 = 2.0f / 3.0f;
+        constexpr float c2 = 2.0f / 5.0f;
+        constexpr float c3 = 2.0f / 7.0f;
+
+        // Offset the exponent so the mantissa lands in [sqrt(1/2), sqrt(2))
+        const auto bits = floatToBits (w) + (0x3f800000 - sqrtHalfBits);
+        const auto exponent = float (int32_t (bits >> 23) - 127);
+        const auto m = bitsToFloat ((bits & 0x007fffff) + sqrtHalfBits);
+
+        const auto t = (m - 1.0f) / (m + 1.0f);
+        const auto t2 = t * t;
+
+        return t * (2.0f + t2 * (c1 + t2 * (c2 + t2 * c3))) + exponent * ln2;
+    }
+
+   #if TS_FAST_MATH_SSE2
+    // The same log over four floats
+    inline __m128 log (__m128 w) noexcept
+    {
+        constexpr float c1 = 2.0f / 3.0f;
+        constexpr float c2 = 2.0f / 5.0f;
+        constexpr float c3 = 2.0f / 7.0f;
+
+        const auto bits = _mm_add_epi32 (_mm_castps_si128 (w), _mm_set1_epi32 (0x3f800000 - (int) sqrtHalfBits));
+        const auto exponent = _mm_cvtepi32_ps (_mm_sub_epi32 (_mm_srli_epi32 (bits, 23), _mm_set1_epi32 (127)));
+        const auto m = _mm_castsi128_ps (_mm_add_epi32 (_mm_and_si128 (bits, _mm_set1_epi32 (0x007fffff)),
+                                                        _mm_set1_epi32 ((int) sqrtHalfBits)));
+
+        const auto one = _mm_set1_ps (1.0f);
+        const auto t = _mm_div_ps (_mm_sub_ps (m, one), _mm_add_ps (m, one));
+        const auto t2 = _mm_mul_ps (t, t);
+
+        auto series = _mm_add_ps (_mm_set1_ps (c2), _mm_mul_ps (t2, _mm_set1_ps (c3)));
+        series = _mm_add_ps (_mm_set1_ps (c1), _mm_mul_ps (t2, series));
+        series = _mm_add_ps (_mm_set1_ps (2.0f), _mm_mul_ps (t2, series));
+
+        return _mm_add_ps (_mm_mul_ps (t, series), _mm_mul_ps (exponent, _mm_set1_ps (ln2)));
+    }
+   #endif
+
+    // exp (x), with x clamped to [-87, 88] so the result stays a normal float. Reduced to
+    // 2^n * 2^f with n the nearest integer and |f| <= 1/2; 2^f from its Taylor
+    // series to f^6 (relative error below 2e-7).
+    inline float exp (float x) noexcept
+    {
+        constexpr float log2e = 1.44269504088896f;
+        constexpr float roundingBias = 12582912.0f; // 1.5 * 2^23, adding it rounds to an integer
+
+        x = x < -87.0f ? -87.0f : (x > 88.0f ? 88.0f : x);
+
+        const auto t = x * log2e;
+        const auto n = (t + roundingBias) - roundingBias;
+        const auto f = (t - n) * ln2;
+
+        const auto p = 1.0f + f * (1.0f + f * (1.0f / 2.0f + f * (1.0f / 6.0f + f * (1.0f / 24.0f
+                                 + f * (1.0f / 120.0f + f * (1.0f / 720.0f))))));
+
+        return bitsToFloat (floatToBits (p) + (uint32_t (int32_t (n)) << 23));
+    }
+}
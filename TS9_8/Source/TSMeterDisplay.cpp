@@ -0,0 +1,110 @@
+#include "TSMeterDisplay.h"
+
+//==============================================================================
+MeterDisplay::MeterDisplay (TSAudioProcessor& p)
+    : audioProcessor (p)
+{
+    setInterceptsMouseClicks (false, false);
+
+    audioProcessor.setMeteringEnabled (true);
+    startTimerHz (frameRate);
+}
+
+MeterDisplay::~MeterDisplay()
+{
+    stopTimer();
+    audioProcessor.setMeteringEnabled (false);
+}
+
+//==============================================================================
+void MeterDisplay::timerCallback()
+{
+    // Everything the audio thread pushed since the last frame, as one reading
+    TSMeterReading merged, reading;
+    bool received = false;
+
+    while (audioProcessor.popMeterReading (reading))
+    {
+        merged.merge (reading);
+        received = true;
+    }
+
+    const auto previousInput = input;
+    const auto previousOutput = output;
+    const auto previousHeavy = heavilyClippedFraction;
+    const auto previousLimited = limitedFraction;
+
+    // Merged over the channels, the RMS is of all of them together
+    update (input, merged.getInputRms(), merged.inputPeak);
+    update (output, merged.getOutputRms(), merged.outputPeak);
+
+    if (received)
+    {
+        limitedFraction = merged.getLimitedFraction();
+        heavilyClippedFraction = merged.getHeavilyClippedFraction();
+    }
+
+    const auto moved = [] (float a, float b, float tolerance) { return std::abs (a - b) > tolerance; };
+
+    if (moved (input.rmsDb, previousInput.rmsDb, 0.1f) || moved (input.peakDb, previousInput.peakDb, 0.1f)
+         || moved (output.rmsDb, previousOutput.rmsDb, 0.1f) || moved (output.peakDb, previousOutput.peakDb, 0.1f)
+         || moved (heavilyClippedFraction, previousHeavy, 0.005f) || moved (limitedFraction, previousLimited, 0.005f))
+        repaint();
+}
+
+void MeterDisplay::update (Level& level, float rms, float peak)
+{
+    const auto fall = peakFallDbPerSecond / (float) frameRate;
+
+    level.rmsDb = jmax (minDb, Decibels::gainToDecibels (rms, minDb), level.rmsDb - fall);
+    level.peakDb = jmax (minDb, Decibels::gainToDecibels (peak, minDb), level.peakDb - fall);
+}
+
+//==============================================================================
+void MeterDisplay::paint (Graphics& g)
+{
+    g.setFont (font);
+
+    auto bounds = getLocalBounds().toFloat();
+    auto clipArea = bounds.removeFromRight (110.0f).withTrimmedLeft (10.0f);
+    const auto rowHeight = bounds.getHeight() * 0.5f;
+
+    drawLevel (g, bounds.removeFromTop (rowHeight), "IN", input);
+    drawLevel (g, bounds, "OUT", output);
+
+    // The LED lights up with the share of samples driven hard into the diodes
+    auto led = clipArea.removeFromLeft (rowHeight).reduced (2.0f);
+    g.setColour (Colours::darkred.interpolatedWith (Colours::red, jlimit (0.0f, 1.0f, heavilyClippedFraction * 4.0f)));
+    g.fillEllipse (led);
+    g.setColour (Colours::black);
+    g.drawEllipse (led, 1.0f);
+
+    clipArea.removeFromLeft (4.0f);
+
+    const auto percent = [] (float fraction) { return String (roundToInt (fraction * 100.0f)) + "%"; };
+
+    g.drawText ("CLIP " + percent (heavilyClippedFraction), clipArea.removeFromTop (rowHeight), Justification::centredLeft);
+    g.drawText ("LINEAR " + percent (limitedFraction), clipArea, Justification::centredLeft);
+}
+
+void MeterDisplay::drawLevel (Graphics& g, Rectangle<float> area, const String& name, const Level& level) const
+{
+    g.setColour (Colours::black);
+    g.drawText (name, area.removeFromLeft (32.0f), Justification::centredLeft);
+
+    const auto bar = area.reduced (0.0f, 2.0f);
+    const auto toX = [&] (float db) { return bar.getX() + bar.getWidth() * jmap (jlimit (minDb, maxDb, db), minDb, maxDb, 0.0f, 1.0f); };
+
+    g.setColour (Colours::black.withAlpha (0.35f));
+    g.fillRoundedRectangle (bar, 2.0f);
+
+    g.setColour (Colours::white.withAlpha (0.85f));
+    g.fillRect (bar.withRight (toX (level.rmsDb)));
+
+    // The peak tick turns red past full scale
+    g.setColour (level.peakDb > 0.0f ? Colours::red : Colours::white);
+    g.fillRect (Rectangle<float> (toX (level.peakDb) - 1.0f, bar.getY(), 2.0f, bar.getHeight()));
+
+    g.setColour (Colours::black.withAlpha (0.6f));
+    g.drawVerticalLine (roundToInt (toX (0.0f)), bar.getY(), bar.getBottom());
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "TSProcessor.h"
+
+using namespace juce;
+
+// Input and output level bars and the clipper activity of a TSAudioProcessor.
+// Turns the processor's metering on for as long as it exists and drains its
+// meter FIFO at frameRate, on the message thread; it only repaints when what it
+// shows has moved.
+class MeterDisplay : public Component,
+                     private Timer
+{
+public:
+    explicit MeterDisplay (TSAudioProcessor&);
+    ~MeterDisplay() override;
+
+    void paint (Graphics&) override;
+
+    static constexpr int frameRate = 30;
+
+private:
+    static constexpr float minDb = -60.0f;
+    static constexpr float maxDb = 6.0f;
+    static constexpr float peakFallDbPerSecond = 24.0f;
+
+    struct Level
+    {
+        float rmsDb = minDb;
+        float peakDb = minDb;
+    };
+
+    void timerCallback() override;
+
+    // Peaks fall back at peakFallDbPerSecond, the RMS follows the readings
+    static void update (Level& level, float rms, float peak);
+
+    void drawLevel (Graphics& g, Rectangle<float> area, const String& name, const Level& level) const;
+
+    TSAudioProcessor& audioProcessor;
+
+    Level input, output;
+    float limitedFraction = 0.0f;
+    float heavilyClippedFraction = 0.0f;
+
+    Font font { "Segoe UI", 12.0f, Font::bold };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MeterDisplay)
+};
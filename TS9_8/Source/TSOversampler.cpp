@@ -0,0 +1,493 @@
+#include "TSOversampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    constexpr double pi = 3.14159265358979323846;
+
+    // Stopband attenuation and transition band width (a fraction of the stage's
+    // high rate, centred on a quarter of it). The first stage keeps the audio band
+    // up to 0.45 of the base rate; later stages only reject images of it.
+    struct StageSpec
+    {
+        double attenuationDb;
+        double transition;
+    };
+
+    StageSpec getStageSpec (int stageIndex) noexcept
+    {
+        return stageIndex == 0 ? StageSpec { 90.0, 0.05 } : StageSpec { 90.0, 0.25 };
+    }
+
+    // The allpass coefficients of a Valenzuela-Constantinides half-band filter,
+    // derived from the modulus of the elliptic prototype with the least order
+    // that reaches the attenuation
+    std::vector<double> designAllpassHalfBand (const StageSpec& spec)
+    {
+        auto k = std::tan ((1.0 - spec.transition * 2.0) * pi / 4.0);
+        k *= k;
+
+        const auto kRoot = std::pow (1.0 - k * k, 0.25);
+        const auto e = 0.5 * (1.0 - kRoot) / (1.0 + kRoot);
+        const auto e4 = e * e * e * e;
+        const auto q = e * (1.0 + e4 * (2.0 + e4 * (15.0 + 150.0 * e4)));
+
+        const auto attenuationPower = std::pow (10.0, -spec.attenuationDb / 10.0);
+        const auto a = attenuationPower / (1.0 - attenuationPower);
+
+        auto order = int (std::ceil (std::log (a * a / 16.0) / std::log (q)));
+        order = std::max (3, order | 1);
+
+        std::vector<double> coefficients (size_t ((order - 1) / 2));
+
+        for (size_t index = 0; index < coefficients.size(); ++index)
+        {
+            const auto c = double (index + 1);
+
+            double numerator = 0.0, sign = 1.0;
+
+            for (int i = 0;; ++i, sign = -sign)
+            {
+                const auto term = std::pow (q, double (i * (i + 1))) * std::sin ((i * 2 + 1) * c * pi / order) * sign;
+                numerator += term;
+
+                if (std::abs (term) <= 1.0e-100)
+                    break;
+            }
+
+            double denominator = 0.0;
+            sign = -1.0;
+
+            for (int i = 1;; ++i, sign = -sign)
+            {
+                const auto term = std::pow (q, double (i * i)) * std::cos (i * 2 * c * pi / order) * sign;
+                denominator += term;
+
+                if (std::abs (term) <= 1.0e-100)
+                    break;
+            }
+
+            const auto w = numerator * std::pow (q, 0.25) / (denominator + 0.5);
+            const auto w2 = w * w;
+            const auto x = std::sqrt ((1.0 - w2 * k) * (1.0 - w2 / k)) / (1.0 + w2);
+
+            coefficients[index] = (1.0 - x) / (1.0 + x);
+        }
+
+        return coefficients;
+    }
+
+    double besselI0 (double x) noexcept
+    {
+        double sum = 1.0, term = 1.0;
+
+        for (int k = 1; term > 1.0e-12 * sum; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+
+        return sum;
+    }
+
+    // The taps at odd offsets 1, 3, 5.. of a Kaiser windowed half-band sinc, the
+    // length from Kaiser's estimate. Scaled so the DC gain is exactly one. Kaiser's
+    // formulas undershoot the attenuation by a few dB, hence the margin.
+    std::vector<double> designKaiserHalfBand (const StageSpec& spec)
+    {
+        const auto attenuation = spec.attenuationDb + 5.0;
+        const auto length = (attenuation - 7.95) / (14.36 * spec.transition) + 1.0;
+        const auto numTaps = size_t (std::ceil ((length + 1.0) / 4.0));
+        const auto beta = 0.1102 * (attenuation - 8.7);
+
+        std::vector<double> taps (numTaps);
+        double sum = 0.0;
+
+        for (size_t k = 0; k < numTaps; ++k)
+        {
+            const auto offset = double (2 * k + 1);
+            const auto ratio = offset / double (2 * numTaps);
+            const auto sinc = std::sin (pi * offset / 2.0) / (pi * offset / 2.0);
+
+            taps[k] = 0.5 * sinc * besselI0 (beta * std::sqrt (1.0 - ratio * ratio)) / besselI0 (beta);
+            sum += taps[k];
+        }
+
+        for (auto& tap : taps)
+            tap *= 0.25 / sum;
+
+        return taps;
+    }
+
+    // Group delay at DC of one path, in samples at the stage's high rate: each
+    // section (a + z^-2) / (1 + a z^-2) contributes 2 (1 - a) / (1 + a)
+    double getPathDelay (const std::vector<double>& coefficients, size_t firstIndex) noexcept
+    {
+        double delay = 0.0;
+
+        for (auto i = firstIndex; i < coefficients.size(); i += 2)
+            delay += 2.0 * (1.0 - coefficients[i]) / (1.0 + coefficients[i]);
+
+        return delay;
+    }
+
+    // Samples at the stage's high rate for one path to decay by 120 dB: each
+    // section has its poles at radius sqrt (a), and a cascade adds them up
+    double getPathDecay (const std::vector<double>& coefficients, size_t firstIndex) noexcept
+    {
+        double decay = 0.0;
+
+        for (auto i = firstIndex; i < coefficients.size(); i += 2)
+            if (coefficients[i] > 0.0)
+                decay += 120.0 / (-10.0 * std::log10 (coefficients[i]));
+
+        return decay;
+    }
+}
+
+//==============================================================================
+template <typename SampleType>
+void Oversampler<SampleType>::prepare (size_t numLanes, int numStages, OversamplingFilter filter, size_t maxFrames)
+{
+    numStages = std::min (std::max (numStages, 0), maxStages);
+
+    lanes = numLanes;
+    filterType = filter;
+    stages.clear();
+    stages.resize (size_t (numStages));
+
+    // Round trip delay in samples at the highest rate, and the IIR decay on top of it
+    double totalDelay = 0.0;
+    double totalDecay = 0.0;
+
+    for (int i = 0; i < numStages; ++i)
+    {
+        auto& stage = stages[size_t (i)];
+        const auto spec = getStageSpec (i);
+        const auto framesIn = maxFrames << i;
+        const auto scaleToTop = double (1 << (numStages - i - 1));
+
+        if (filter == OversamplingFilter::polyphaseIIR)
+        {
+            const auto design = designAllpassHalfBand (spec);
+            stage.coefficients.assign (design.begin(), design.end());
+
+            // Two memories (input and output) per section and lane, each way
+            stage.upState.assign (2 * design.size() * lanes, SampleType (0));
+            stage.downState.assign (2 * design.size() * lanes, SampleType (0));
+            stage.scratch.assign (lanes, SampleType (0));
+
+            // Up: the half-band filter's own delay, (path 0 + 1 + path 1) / 2 at DC.
+            // Down takes its even path from the later sample of each pair, one less.
+            const auto filterDelay = (getPathDelay (design, 0) + 1.0 + getPathDelay (design, 1)) * 0.5;
+            totalDelay += (2.0 * filterDelay - 1.0) * scaleToTop;
+
+            // Up and down, each the slower of its two parallel paths
+            totalDecay += 2.0 * std::max (getPathDecay (design, 0), getPathDecay (design, 1)) * scaleToTop;
+        }
+        else
+        {
+            const auto design = designKaiserHalfBand (spec);
+            stage.coefficients.assign (design.begin(), design.end());
+
+            // History plus block: 2K - 1 input frames up, 4K - 2 high rate frames down
+            const auto numTaps = design.size();
+            stage.upState.assign ((2 * numTaps - 1 + framesIn) * lanes, SampleType (0));
+            stage.downState.assign ((4 * numTaps - 2 + 2 * framesIn) * lanes, SampleType (0));
+
+            // 2K samples up, 2K - 2 down, at the stage's high rate
+            totalDelay += double (4 * numTaps - 2) * scaleToTop;
+        }
+
+        stage.output.assign (2 * framesIn * lanes, SampleType (0));
+    }
+
+    // Pad to the next whole base rate sample
+    const auto factor = double (getFactor());
+    const auto paddedDelay = std::ceil (totalDelay / factor - 1.0e-9) * factor;
+
+    delayLength = size_t (std::lround (paddedDelay - totalDelay));
+    delayState.assign ((delayLength + (maxFrames << numStages)) * lanes, SampleType (0));
+    latency = int (std::lround (paddedDelay / factor));
+
+    // A linear phase response is symmetric about the latency
+    tail = filter == OversamplingFilter::linearPhaseFIR ? 2 * latency
+                                                        : latency + int (std::ceil (totalDecay / factor));
+}
+
+template <typename SampleType>
+void Oversampler<SampleType>::release()
+{
+    stages = {};
+    delayState = {};
+    delayLength = 0;
+    latency = 0;
+    tail = 0;
+}
+
+template <typename SampleType>
+void Oversampler<SampleType>::reset() noexcept
+{
+    for (auto& stage : stages)
+    {
+        std::fill (stage.upState.begin(), stage.upState.end(), SampleType (0));
+        std::fill (stage.downState.begin(), stage.downState.end(), SampleType (0));
+    }
+
+    std::fill (delayState.begin(), delayState.end(), SampleType (0));
+}
+
+//==============================================================================
+template <typename SampleType>
+SampleType* Oversampler<SampleType>::processUp (const SampleType* input, size_t numFrames) noexcept
+{
+    if (stages.empty())
+        return const_cast<SampleType*> (input);
+
+    auto* source = input;
+
+    for (auto& stage : stages)
+    {
+        if (filterType == OversamplingFilter::polyphaseIIR)
+            upIIR (stage, source, stage.output.data(), numFrames);
+        else
+            upFIR (stage, source, stage.output.data(), numFrames);
+
+        source = stage.output.data();
+        numFrames *= 2;
+    }
+
+    delay (stages.back().output.data(), numFrames);
+    return stages.back().output.data();
+}
+
+template <typename SampleType>
+void Oversampler<SampleType>::processDown (SampleType* output, size_t numFrames) noexcept
+{
+    if (stages.empty())
+        return;
+
+    for (auto i = stages.size(); i-- > 0;)
+    {
+        auto& stage = stages[i];
+        auto* destination = i > 0 ? stages[i - 1].output.data() : output;
+        const auto framesOut = numFrames << i;
+
+        if (filterType == OversamplingFilter::polyphaseIIR)
+            downIIR (stage, stage.output.data(), destination, framesOut);
+        else
+            downFIR (stage, stage.output.data(), destination, framesOut);
+    }
+}
+
+//==============================================================================
+// Every kernel below walks the lanes a register's worth (laneWidth) at a time,
+// with the chunk in local arrays of fixed size, so the compiler keeps them in
+// SIMD registers across the taps or sections instead of storing every partial
+// result back to memory it cannot prove is unaliased.
+
+// IIR: the paths alternate through the sections, path 0 taking the even
+// coefficients. Each section is y = a (x - y') + x', primes being its previous
+// input and output, at the low rate of the stage. Sections 2i and 2i + 1 sit on
+// different paths, so they are run side by side.
+template <typename SampleType>
+void Oversampler<SampleType>::runAllpassPaths (const std::vector<SampleType>& coefficients, SampleType* memory,
+                                               SampleType* path0, SampleType* path1) noexcept
+{
+    const auto numSections = coefficients.size();
+
+    for (size_t chunk = 0; chunk < lanes; chunk += laneWidth)
+    {
+        SampleType p0[laneWidth], p1[laneWidth];
+
+        for (size_t w = 0; w < laneWidth; ++w)
+        {
+            p0[w] = path0[chunk + w];
+            p1[w] = path1[chunk + w];
+        }
+
+        for (size_t section = 0; section < numSections; section += 2)
+        {
+            auto* previousInput0 = memory + 2 * section * lanes + chunk;
+            auto* previousOutput0 = previousInput0 + lanes;
+            const auto a0 = coefficients[section];
+
+            for (size_t w = 0; w < laneWidth; ++w)
+            {
+                const auto out = a0 * (p0[w] - previousOutput0[w]) + previousInput0[w];
+                previousInput0[w] = p0[w];
+                previousOutput0[w] = out;
+                p0[w] = out;
+            }
+
+            if (section + 1 == numSections)
+                break;
+
+            auto* previousInput1 = previousInput0 + 2 * lanes;
+            auto* previousOutput1 = previousInput1 + lanes;
+            const auto a1 = coefficients[section + 1];
+
+            for (size_t w = 0; w < laneWidth; ++w)
+            {
+                const auto out = a1 * (p1[w] - previousOutput1[w]) + previousInput1[w];
+                previousInput1[w] = p1[w];
+                previousOutput1[w] = out;
+                p1[w] = out;
+            }
+        }
+
+        for (size_t w = 0; w < laneWidth; ++w)
+        {
+            path0[chunk + w] = p0[w];
+            path1[chunk + w] = p1[w];
+        }
+    }
+}
+
+template <typename SampleType>
+void Oversampler<SampleType>::upIIR (Stage& stage, const SampleType* input, SampleType* output, size_t numFrames) noexcept
+{
+    for (size_t n = 0; n < numFrames; ++n)
+    {
+        const auto* x = input + n * lanes;
+        auto* even = output + 2 * n * lanes;
+        auto* odd = even + lanes;
+
+        std::copy (x, x + lanes, even);
+        std::copy (x, x + lanes, odd);
+
+        runAllpassPaths (stage.coefficients, stage.upState.data(), even, odd);
+    }
+}
+
+template <typename SampleType>
+void Oversampler<SampleType>::downIIR (Stage& stage, const SampleType* input, SampleType* output, size_t numFrames) noexcept
+{
+    auto* path1 = stage.scratch.data();
+
+    for (size_t n = 0; n < numFrames; ++n)
+    {
+        // The later sample of the pair goes through path 0, the earlier through path 1
+        const auto* earlier = input + 2 * n * lanes;
+        const auto* later = earlier + lanes;
+        auto* path0 = output + n * lanes;
+
+        std::copy (later, later + lanes, path0);
+        std::copy (earlier, earlier + lanes, path1);
+
+        runAllpassPaths (stage.coefficients, stage.downState.data(), path0, path1);
+
+        for (size_t lane = 0; lane < lanes; ++lane)
+            path0[lane] = SampleType (0.5) * (path0[lane] + path1[lane]);
+    }
+}
+
+//==============================================================================
+// FIR: with taps g_k at offsets +-(2k - 1) and 1/2 in the centre, the up path
+// turns input n into a delayed copy of x[n - K] followed by the point halfway
+// to x[n - K + 1]; the down path filters at the pair's later sample.
+template <typename SampleType>
+void Oversampler<SampleType>::upFIR (Stage& stage, const SampleType* input, SampleType* output, size_t numFrames) noexcept
+{
+    const auto numTaps = stage.coefficients.size();
+    const auto historyFrames = 2 * numTaps - 1;
+    const auto* g = stage.coefficients.data();
+    auto* buffer = stage.upState.data();
+
+    std::copy (input, input + numFrames * lanes, buffer + historyFrames * lanes);
+
+    for (size_t n = 0; n < numFrames; ++n)
+    {
+        // Frame n of the block sits at historyFrames + n; x[n - K] is numTaps back
+        const auto* centre = buffer + (historyFrames + n - numTaps) * lanes;
+        auto* direct = output + 2 * n * lanes;
+        auto* halfway = direct + lanes;
+
+        for (size_t chunk = 0; chunk < lanes; chunk += laneWidth)
+        {
+            // halfway = 2 sum g_k (x[n - K - k + 1] + x[n - K + k])
+            SampleType sum[laneWidth] = {};
+
+            for (size_t k = 1; k <= numTaps; ++k)
+            {
+                const auto* before = centre - (k - 1) * lanes + chunk;
+                const auto* after = centre + k * lanes + chunk;
+                const auto tap = g[k - 1];
+
+                for (size_t w = 0; w < laneWidth; ++w)
+                    sum[w] += tap * (before[w] + after[w]);
+            }
+
+            for (size_t w = 0; w < laneWidth; ++w)
+            {
+                direct[chunk + w] = centre[chunk + w];
+                halfway[chunk + w] = SampleType (2) * sum[w];
+            }
+        }
+    }
+
+    std::copy (buffer + numFrames * lanes, buffer + (numFrames + historyFrames) * lanes, buffer);
+}
+
+template <typename SampleType>
+void Oversampler<SampleType>::downFIR (Stage& stage, const SampleType* input, SampleType* output, size_t numFrames) noexcept
+{
+    const auto numTaps = stage.coefficients.size();
+    const auto historyFrames = 4 * numTaps - 2;
+    const auto* g = stage.coefficients.data();
+    auto* buffer = stage.downState.data();
+
+    std::copy (input, input + 2 * numFrames * lanes, buffer + historyFrames * lanes);
+
+    for (size_t n = 0; n < numFrames; ++n)
+    {
+        // The newest tap is the pair's later sample, 2n + 1; the centre is 2K - 1 before it
+        const auto* centre = buffer + (historyFrames + 2 * n + 2 - 2 * numTaps) * lanes;
+        auto* y = output + n * lanes;
+
+        for (size_t chunk = 0; chunk < lanes; chunk += laneWidth)
+        {
+            SampleType sum[laneWidth];
+
+            for (size_t w = 0; w < laneWidth; ++w)
+                sum[w] = SampleType (0.5) * centre[chunk + w];
+
+            for (size_t k = 1; k <= numTaps; ++k)
+            {
+                const auto* before = centre - (2 * k - 1) * lanes + chunk;
+                const auto* after = centre + (2 * k - 1) * lanes + chunk;
+                const auto tap = g[k - 1];
+
+                for (size_t w = 0; w < laneWidth; ++w)
+                    sum[w] += tap * (before[w] + after[w]);
+            }
+
+            for (size_t w = 0; w < laneWidth; ++w)
+                y[chunk + w] = sum[w];
+        }
+    }
+
+    std::copy (buffer + 2 * numFrames * lanes, buffer + (2 * numFrames + historyFrames) * lanes, buffer);
+}
+
+//==============================================================================
+template <typename SampleType>
+void Oversampler<SampleType>::delay (SampleType* frames, size_t numFrames) noexcept
+{
+    if (delayLength == 0)
+        return;
+
+    // delayState holds the last delayLength frames, followed by room for the block
+    auto* buffer = delayState.data();
+    const auto delaySamples = delayLength * lanes;
+    const auto blockSamples = numFrames * lanes;
+
+    std::copy (frames, frames + blockSamples, buffer + delaySamples);
+    std::copy (buffer, buffer + blockSamples, frames);
+    std::copy (buffer + blockSamples, buffer + blockSamples + delaySamples, buffer);
+}
+
+template class Oversampler<float>;
+template class Oversampler<double>;
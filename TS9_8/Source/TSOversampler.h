@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Half-band filter designs for the oversampler, the two choices the plugin offers
+enum class OversamplingFilter
+{
+    polyphaseIIR,   // allpass pairs: cheap, minimum latency, slight phase shift near the band edge
+    linearPhaseFIR  // Kaiser windowed: linear phase, more latency and cost
+};
+
+// Cascaded 2x up and down sampling for many independent streams at once.
+//
+// Samples are interleaved in frames: frame n holds sample n of every lane, so
+// every inner loop runs across lanes and vectorises whatever the lane count.
+// Each stage doubles the rate with a half-band lowpass, either
+//
+//  - polyphase IIR: two chains of first order allpass sections in z^-2, the
+//    design of Valenzuela and Constantinides (as used by de Soras' HIIR), sized
+//    for the attenuation and transition band of the stage, or
+//  - linear phase FIR: a Kaiser windowed sinc with every other tap zero, the
+//    centre tap at 1/2, run in polyphase form.
+//
+// The first stage carries the steepest filters; later stages only have to
+// reject images far from the audio band and get away with far fewer taps.
+//
+// The round trip latency is padded to a whole number of base rate samples by a
+// short delay at the highest rate, so a host can compensate it exactly. The IIR
+// stages have no constant delay; there it is their group delay at DC, matched to
+// within half a sample at the highest rate.
+template <typename SampleType>
+class Oversampler
+{
+public:
+    static constexpr int maxStages = 4;
+
+    // Lanes are processed a 16 byte register at a time
+    static constexpr size_t laneWidth = 16 / sizeof (SampleType);
+
+    // Allocates. Zero stages passes the signal through untouched. numLanes must
+    // be a multiple of laneWidth.
+    void prepare (size_t numLanes, int numStages, OversamplingFilter filter, size_t maxFrames);
+
+    // Frees everything prepare() allocated
+    void release();
+
+    // Clears the filter histories
+    void reset() noexcept;
+
+    size_t getFactor() const noexcept          { return size_t (1) << stages.size(); }
+    int getLatencyInSamples() const noexcept   { return latency; }
+
+    // Base rate samples until an impulse through the round trip has died away by
+    // 120 dB: the whole response for FIR, the latency plus the decay of the
+    // slowest allpass poles for IIR
+    int getTailInSamples() const noexcept      { return tail; }
+
+    // Upsamples numFrames frames (at most the maxFrames passed to prepare). Returns
+    // numFrames * getFactor() frames held by the oversampler, which the caller may
+    // process in place before handing them back to processDown().
+    SampleType* processUp (const SampleType* input, size_t numFrames) noexcept;
+
+    // Downsamples the frames last returned by processUp() into output
+    void processDown (SampleType* output, size_t numFrames) noexcept;
+
+private:
+    struct Stage
+    {
+        // IIR: allpass coefficients, even indices on one path, odd on the other.
+        // FIR: the nonzero taps either side of the centre, innermost first.
+        std::vector<SampleType> coefficients;
+
+        // IIR: per section input and output memory. FIR: input history followed
+        // by the block being processed.
+        std::vector<SampleType> upState, downState;
+
+        // Frames at this stage's high rate, written by the up path
+        std::vector<SampleType> output;
+
+        // IIR: one frame of the second path on the way down
+        std::vector<SampleType> scratch;
+    };
+
+    void runAllpassPaths (const std::vector<SampleType>& coefficients, SampleType* memory,
+                          SampleType* path0, SampleType* path1) noexcept;
+
+    void upIIR (Stage&, const SampleType* input, SampleType* output, size_t numFrames) noexcept;
+    void downIIR (Stage&, const SampleType* input, SampleType* output, size_t numFrames) noexcept;
+    void upFIR (Stage&, const SampleType* input, SampleType* output, size_t numFrames) noexcept;
+    void downFIR (Stage&, const SampleType* input, SampleType* output, size_t numFrames) noexcept;
+    void delay (SampleType* frames, size_t numFrames) noexcept;
+
+    std::vector<Stage> stages;
+    OversamplingFilter filterType = OversamplingFilter::polyphaseIIR;
+    size_t lanes = 0;
+
+    // Pads the round trip to whole base rate samples, at the highest rate
+    size_t delayLength = 0;
+    std::vector<SampleType> delayState;
+
+    int latency = 0;
+    int tail = 0;
+};
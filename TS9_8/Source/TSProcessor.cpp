@@ -1,5 +1,27 @@
 #include "TSProcessor.h"
-#include "TSEditor.h"
+#include "TSAllocationTrap.h"
+
+#if ! TS_HEADLESS
+ #include "TSEditor.h"
+#endif
+
+#ifndef JucePlugin_Name
+ #define JucePlugin_Name "TubeSchemer"
+#endif
+
+namespace
+{
+    // The parameter each MidiTarget moves
+    const char* const midiTargetIDs[] = { "drive", "tone", "level", "bypass" };
+
+    Identifier getMidiStateProperty (int target)
+    {
+        return "midiCC_" + String (midiTargetIDs[target]);
+    }
+
+    // Opens the binary state (see getStateInformation)
+    const int binaryStateMagic = (int) ByteOrder::littleEndianInt ("TSst");
+}
 
 //==============================================================================
 TSAudioProcessor::TSAudioProcessor()
@@ -7,17 +29,43 @@ TSAudioProcessor::TSAudioProcessor()
                       {
                           std::make_unique<AudioParameterFloat> ("drive",            // parameterID
                                                                  "Drive",            // parameter name
-                                                                  NormalisableRange<float>(driveRangeMin, driveRangeMax, 0.001f, driveSkewFactor), // range and skew
+                                                                  NormalisableRange<float>(driveRangeMin, driveRangeMax, parameterInterval, driveSkewFactor), // range and skew
                                                                   driveSkewMidPoint),     // default value
                           std::make_unique<AudioParameterFloat> ("tone",             // parameterID
                                                                  "Tone",             // parameter name
-                                                                  NormalisableRange<float>(toneRangeMin, toneRangeMax, 0.001f, toneSkewFactor), // range and skew
+                                                                  NormalisableRange<float>(toneRangeMin, toneRangeMax, parameterInterval, toneSkewFactor), // range and skew
                                                                   toneSkewMidPoint),     // default value
                           std::make_unique<AudioParameterFloat> ("level",            // parameterID
                                                                  "Level",            // parameter name
                                                                   0.0f,              // minimum value
                                                                   1.0f,              // maximum value
                                                                   0.5f),             // default value
+                          std::make_unique<AudioParameterChoice> ("oversampling",     // parameterID
+                                                                  "Oversampling",     // parameter name
+                                                                  StringArray { "1x", "2x", "4x", "8x", "16x" },
+                                                                  1),                 // default index
+                          std::make_unique<AudioParameterChoice> ("oversamplingFilter", // parameterID
+                                                                  "Oversampling Filter",// parameter name
+                                                                  StringArray { "Polyphase IIR", "Linear Phase FIR" },
+                                                                  1),                 // default index
+                          std::make_unique<AudioParameterBool> ("offlineQuality",     // parameterID
+                                                                "Offline Max Quality",// parameter name
+                                                                true),                // default value
+                          std::make_unique<AudioParameterChoice> ("driveModel",       // parameterID
+                                                                  "Drive Model",      // parameter name
+                                                                  StringArray { "Filter + Clipper", "Wave Digital (Offline)" },
+                                                                  0),                 // default index
+                          std::make_unique<AudioParameterChoice> ("circuitModel",     // parameterID
+                                                                  "Circuit",          // parameter name
+                                                                  StringArray { TS808Circuit::name, TS9Circuit::name, CustomCircuit::name },
+                                                                  2),                 // default index
+                          std::make_unique<AudioParameterBool> ("bypass",             // parameterID
+                                                                "Bypass",             // parameter name
+                                                                false),               // default value
+                          std::make_unique<AudioParameterChoice> ("clipperAntiAliasing", // parameterID
+                                                                  "Clipper Anti-Aliasing",// parameter name
+                                                                  StringArray { "No ADAA", "ADAA 1st Order", "ADAA 2nd Order" },
+                                                                  0),                 // default index
                       }),
 #ifndef JucePlugin_PreferredChannelConfigurations
       AudioProcessor (BusesProperties()
@@ -33,10 +81,35 @@ TSAudioProcessor::TSAudioProcessor()
 	driveParameter = parameters.getRawParameterValue ("drive");
 	toneParameter  = parameters.getRawParameterValue ("tone");
 	levelParameter  = parameters.getRawParameterValue ("level"); 
+    overSamplingParameter = parameters.getRawParameterValue ("oversampling");
+    overSamplingFilterParameter = parameters.getRawParameterValue ("oversamplingFilter");
+    offlineQualityParameter = parameters.getRawParameterValue ("offlineQuality");
+    driveModelParameter = parameters.getRawParameterValue ("driveModel");
+    circuitModelParameter = parameters.getRawParameterValue ("circuitModel");
+    bypassParameter = parameters.getRawParameterValue ("bypass");
+    clipperAntiAliasingParameter = parameters.getRawParameterValue ("clipperAntiAliasing");
+
+    for (auto* id : { "oversampling", "oversamplingFilter", "offlineQuality", "clipperAntiAliasing" })
+        parameters.addParameterListener (id, this);
+
+    for (auto* parameter : getParameters())
+        if (auto* ranged = dynamic_cast<RangedAudioParameter*> (parameter))
+            stateParameters.push_back (ranged);
+
+    for (int target = 0; target < numMidiTargets; ++target)
+    {
+        midiParameters[size_t (target)] = parameters.getParameter (midiTargetIDs[target]);
+        midiControllers[size_t (target)] = -1;
+    }
 }
 
 TSAudioProcessor::~TSAudioProcessor()
 {
+    for (auto* id : { "oversampling", "oversamplingFilter", "offlineQuality", "clipperAntiAliasing" })
+        parameters.removeParameterListener (id, this);
+
+    // A rebuild may still be pending, e.g. from a worker that was rendering with this instance
+    cancelPendingUpdate();
 }
 
 //==============================================================================
@@ -74,7 +147,9 @@ bool TSAudioProcessor::isMidiEffect() const
 
 double TSAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    // The engine works out its tail from the filter poles when it is prepared
+    const auto tailSamples = isUsingDoublePrecision() ? doubleEngine.getTailSamples() : floatEngine.getTailSamples();
+    return double (tailSamples) / currentSampleRate;
 }
 
 int TSAudioProcessor::getNumPrograms()
@@ -103,21 +178,87 @@ void TSAudioProcessor::changeProgramName (int index, const juce::String& newName
 //==============================================================================
 void TSAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    currentSampleRate = static_cast<float>(sampleRate);
+    currentSampleRate = sampleRate;
+    maxBlockSize = samplesPerBlock;
+
+    prepareOverSampling();
+}
+
+void TSAudioProcessor::prepareOverSampling()
+{
+    // Offline bounces get the most expensive settings, live use what was chosen
+    const bool useOfflineQuality = isNonRealtime() && offlineQualityParameter->load() > 0.5f;
+
+    TSEngineSettings settings;
+    settings.sampleRate = currentSampleRate;
+    settings.tileSize = size_t(tileSize.load());
+    settings.numStreams = size_t(jmax(1, getTotalNumInputChannels(), getTotalNumOutputChannels()));
+    settings.overSamplingStages = useOfflineQuality ? maxOverSamplingStages
+                                                    : jlimit(0, maxOverSamplingStages, roundToInt(overSamplingParameter->load()));
+    settings.overSamplingFilter = useOfflineQuality || overSamplingFilterParameter->load() > 0.5f ? OversamplingFilter::linearPhaseFIR
+                                                                                                : OversamplingFilter::polyphaseIIR;
+    settings.clipperAntiAliasing = DiodeClipper::AntiAliasing(jlimit(0, 2, roundToInt(clipperAntiAliasingParameter->load())));
+    settings.smoothingSeconds = parameterSmoothingSeconds;
+
+   #if TS_PROFILE_STAGES
+    // Allocated once: a report may be read from another thread
+    if (! stageProfiler.isPrepared())
+        stageProfiler.prepare();
+
+    stageProfiler.setSampleRate(currentSampleRate);
+
+    floatEngine.setProfiler(&stageProfiler);
+    doubleEngine.setProfiler(&stageProfiler);
+   #endif
+
+    if (isUsingDoublePrecision())
+    {
+        floatEngine.release();
+        prepareEngine(doubleEngine, settings);
+    }
+    else
+    {
+        doubleEngine.release();
+        prepareEngine(floatEngine, settings);
+    }
+}
+
+template <typename SampleType>
+void TSAudioProcessor::prepareEngine (TSEngine<SampleType>& engine, const TSEngineSettings& settings)
+{
+    engine.prepare(settings);
+
+    // Start at the current values rather than ramping from the defaults
+    engine.setAllStreamParameters({ driveParameter->load(), toneParameter->load(), levelParameter->load() });
+    engine.reset();
+
+    setLatencySamples(engine.getLatencySamples());
+}
+
+bool TSAudioProcessor::isEnginePrepared() const noexcept
+{
+    return floatEngine.isPrepared() || doubleEngine.isPrepared();
+}
 
-    dsp::ProcessSpec spec{ sampleRate, uint32(samplesPerBlock), uint32(getTotalNumOutputChannels()) };
-    driveFilter.reset();
-    driveFilter.prepare(spec);
-    toneFilter.reset();
-    toneFilter.prepare(spec);
-    
-    updateFilterState();
+void TSAudioProcessor::setNonRealtime (bool isNonRealtime) noexcept
+{
+    AudioProcessor::setNonRealtime(isNonRealtime);
 
-    overSampler.reset();
-    overSampler.initProcessing(samplesPerBlock);
+    // Most hosts prepare again after switching, this covers the ones that don't
+    if (isEnginePrepared())
+        triggerAsyncUpdate();
+}
 
-    //smoothedValue.reset(currentSampleRate, 0.001);
-    //smoothedValue.setTargetValue(toneSkewMidPoint);
+void TSAudioProcessor::handleAsyncUpdate()
+{
+    // Not prepared yet, prepareToPlay will pick the settings up
+    if (! isEnginePrepared())
+        return;
+
+    // Reallocates, so the audio callback is held off while the engine is rebuilt
+    suspendProcessing(true);
+    prepareOverSampling();
+    suspendProcessing(false);
 }
 
 void TSAudioProcessor::releaseResources()
@@ -126,6 +267,14 @@ void TSAudioProcessor::releaseResources()
     // spare memory, etc.
 }
 
+void TSAudioProcessor::reset()
+{
+    if (isUsingDoublePrecision())
+        doubleEngine.reset();
+    else
+        floatEngine.reset();
+}
+
 #ifndef JucePlugin_PreferredChannelConfigurations
 bool TSAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 {
@@ -133,10 +282,9 @@ bool TSAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Every channel is a stream of its own in the engine, so any non-empty layout
+    // works as long as input and output match
+    if (layouts.getMainOutputChannelSet().isDisabled())
         return false;
 
     // This checks if the input layout matches the output layout
@@ -150,8 +298,29 @@ bool TSAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 }
 #endif
 
+bool TSAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+
 void TSAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
+    jassert(! isUsingDoublePrecision());
+    processWithEngine(buffer, midiMessages, floatEngine);
+    publishMidiValues();
+}
+
+void TSAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    jassert(isUsingDoublePrecision());
+    processWithEngine(buffer, midiMessages, doubleEngine);
+    publishMidiValues();
+}
+
+template <typename SampleType>
+void TSAudioProcessor::processWithEngine (AudioBuffer<SampleType>& buffer, MidiBuffer& midiMessages, TSEngine<SampleType>& engine)
+{
+    TS_SCOPED_ALLOCATION_TRAP
     juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
@@ -159,69 +328,442 @@ void TSAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::Mid
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    dsp::AudioBlock<float> bufferBlock(buffer);
-    auto overSampledBlock = overSampler.processSamplesUp(bufferBlock);
-    AudioBuffer<float> upsampleCopy(2, buffer.getNumSamples() * overSampler.getOversamplingFactor());
-    dsp::AudioBlock<float> upsampleModBlock(upsampleCopy);
-
-    size_t channelToUse = size_t(0);
-    auto overSampledBlockChannel = overSampledBlock.getSingleChannelBlock(channelToUse);
-    auto upsampledModBlockChannel = upsampleModBlock.getSingleChannelBlock(channelToUse);
-    dsp::ProcessContextNonReplacing<float> driveContext(overSampledBlockChannel, upsampledModBlockChannel);
-    
-    auto bufferBlockChannel = bufferBlock.getSingleChannelBlock(channelToUse);
-    dsp::ProcessContextReplacing<float> toneContext(bufferBlockChannel);
-    
-    driveFilter.process(driveContext);
-    
-    float R2 = Rf_drive + (*driveParameter) * Rpot_drive;
-    float Is = 1E-14f;
-    float nvt = 26.E-3f;
-          
-    auto upsample_mod_block_ptr = upsampleModBlock.getChannelPointer(0);
-    auto upsample_block_ptr = overSampledBlock.getChannelPointer(0);
-    for (int i = 0; i < upsampleModBlock.getNumSamples(); ++i) {
-		auto U = nvt * asinh(upsample_mod_block_ptr[i] / (2.0f * Is * R2));
-		if (std::fabs(U) > std::fabs(upsample_mod_block_ptr[i])) {
-		   U = upsample_mod_block_ptr[i];
-		}
-	    upsample_block_ptr[i] += U;
+    // The engine ramps to new targets itself and ignores ones it already has
+    typename TSEngine<SampleType>::StreamParameters streamParameters { driveParameter->load(), toneParameter->load(), levelParameter->load() };
+    engine.setAllStreamParameters(streamParameters);
+    // The wave digital model costs several times the filter and clipper (see
+    // TSBench drive), so like the offline quality it only runs for offline renders
+    const bool useWaveDigital = isNonRealtime() && driveModelParameter->load() > 0.5f;
+    engine.setDriveModel(useWaveDigital ? TSEngine<SampleType>::DriveModel::waveDigital
+                                        : TSEngine<SampleType>::DriveModel::filterAndClipper);
+    engine.setCircuitModel(CircuitModel(jlimit(0, numCircuitModels - 1, roundToInt(circuitModelParameter->load()))));
+    engine.setClipper(useClipperTable.load(std::memory_order_relaxed) ? DiodeClipper::getBestTableImplementation()
+                                                                      : DiodeClipper::getBestImplementation());
+    engine.setCoefficientUpdateInterval(coefficientUpdateInterval.load(std::memory_order_relaxed));
+    engine.setFusedProcessing(fusedProcessing.load(std::memory_order_relaxed));
+    engine.setBypassed(bypassParameter->load() > 0.5f);
+
+    // Readings left over from the last time the meters ran are stale
+    const bool metering = meteringEnabled.load(std::memory_order_relaxed);
+
+    if (metering && ! engine.isMeteringEnabled())
+        engine.resetMeters();
+
+    engine.setMeteringEnabled(metering);
+
+    // The engine reads a stream per channel of the layout it was prepared for
+    if (size_t(buffer.getNumChannels()) < engine.getSettings().numStreams)
+    {
+        jassertfalse;
+        return;
     }
 
-    overSampler.processSamplesDown(bufferBlock);
+    const auto* const* inputs = buffer.getArrayOfReadPointers();
+    auto* const* outputs = buffer.getArrayOfWritePointers();
+    const auto numSamples = size_t(buffer.getNumSamples());
+    size_t position = 0;
+
+    // One record for the whole callback, however many pieces the events split it into
+    TS_PROFILE_CALLBACK(&stageProfiler, numSamples)
+
+    // The engine runs up to each controller event and takes the new target there,
+    // so its ramps start on the event's sample. A dense controller stream only
+    // costs the extra calls: the filters are still redesigned at the engine's interval.
+    for (const auto metadata : midiMessages)
+    {
+        const auto message = metadata.getMessage();
 
-    toneFilter.process(toneContext); 
+        if (! message.isController())
+            continue;
 
-    buffer.applyGain(*levelParameter); 
-    buffer.copyFrom(1, 0, buffer.getReadPointer(0), buffer.getNumSamples());
+        const auto target = takeMidiController(message.getControllerNumber());
+
+        if (target < 0)
+            continue;
+
+        const auto eventPosition = size_t(jlimit(0, int(numSamples), metadata.samplePosition));
+
+        if (eventPosition > position)
+        {
+            engine.process(inputs, outputs, position, eventPosition - position);
+            position = eventPosition;
+        }
+
+        const auto normalisedValue = float(message.getControllerValue()) / 127.0f;
+        const auto value = midiParameters[size_t(target)]->convertFrom0to1(normalisedValue);
+
+        switch (MidiTarget(target))
+        {
+            case MidiTarget::drive:     streamParameters.drive = value; break;
+            case MidiTarget::tone:      streamParameters.tone = value; break;
+            case MidiTarget::level:     streamParameters.level = value; break;
+            case MidiTarget::bypass:    engine.setBypassed(value > 0.5f); break;
+        }
+
+        engine.setAllStreamParameters(streamParameters);
+
+        midiValues[size_t(target)] = normalisedValue;
+        midiMovedTargets |= 1u << target;
+    }
+
+    if (position < numSamples)
+        engine.process(inputs, outputs, position, numSamples - position);
+
+    if (metering)
+        publishMeters(engine);
+}
+
+template <typename SampleType>
+void TSAudioProcessor::publishMeters (TSEngine<SampleType>& engine) noexcept
+{
+    const auto numStreams = engine.getSettings().numStreams;
+
+    if (double(engine.getMeter(0).numSamples) < meterIntervalSeconds * currentSampleRate)
+        return;
+
+    int start1, size1, start2, size2;
+    meterFifo.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 + size2 == 0)
+        return;
+
+    TSMeterReading reading;
+
+    for (size_t stream = 0; stream < numStreams; ++stream)
+        reading.merge(engine.getMeter(stream));
+
+    meterReadings[size_t(size1 > 0 ? start1 : start2)] = reading;
+    meterFifo.finishedWrite(1);
+
+    engine.resetMeters();
+}
+
+int TSAudioProcessor::takeMidiController (int controller) noexcept
+{
+    auto learning = midiLearnTarget.load(std::memory_order_relaxed);
+
+    if (learning >= 0 && midiLearnTarget.compare_exchange_strong(learning, -1))
+        setMidiController(MidiTarget(learning), controller);
+
+    for (int target = 0; target < numMidiTargets; ++target)
+        if (midiControllers[size_t(target)].load(std::memory_order_relaxed) == controller)
+            return target;
+
+    return -1;
+}
+
+void TSAudioProcessor::publishMidiValues()
+{
+    // After the block, outside the allocation trap: hosts may do anything in their callbacks
+    for (int target = 0; target < numMidiTargets; ++target)
+        if ((midiMovedTargets & (1u << target)) != 0)
+            midiParameters[size_t(target)]->setValueNotifyingHost(midiValues[size_t(target)]);
+
+    midiMovedTargets = 0;
+}
+
+void TSAudioProcessor::learnMidiController (MidiTarget target) noexcept
+{
+    midiLearnTarget = int(target);
+}
+
+void TSAudioProcessor::cancelMidiLearn() noexcept
+{
+    midiLearnTarget = -1;
+}
+
+bool TSAudioProcessor::isLearningMidi (MidiTarget target) const noexcept
+{
+    return midiLearnTarget.load() == int(target);
+}
+
+void TSAudioProcessor::setMidiController (MidiTarget target, int controller) noexcept
+{
+    controller = controller >= 0 && controller < 128 ? controller : -1;
+
+    // One controller moves one target
+    if (controller >= 0)
+        for (auto& other : midiControllers)
+            if (other.load() == controller)
+                other = -1;
+
+    midiControllers[size_t(target)] = controller;
+}
+
+int TSAudioProcessor::getMidiController (MidiTarget target) const noexcept
+{
+    return midiControllers[size_t(target)].load();
+}
+
+juce::AudioProcessorParameter* TSAudioProcessor::getBypassParameter() const
+{
+    return parameters.getParameter("bypass");
+}
+
+//==============================================================================
+void TSAudioProcessor::parameterChanged (const juce::String& /*parameterID*/, float /*newValue*/)
+{
+    // Only the oversampling and anti-aliasing settings are listened to; they rebuild the engine, off the audio thread.
+    // May be called on the audio thread during automation, so only flag the change.
+    triggerAsyncUpdate();
+}
+
+void TSAudioProcessor::setTileSize (int numSamples)
+{
+    numSamples = jlimit(minTileSize, maxTileSize, numSamples);
+
+    if (tileSize.exchange(numSamples) != numSamples && isEnginePrepared())
+        triggerAsyncUpdate();
+}
+
+void TSAudioProcessor::setCoefficientUpdateInterval (int numSamples) noexcept
+{
+    coefficientUpdateInterval = jmax(1, numSamples);
+}
+
+void TSAudioProcessor::setFusedProcessing (bool shouldFuse) noexcept
+{
+    fusedProcessing = shouldFuse;
+}
+
+void TSAudioProcessor::setUseClipperTable (bool shouldUseTable) noexcept
+{
+    useClipperTable = shouldUseTable;
+}
+
+bool TSAudioProcessor::isUsingClipperTable() const noexcept
+{
+    return useClipperTable.load();
+}
+
+void TSAudioProcessor::setMeteringEnabled (bool shouldMeter) noexcept
+{
+    meteringEnabled = shouldMeter;
+}
+
+bool TSAudioProcessor::popMeterReading (TSMeterReading& reading) noexcept
+{
+    int start1, size1, start2, size2;
+    meterFifo.prepareToRead(1, start1, size1, start2, size2);
+
+    if (size1 + size2 == 0)
+        return false;
+
+    reading = meterReadings[size_t(size1 > 0 ? start1 : start2)];
+    meterFifo.finishedRead(1);
+    return true;
+}
+
+juce::var TSAudioProcessor::takeStageProfileReport()
+{
+    std::vector<StageProfiler::Record> records;
+    const size_t chunkSize = 1024;
+
+    for (;;)
+    {
+        const auto numRead = records.size();
+        records.resize(numRead + chunkSize);
+        records.resize(numRead + stageProfiler.read(records.data() + numRead, chunkSize));
+
+        if (records.size() < numRead + chunkSize)
+            break;
+    }
+
+    const auto report = stageProfiler.summarise(records);
+
+    auto toVar = [] (const StageProfiler::Statistics& statistics)
+    {
+        auto* object = new DynamicObject();
+        object->setProperty("mean", statistics.mean);
+        object->setProperty("p50", statistics.p50);
+        object->setProperty("p90", statistics.p90);
+        object->setProperty("p99", statistics.p99);
+        object->setProperty("p999", statistics.p999);
+        object->setProperty("max", statistics.max);
+        return var(object);
+    };
+
+    auto* stages = new DynamicObject();
+
+    for (int stage = 0; stage < StageProfiler::numStages; ++stage)
+        stages->setProperty(StageProfiler::getStageName(stage), toVar(report.stages[stage]));
+
+    auto* result = new DynamicObject();
+    result->setProperty("enabled", TS_PROFILE_STAGES != 0);
+    result->setProperty("sampleRate", currentSampleRate);
+    result->setProperty("blockSize", maxBlockSize);
+    result->setProperty("tileSize", tileSize.load());
+    result->setProperty("fused", fusedProcessing.load());
+    result->setProperty("oversampling", 1 << (isUsingDoublePrecision() ? doubleEngine.getSettings().overSamplingStages
+                                                                        : floatEngine.getSettings().overSamplingStages));
+    result->setProperty("callbacks", (int) report.numCallbacks);
+    result->setProperty("dropped", (int64) report.numDropped);
+    result->setProperty("stageMicroseconds", var(stages));
+    result->setProperty("callbackMicroseconds", toVar(report.callback));
+    result->setProperty("deadlineLoad", toVar(report.load));
+    return var(result);
+}
+
+bool TSAudioProcessor::writeStageProfileReport (const juce::File& file)
+{
+    return file.replaceWithText(JSON::toString(takeStageProfileReport()));
 }
 
 //==============================================================================
 bool TSAudioProcessor::hasEditor() const
 {
+   #if TS_HEADLESS
+    return false;
+   #else
     return true; // (change this to false if you choose to not supply an editor)
+   #endif
 }
 
 juce::AudioProcessorEditor* TSAudioProcessor::createEditor()
 {
+   #if TS_HEADLESS
+    return nullptr;
+   #else
     return new TSAudioProcessorEditor (*this, parameters);
+   #endif
 }
 
 //==============================================================================
+// Binary state, little endian:
+//
+//     int32    magic, "TSst"
+//     int32    stateVersion
+//     int32    number of parameters, then for each:
+//                  parameter ID, null terminated UTF-8
+//                  float32 value in the parameter's own range
+//     int32    number of MIDI targets, then for each the controller or -1
+//
+// Parameters are matched by ID, so a state with other parameters still loads:
+// unknown IDs are skipped and missing parameters go to their defaults. Later
+// versions only append, and a reader ignores whatever follows what it knows.
+
 void TSAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
+{
+    MemoryOutputStream stream (destData, false);
+
+    stream.writeInt (binaryStateMagic);
+    stream.writeInt (stateVersion);
+    stream.writeInt ((int) stateParameters.size());
+
+    for (auto* parameter : stateParameters)
+    {
+        stream.writeString (parameter->paramID);
+        stream.writeFloat (parameter->convertFrom0to1 (parameter->getValue()));
+    }
+
+    stream.writeInt (numMidiTargets);
+
+    for (int target = 0; target < numMidiTargets; ++target)
+        stream.writeInt (getMidiController (MidiTarget (target)));
+}
+
+void TSAudioProcessor::getXmlStateInformation (juce::MemoryBlock& destData)
 {
         auto state = parameters.copyState();
+
+        for (int target = 0; target < numMidiTargets; ++target)
+            state.setProperty (getMidiStateProperty (target), getMidiController (MidiTarget (target)), nullptr);
+
         std::unique_ptr<juce::XmlElement> xml (state.createXml());
         copyXmlToBinary (*xml, destData);
 }
 
 void TSAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
+{
+    if (! readBinaryState (data, sizeInBytes))
+        readXmlState (data, sizeInBytes);
+}
+
+bool TSAudioProcessor::readBinaryState (const void* data, int sizeInBytes)
+{
+    if (data == nullptr || sizeInBytes < 12)
+        return false;
+
+    MemoryInputStream stream (data, size_t (sizeInBytes), false);
+
+    if (stream.readInt() != binaryStateMagic || stream.readInt() < 1)
+        return false;
+
+    const auto numParameters = stream.readInt();
+
+    if (numParameters < 0)
+        return false;
+
+    // Read through before changing anything, so a truncated state leaves the current one
+    std::vector<float> values (stateParameters.size());
+    std::vector<bool> found (stateParameters.size(), false);
+
+    for (int i = 0; i < numParameters; ++i)
+    {
+        const auto id = stream.readString();
+
+        if (stream.getNumBytesRemaining() < 4)
+            return false;
+
+        const auto value = stream.readFloat();
+
+        for (size_t index = 0; index < stateParameters.size(); ++index)
+        {
+            if (stateParameters[index]->paramID == id)
+            {
+                values[index] = value;
+                found[index] = true;
+                break;
+            }
+        }
+    }
+
+    // Every binary state has the controllers, so a state without them all was cut short
+    if (stream.getNumBytesRemaining() < 4)
+        return false;
+
+    const auto numTargets = stream.readInt();
+
+    if (numTargets < 0 || stream.getNumBytesRemaining() < 4 * int64 (numTargets))
+        return false;
+
+    std::array<int, numMidiTargets> controllers;
+    controllers.fill (-1);
+
+    for (int target = 0; target < numTargets; ++target)
+    {
+        const auto controller = stream.readInt();
+
+        if (target < numMidiTargets)
+            controllers[size_t (target)] = controller;
+    }
+
+    for (size_t index = 0; index < stateParameters.size(); ++index)
+    {
+        auto* parameter = stateParameters[index];
+        parameter->setValueNotifyingHost (found[index] ? parameter->convertTo0to1 (values[index])
+                                                       : parameter->getDefaultValue());
+    }
+
+    for (int target = 0; target < numMidiTargets; ++target)
+        setMidiController (MidiTarget (target), controllers[size_t (target)]);
+
+    return true;
+}
+
+void TSAudioProcessor::readXmlState (const void* data, int sizeInBytes)
 {
 	std::unique_ptr<juce::XmlElement> xmlState (getXmlFromBinary (data, sizeInBytes));
 
 	if (xmlState.get() != nullptr)
 		if (xmlState->hasTagName (parameters.state.getType()))
+		{
 			parameters.replaceState (juce::ValueTree::fromXml (*xmlState));
+
+			// Sessions saved before MIDI control have no assignments
+			for (int target = 0; target < numMidiTargets; ++target)
+				setMidiController (MidiTarget (target), parameters.state.getProperty (getMidiStateProperty (target), -1));
+		}
 }
 
 //==============================================================================
@@ -1,9 +1,19 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "TSEngine.h"
+
+// Console tools build the processor with TS_HEADLESS=1, which leaves the editor out
+#ifndef TS_HEADLESS
+ #define TS_HEADLESS 0
+#endif
 
 //==============================================================================
-class TSAudioProcessor  : public juce::AudioProcessor
+// Parameters, state and host plumbing around a TSEngine, which does all of the
+// signal processing with one stream per channel.
+class TSAudioProcessor  : public juce::AudioProcessor,
+                          private juce::AudioProcessorValueTreeState::Listener,
+                          private juce::AsyncUpdater
 {
 public:
     //==============================================================================
@@ -14,11 +24,26 @@ public:
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
 
+    // Clears the signal path's state without preparing again, e.g. between the
+    // files of an offline render. Not while processing.
+    void reset() override;
+
    #ifndef JucePlugin_PreferredChannelConfigurations
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+    // The engine is templated on the sample type; in double precision the
+    // filters, oversampler, clipper and wave digital model all run in double
+    bool supportsDoublePrecisionProcessing() const override;
+
+    void setNonRealtime (bool isNonRealtime) noexcept override;
+
+    // The "bypass" parameter, so hosts drive the engine's crossfading bypass
+    // rather than calling processBlockBypassed
+    juce::AudioProcessorParameter* getBypassParameter() const override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -40,65 +65,88 @@ public:
     void changeProgramName (int index, const juce::String& newName) override;
 
     //==============================================================================
+    // The state is a compact, versioned binary block of the parameter values (see
+    // TSProcessor.cpp), written and read without building a ValueTree or XML.
+    // setStateInformation still reads the XML states of earlier versions.
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
-    void updateFilterState() {
-
-		float Fs = currentSampleRate;
-		float Fs2 = std::powf(Fs, 2.0f);
-        
-        {
-            float Rdrive = Rpot_drive * (*driveParameter) + Rf_drive;
-
-            float bz2 =  4.0f * C1 * Cf * R1 * Rdrive * Fs2 + 2.0f * C1 * R1 * Fs + 2.0f * C1 * Rdrive * Fs + 2.0f * Cf * Rdrive * Fs + 1.0f;
-            float bz1 = -8.0f * C1 * Cf * R1 * Rdrive * Fs2 + 2.0f;
-            float bz0 =  4.0f * C1 * Cf * R1 * Rdrive * Fs2 - 2.0f * C1 * R1 * Fs - 2.0f * C1 * Rdrive * Fs - 2.0f * Cf * Rdrive * Fs + 1.0f;
-
-            float az2 =  4.0f * C1 * Cf * R1 * Rdrive * Fs2 + 2.0f * C1 * R1 * Fs + 2.0f * Cf * Rdrive * Fs + 1.0f;
-            float az1 = -8.0f * C1 * Cf * R1 * Rdrive * Fs2 + 2.0f;
-            float az0 =  4.0f * C1 * Cf * R1 * Rdrive * Fs2 - 2.0f * C1 * R1 * Fs - 2.0f * Cf * Rdrive * Fs + 1.0f;
-
-            bz2 /= az2;
-            bz1 /= az2;
-            bz0 /= az2;
-            az1 /= az2;
-            az0 /= az2;
-            az2 = 1.0f;
-
-            auto* newCoefficients = new juce::dsp::IIR::Coefficients<float>(bz2, bz1, bz0, az2, az1, az0);
-            driveFilter.coefficients = *newCoefficients;
-
-        }
-
-        {
-           // float smoothedTone = smoothedValue.getCurrentValue();
-           //smoothedValue.setTargetValue(*toneParameter);
-           // float Rpot1 = Rpot_tone * smoothedTone;
-           // float Rpot2 = Rpot_tone * (1.0f - smoothedTone);
-            float Rpot1 = Rpot_tone * (*toneParameter);
-            float Rpot2 = Rpot_tone * (toneRangeMax - *toneParameter);
-            
-            float bz2 =  2.0f * Ctone * R10k * R220 * Rpot1 * Fs + 2.0f * Ctone * R10k * R220 * Rpot2 * Fs + 2.0f * Ctone * R10k * Rf_tone * Rpot1 * Fs + 2.0f * Ctone * R10k * Rpot1 * Rpot2 * Fs + R10k * Rpot1 + R10k * Rpot2;
-            float bz1 =  2.0f * R10k * Rpot1 + 2.0f * R10k * Rpot2;
-            float bz0 = -2.0f * Ctone * R10k * R220 * Rpot1 * Fs - 2.0f * Ctone * R10k * R220 * Rpot2 * Fs - 2.0f * Ctone * R10k * Rf_tone * Rpot1 * Fs - 2.0f * Ctone * R10k * Rpot1 * Rpot2 * Fs + R10k * Rpot1 + R10k * Rpot2;
-
-            float az2 =  4.0f * C4 * Ctone * R10k * R1k * R220 * Rpot1 * Fs2 + 4.0f * C4 * Ctone * R10k * R1k * R220 * Rpot2 * Fs2 + 4.0f * C4 * Ctone * R10k * R1k * Rpot1 * Rpot2 * Fs2 + 2.0f * C4 * R10k * R1k * Rpot1 * Fs + 2.0f * C4 * R10k * R1k * Rpot2 * Fs + 2.0f * Ctone * R10k * R1k * Rpot2 * Fs + 2.0f * Ctone * R10k * R220 * Rpot1 * Fs + 2.0f * Ctone * R10k * R220 * Rpot2 * Fs + 2.0f * Ctone * R10k * Rpot1 * Rpot2 * Fs + 2.0f * Ctone * R1k * R220 * Rpot1 * Fs + 2.0f * Ctone * R1k * R220 * Rpot2 * Fs + 2.0f * Ctone * R1k * Rpot1 * Rpot2 * Fs + R10k * Rpot1 + R10k * Rpot2 + R1k * Rpot1 + R1k * Rpot2;
-            float az1 = -8.0f * C4 * Ctone * R10k * R1k * R220 * Rpot1 * Fs2 - 8.0f * C4 * Ctone * R10k * R1k * R220 * Rpot2 * Fs2 - 8.0f * C4 * Ctone * R10k * R1k * Rpot1 * Rpot2 * Fs2 + 2.0f * R10k * Rpot1 + 2 * R10k * Rpot2 + 2.0f * R1k * Rpot1 + 2.0f * R1k * Rpot2;
-            float az0 =  4.0f * C4 * Ctone * R10k * R1k * R220 * Rpot1 * Fs2 + 4.0f * C4 * Ctone * R10k * R1k * R220 * Rpot2 * Fs2 + 4.0f * C4 * Ctone * R10k * R1k * Rpot1 * Rpot2 * Fs2 - 2.0f * C4 * R10k * R1k * Rpot1 * Fs - 2.0f * C4 * R10k * R1k * Rpot2 * Fs - 2.0f * Ctone * R10k * R1k * Rpot2 * Fs - 2.0f * Ctone * R10k * R220 * Rpot1 * Fs - 2.0f * Ctone * R10k * R220 * Rpot2 * Fs - 2.0f * Ctone * R10k * Rpot1 * Rpot2 * Fs - 2.0f * Ctone * R1k * R220 * Rpot1 * Fs - 2.0f * Ctone * R1k * R220 * Rpot2 * Fs - 2.0f * Ctone * R1k * Rpot1 * Rpot2 * Fs + R10k * Rpot1 + R10k * Rpot2 + R1k * Rpot1 + R1k * Rpot2;
-            
-            bz2 /= az2;
-            bz1 /= az2;
-            bz0 /= az2;
-            az1 /= az2;
-            az0 /= az2;
-            az2 = 1.0f;
-
-            auto* newCoefficients = new juce::dsp::IIR::Coefficients<float>(bz2, bz1, bz0, az2, az1, az0);
-            toneFilter.coefficients = *newCoefficients;
-        }
+    // The state in the earlier XML format, which setStateInformation also reads
+    void getXmlStateInformation (juce::MemoryBlock& destData);
+
+    static constexpr int stateVersion = 1;
+
+    // The engine runs in tiles of this many samples whatever block size the host
+    // sends (see TSEngineSettings::tileSize), clamped to minTileSize..maxTileSize.
+    // A change rebuilds a prepared engine, off the audio thread.
+    void setTileSize (int numSamples);
+    int getTileSize() const noexcept    { return tileSize; }
+
+    static constexpr int minTileSize = 16;
+    static constexpr int maxTileSize = 4096;
+
+    // While drive or tone are smoothing, their filters are redesigned every this many samples
+    void setCoefficientUpdateInterval (int numSamples) noexcept;
+    int getCoefficientUpdateInterval() const noexcept    { return coefficientUpdateInterval; }
+
+    // Fused (the default), the engine pushes small slices of each tile through
+    // every stage while they are in cache (see TSEngine::setFusedProcessing)
+    void setFusedProcessing (bool shouldFuse) noexcept;
+    bool isFusedProcessing() const noexcept    { return fusedProcessing; }
+
+    // Switches the diode clipper between the analytic curve and the lookup table
+    // (see DiodeClipper). Safe to call while processing; both stay within
+    // DiodeClipper::maxAbsoluteError of the exact curve.
+    void setUseClipperTable (bool shouldUseTable) noexcept;
+    bool isUsingClipperTable() const noexcept;
+
+    // Levels and clipper activity for the editor. While enabled, the audio thread
+    // pushes the reading of every channel merged about every meterIntervalSeconds
+    // through a wait free FIFO. It never blocks or allocates for it; when the FIFO
+    // is full it keeps accumulating until the reader catches up.
+    void setMeteringEnabled (bool shouldMeter) noexcept;
+
+    // Reader side of the FIFO, one thread only. False once it is empty.
+    bool popMeterReading (TSMeterReading& reading) noexcept;
+
+    static constexpr double meterIntervalSeconds = 0.01;
+
+    // MIDI controllers for drive, tone, level and bypass. A controller moves its
+    // parameter through the whole range, 0 to 127 as the knob's travel, from the
+    // sample its event is stamped with; the host hears of the new value after the
+    // block. The assignments are saved with the state.
+    enum class MidiTarget
+    {
+        drive,
+        tone,
+        level,
+        bypass
     };
-    
+
+    static constexpr int numMidiTargets = 4;
+
+    // The next controller to arrive is assigned to target, and taken off any
+    // other target it had. Learning another target cancels the first.
+    void learnMidiController (MidiTarget target) noexcept;
+    void cancelMidiLearn() noexcept;
+    bool isLearningMidi (MidiTarget target) const noexcept;
+
+    // Controller number 0 to 127, or -1 for none
+    void setMidiController (MidiTarget target, int controller) noexcept;
+    int getMidiController (MidiTarget target) const noexcept;
+
+    // Stage timings of the engine, recorded when built with TS_PROFILE_STAGES=1
+    // (see StageProfiler). Takes everything recorded since the last call and
+    // returns it as JSON: percentiles of each stage and of the whole callback in
+    // microseconds, and of the callback time over its deadline. One thread at a time.
+    juce::var takeStageProfileReport();
+
+    // The same, written to a file for sessions that glitch away from a debugger
+    bool writeStageProfileReport (const juce::File& file);
+
+    const float parameterInterval = 0.001f;
+    const double parameterSmoothingSeconds = 0.05;
+
     const float driveRangeMin = 0.0f;
     const float driveRangeMax = 1.0f;
     const float driveSkewMidPoint = 0.5f;
@@ -111,39 +159,90 @@ public:
 
 
 private:
+    //==============================================================================
+    void parameterChanged (const juce::String& parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
 
-    // Circuit values for the OpAmp drive section
-    float Rpot_drive = 550E3f; // normally 500 
-    float Rf_drive = 51E3f;
-    float Cf = 51E-12f;
-    float R1 = 4700.0f;
-    float C1 = 0.047E-6f;
-
-    // Circuit values for the OpAmp tone section
-    float Rf_tone = 1E3f;
-    float Rpot_tone = 20E3f;
-    float R10k = 10E3f;
-    float R1k = 1E3f;
-    float R220 = 220.0f;
-    float C4 = 0.22E-6f;
-    float Ctone = 0.22E-6f;
-    
-    float currentSampleRate = 44100.0f;
+    // (Re)prepares the engine for the host's precision with the current oversampling
+    // settings, and reports the new latency. Allocates, so it only runs from
+    // prepareToPlay or with processing suspended.
+    void prepareOverSampling();
 
-    const int overSampleRatio = 1;
+    template <typename SampleType>
+    void prepareEngine (TSEngine<SampleType>& engine, const TSEngineSettings& settings);
 
-    dsp::Oversampling<float> overSampler{ getTotalNumOutputChannels(), overSampleRatio, dsp::Oversampling<float>::filterHalfBandFIREquiripple, true };
+    bool isEnginePrepared() const noexcept;
+
+    // The body of both processBlock overloads: hands the parameters to the engine
+    // and runs it over the buffer
+    template <typename SampleType>
+    void processWithEngine (AudioBuffer<SampleType>& buffer, MidiBuffer& midiMessages, TSEngine<SampleType>& engine);
+
+    // The target a controller moves, or -1. A controller arriving while a target
+    // is learning is assigned to it first.
+    int takeMidiController (int controller) noexcept;
+
+    // Tells the host of the parameters MIDI moved during the block
+    void publishMidiValues();
+
+    // False, having changed nothing, for data that is not a whole binary state
+    bool readBinaryState (const void* data, int sizeInBytes);
+    void readXmlState (const void* data, int sizeInBytes);
+
+    // Pushes the engine's meters once they cover meterIntervalSeconds and the FIFO has room
+    template <typename SampleType>
+    void publishMeters (TSEngine<SampleType>& engine) noexcept;
+
+    double currentSampleRate = 44100.0;
+
+    // The host's, for reports: the engine runs in tiles of its own
+    int maxBlockSize = 512;
+
+    std::atomic<int> tileSize { int (TSEngineSettings::defaultTileSize) };
+
+    // 16x
+    static constexpr int maxOverSamplingStages = Oversampler<float>::maxStages;
 
     std::atomic<float>* driveParameter = nullptr;
     std::atomic<float>* toneParameter  = nullptr;
     std::atomic<float>* levelParameter  = nullptr;
-
-    dsp::IIR::Filter<float> driveFilter;
-    dsp::IIR::Filter<float> toneFilter;
+    std::atomic<float>* overSamplingParameter = nullptr;
+    std::atomic<float>* overSamplingFilterParameter = nullptr;
+    std::atomic<float>* offlineQualityParameter = nullptr;
+    std::atomic<float>* driveModelParameter = nullptr;
+    std::atomic<float>* circuitModelParameter = nullptr;
+    std::atomic<float>* clipperAntiAliasingParameter = nullptr;
+    std::atomic<float>* bypassParameter = nullptr;
+
+    // Only the engine for the host's precision holds any memory
+    TSEngine<float> floatEngine;
+    TSEngine<double> doubleEngine;
+
+    // Handed to the engine at the top of every block, like the parameters
+    std::atomic<bool> useClipperTable { false };
+    std::atomic<bool> fusedProcessing { true };
 
     AudioProcessorValueTreeState parameters;
 
-    LinearSmoothedValue<float> smoothedValue;
+    std::atomic<int> coefficientUpdateInterval { 32 };
+
+    StageProfiler stageProfiler;
+
+    static constexpr int meterFifoSize = 64;
+    std::atomic<bool> meteringEnabled { false };
+    AbstractFifo meterFifo { meterFifoSize };
+    std::array<TSMeterReading, meterFifoSize> meterReadings;
+
+    // Every parameter, in the order the state writes them
+    std::vector<RangedAudioParameter*> stateParameters;
+
+    std::array<RangedAudioParameter*, numMidiTargets> midiParameters {};
+    std::array<std::atomic<int>, numMidiTargets> midiControllers;
+    std::atomic<int> midiLearnTarget { -1 };
+
+    // Audio thread: normalised values MIDI set this block, one bit per target moved
+    std::array<float, numMidiTargets> midiValues {};
+    uint32 midiMovedTargets = 0;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TSAudioProcessor)
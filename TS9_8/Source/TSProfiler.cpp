@@ -0,0 +1,196 @@
+#include "TSProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#if defined (__x86_64__) || defined (_M_X64)
+ #if defined (_MSC_VER) && ! defined (__clang__)
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+ #define TS_PROFILER_HAS_TSC 1
+#else
+ #define TS_PROFILER_HAS_TSC 0
+#endif
+
+namespace
+{
+    uint64_t steadyNanoseconds() noexcept
+    {
+        return uint64_t (std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // The counter against the steady clock over a short sleep. Current x86 CPUs
+    // have an invariant TSC, ticking at a constant rate whatever the core clock.
+    double calibrate()
+    {
+       #if TS_PROFILER_HAS_TSC
+        const auto startNs = steadyNanoseconds();
+        const auto startTicks = __rdtsc();
+
+        std::this_thread::sleep_for (std::chrono::milliseconds (20));
+
+        const auto elapsedNs = steadyNanoseconds() - startNs;
+        const auto elapsedTicks = __rdtsc() - startTicks;
+
+        return double (elapsedTicks) * 1.0e9 / double (std::max<uint64_t> (1, elapsedNs));
+       #else
+        return 1.0e9;
+       #endif
+    }
+
+    StageProfiler::Statistics getStatistics (std::vector<double> values)
+    {
+        StageProfiler::Statistics statistics;
+
+        if (values.empty())
+            return statistics;
+
+        std::sort (values.begin(), values.end());
+
+        const auto percentile = [&values] (double p)
+        {
+            return values[std::min (values.size() - 1, size_t (p * 0.01 * double (values.size() - 1) + 0.5))];
+        };
+
+        double sum = 0.0;
+
+        for (auto v : values)
+            sum += v;
+
+        statistics.mean = sum / double (values.size());
+        statistics.p50 = percentile (50.0);
+        statistics.p90 = percentile (90.0);
+        statistics.p99 = percentile (99.0);
+        statistics.p999 = percentile (99.9);
+        statistics.max = values.back();
+        return statistics;
+    }
+}
+
+//==============================================================================
+const char* StageProfiler::getStageName (int stage) noexcept
+{
+    switch (stage)
+    {
+        case input:         return "input";
+        case smoothing:     return "smoothing";
+        case upsample:      return "upsample";
+        case driveFilter:   return "driveFilter";
+        case clipper:       return "clipper";
+        case waveDigital:   return "waveDigital";
+        case downsample:    return "downsample";
+        case toneFilter:    return "toneFilter";
+        case output:        return "output";
+        default:            return "unknown";
+    }
+}
+
+uint64_t StageProfiler::now() noexcept
+{
+   #if TS_PROFILER_HAS_TSC
+    return uint64_t (__rdtsc());
+   #else
+    return steadyNanoseconds();
+   #endif
+}
+
+double StageProfiler::getTicksPerSecond() noexcept
+{
+    static const double ticksPerSecond = calibrate();
+    return ticksPerSecond;
+}
+
+//==============================================================================
+void StageProfiler::prepare (size_t capacity)
+{
+    size_t size = 1;
+
+    while (size < capacity)
+        size <<= 1;
+
+    ring.assign (size, {});
+    mask = size - 1;
+    writePosition = 0;
+    readPosition = 0;
+    numDropped = 0;
+    current = {};
+
+    getTicksPerSecond();
+}
+
+void StageProfiler::beginCallback() noexcept
+{
+    current = {};
+    callbackStart = now();
+}
+
+void StageProfiler::endCallback (uint32_t numSamples) noexcept
+{
+    current.callbackTicks = now() - callbackStart;
+    current.numSamples = numSamples;
+
+    if (ring.empty())
+        return;
+
+    const auto writeIndex = writePosition.load (std::memory_order_relaxed);
+
+    if (writeIndex - readPosition.load (std::memory_order_acquire) > mask)
+    {
+        numDropped.fetch_add (1, std::memory_order_relaxed);
+        return;
+    }
+
+    ring[writeIndex & mask] = current;
+    writePosition.store (writeIndex + 1, std::memory_order_release);
+}
+
+size_t StageProfiler::read (Record* destination, size_t maxRecords) noexcept
+{
+    const auto readIndex = readPosition.load (std::memory_order_relaxed);
+    const auto available = writePosition.load (std::memory_order_acquire) - readIndex;
+    const auto count = std::min (available, maxRecords);
+
+    for (size_t i = 0; i < count; ++i)
+        destination[i] = ring[(readIndex + i) & mask];
+
+    readPosition.store (readIndex + count, std::memory_order_release);
+    return count;
+}
+
+//==============================================================================
+StageProfiler::Report StageProfiler::summarise (const std::vector<Record>& records) const
+{
+    Report report;
+    report.numCallbacks = records.size();
+    report.numDropped = getNumDropped();
+
+    const auto rate = getSampleRate();
+
+    const auto microsecondsPerTick = 1.0e6 / getTicksPerSecond();
+    std::vector<double> values (records.size());
+
+    for (int stage = 0; stage < numStages; ++stage)
+    {
+        for (size_t i = 0; i < records.size(); ++i)
+            values[i] = double (records[i].stageTicks[stage]) * microsecondsPerTick;
+
+        report.stages[stage] = getStatistics (values);
+    }
+
+    for (size_t i = 0; i < records.size(); ++i)
+        values[i] = double (records[i].callbackTicks) * microsecondsPerTick;
+
+    report.callback = getStatistics (values);
+
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        const auto deadlineMicroseconds = double (records[i].numSamples) * 1.0e6 / rate;
+        values[i] = deadlineMicroseconds > 0.0 ? double (records[i].callbackTicks) * microsecondsPerTick / deadlineMicroseconds : 0.0;
+    }
+
+    report.load = getStatistics (values);
+    return report;
+}
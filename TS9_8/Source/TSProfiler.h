@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per stage timing of TSEngine::process(), for finding which part of the signal
+// path a glitching session is short of time in.
+//
+// Build with TS_PROFILE_STAGES=1 and the engine reads the time stamp counter
+// (the steady clock where there is none) at every stage boundary, adds the
+// laps up per stage over a callback and, when the callback ends, writes one
+// Record into a preallocated single producer, single consumer ring. That costs
+// one counter read per stage per sub-block and no locks or allocation. Without
+// the flag the markers compile to nothing.
+//
+// Another thread drains the ring with read() and turns the records into a
+// Report: percentiles of each stage and of the whole callback, and of the
+// callback time over its deadline (numSamples / sampleRate).
+
+#ifndef TS_PROFILE_STAGES
+ #define TS_PROFILE_STAGES 0
+#endif
+
+class StageProfiler
+{
+public:
+    enum Stage
+    {
+        input,          // planar buffers into frames
+        smoothing,      // drive and tone filter redesign while they move
+        upsample,
+        driveFilter,
+        clipper,
+        waveDigital,
+        downsample,
+        toneFilter,
+        output,         // level and frames back to planar buffers
+        numStages
+    };
+
+    static const char* getStageName (int stage) noexcept;
+
+    struct Record
+    {
+        uint64_t stageTicks[numStages] = {};
+        uint64_t callbackTicks = 0;
+        uint32_t numSamples = 0;
+    };
+
+    // Allocates the ring, rounded up to a power of two, and calibrates the
+    // counter on first use (a few milliseconds). Not on the audio thread.
+    void prepare (size_t capacity = 8192);
+
+    bool isPrepared() const noexcept    { return ! ring.empty(); }
+
+    // The rate the callback deadlines are worked out at. Set it on every prepare:
+    // the ring is allocated once, but the host may change the rate at any time.
+    void setSampleRate (double newSampleRate) noexcept    { sampleRate.store (newSampleRate, std::memory_order_relaxed); }
+    double getSampleRate() const noexcept                 { return sampleRate.load (std::memory_order_relaxed); }
+
+    // Audio thread. A record that finds the ring full is dropped and counted.
+    void beginCallback() noexcept;
+    void addStage (Stage stage, uint64_t ticks) noexcept    { current.stageTicks[stage] += ticks; }
+    void endCallback (uint32_t numSamples) noexcept;
+
+    // Reader thread: moves up to maxRecords of the oldest records out of the ring
+    size_t read (Record* destination, size_t maxRecords) noexcept;
+
+    uint64_t getNumDropped() const noexcept    { return numDropped.load (std::memory_order_relaxed); }
+
+    // Counter reading, and its rate
+    static uint64_t now() noexcept;
+    static double getTicksPerSecond() noexcept;
+
+    // Times of one stage, or the whole callback, in microseconds per callback
+    struct Statistics
+    {
+        double mean = 0.0, p50 = 0.0, p90 = 0.0, p99 = 0.0, p999 = 0.0, max = 0.0;
+    };
+
+    struct Report
+    {
+        size_t numCallbacks = 0;
+        uint64_t numDropped = 0;
+
+        Statistics stages[numStages];
+        Statistics callback;
+
+        // Callback time over its deadline: above 1 the callback was late
+        Statistics load;
+    };
+
+    Report summarise (const std::vector<Record>& records) const;
+
+    // Times the laps between stage boundaries of one call
+    class Lap
+    {
+    public:
+        explicit Lap (StageProfiler* p) noexcept    : profiler (p), last (p != nullptr ? now() : 0) {}
+
+        void mark (Stage stage) noexcept
+        {
+            if (profiler == nullptr)
+                return;
+
+            const auto time = now();
+            profiler->addStage (stage, time - last);
+            last = time;
+        }
+
+    private:
+        StageProfiler* profiler;
+        uint64_t last;
+    };
+
+    // Opens a record for the length of one host callback, around every
+    // TSEngine::process() call made for it
+    class Callback
+    {
+    public:
+        Callback (StageProfiler* p, size_t n) noexcept    : profiler (p), numSamples (uint32_t (n))    { if (profiler != nullptr) profiler->beginCallback(); }
+        ~Callback()                                         { if (profiler != nullptr) profiler->endCallback (numSamples); }
+
+        Callback (const Callback&) = delete;
+        Callback& operator= (const Callback&) = delete;
+
+    private:
+        StageProfiler* profiler;
+        uint32_t numSamples;
+    };
+
+private:
+    std::atomic<double> sampleRate { 44100.0 };
+
+    std::vector<Record> ring;
+    size_t mask = 0;
+    std::atomic<size_t> writePosition { 0 }, readPosition { 0 };
+    std::atomic<uint64_t> numDropped { 0 };
+
+    Record current;
+    uint64_t callbackStart = 0;
+};
+
+#if TS_PROFILE_STAGES
+ #define TS_PROFILE_CALLBACK(profiler, numSamples)   StageProfiler::Callback profileCallback (profiler, numSamples);
+ #define TS_PROFILE_LAP(profiler)                    StageProfiler::Lap profileLap (profiler);
+ #define TS_PROFILE_MARK(stage)                      profileLap.mark (StageProfiler::stage);
+#else
+ #define TS_PROFILE_CALLBACK(profiler, numSamples)
+ #define TS_PROFILE_LAP(profiler)
+ #define TS_PROFILE_MARK(stage)
+#endif
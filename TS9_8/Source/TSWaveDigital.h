@@ -0,0 +1,671 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "TSCircuit.h"
+#include "TSClipper.h"
+#include "TSFastMath.h"
+
+// Wave digital filter model of the drive stage, with the diode pair inside the
+// op-amp feedback loop instead of a memoryless clipper after a linear filter.
+//
+// With an ideal op-amp the inverting input follows the input voltage, so the
+// R1-C1 leg to ground draws i = Vin / (R1 + 1/sC1). The same current flows
+// through the feedback network, Rdrive || Cf || diode pair, and the output is
+//
+//     Vout = Vin + Vf
+//
+// where Vf is the voltage across that network. Both halves are wave digital
+// trees: the input leg is a series adaptor driven by an ideal voltage source,
+// the feedback network a parallel adaptor (the current source with Rdrive, and
+// Cf) below the diode pair as the nonlinear root.
+//
+// Every element and adaptor is a template parameterised on its children, so a
+// whole tree is one concrete type: the compiler sees the complete scattering
+// structure, inlines it into processSample() and folds the constant parts.
+//
+// The sample type T is either a plain float/double or Lanes<float/double, N>,
+// N independent streams side by side: every wave, resistance and state holds
+// one value per stream, so one pass through the tree advances a whole register
+// of streams, as the engine's frames are laid out. Nothing in the tree branches
+// on a sample value, so the lanes never diverge.
+namespace WaveDigital
+{
+    // N streams as a fixed length array. On x86 the engine's register widths,
+    // four floats and two doubles, are the SSE2 specialisations below.
+    template <typename Scalar, size_t Width>
+    struct Lanes
+    {
+        Scalar values[Width];
+
+        Lanes() noexcept = default;
+        Lanes (Scalar value) noexcept    { std::fill (values, values + Width, value); }
+
+        static Lanes load (const Scalar* source) noexcept    { Lanes x; std::copy (source, source + Width, x.values); return x; }
+        void store (Scalar* destination) const noexcept      { std::copy (values, values + Width, destination); }
+
+        Lanes operator-() const noexcept    { return apply ([] (Scalar x) { return -x; }); }
+
+        friend Lanes operator+ (const Lanes& a, const Lanes& b) noexcept    { return a.apply (b, [] (Scalar x, Scalar y) { return x + y; }); }
+        friend Lanes operator- (const Lanes& a, const Lanes& b) noexcept    { return a.apply (b, [] (Scalar x, Scalar y) { return x - y; }); }
+        friend Lanes operator* (const Lanes& a, const Lanes& b) noexcept    { return a.apply (b, [] (Scalar x, Scalar y) { return x * y; }); }
+        friend Lanes operator/ (const Lanes& a, const Lanes& b) noexcept    { return a.apply (b, [] (Scalar x, Scalar y) { return x / y; }); }
+
+        template <typename Function>
+        Lanes apply (Function&& f) const noexcept
+        {
+            Lanes result;
+
+            for (size_t i = 0; i < Width; ++i)
+                result.values[i] = f (values[i]);
+
+            return result;
+        }
+
+        template <typename Function>
+        Lanes apply (const Lanes& other, Function&& f) const noexcept
+        {
+            Lanes result;
+
+            for (size_t i = 0; i < Width; ++i)
+                result.values[i] = f (values[i], other.values[i]);
+
+            return result;
+        }
+    };
+
+    // The scalar type and lane count of a sample type, and moving it to and from memory
+    template <typename T>
+    struct LaneTraits
+    {
+        using Scalar = T;
+        static constexpr size_t width = 1;
+
+        static T load (const Scalar* source) noexcept            { return *source; }
+        static void store (T x, Scalar* destination) noexcept    { *destination = x; }
+    };
+
+    template <typename ScalarType, size_t Width>
+    struct LaneTraits<Lanes<ScalarType, Width>>
+    {
+        using Scalar = ScalarType;
+        static constexpr size_t width = Width;
+
+        static Lanes<Scalar, Width> load (const Scalar* source) noexcept                 { return Lanes<Scalar, Width>::load (source); }
+        static void store (const Lanes<Scalar, Width>& x, Scalar* destination) noexcept  { x.store (destination); }
+    };
+
+    //==============================================================================
+    // Maths on any sample type. Single precision runs on the inlined approximation.
+
+    inline float log (float x) noexcept      { return FastMath::log (x); }
+    inline double log (double x) noexcept    { return std::log (x); }
+
+    // log (x) to single precision whatever the type, for Newton steps that are not the last
+    inline float roughLog (float x) noexcept      { return FastMath::log (x); }
+    inline double roughLog (double x) noexcept    { return double (FastMath::log (float (x))); }
+
+    template <typename T> T abs (T x) noexcept          { return x < T (0) ? -x : x; }
+    template <typename T> T min (T x, T y) noexcept     { return y < x ? y : x; }
+    template <typename T> T max (T x, T y) noexcept     { return x < y ? y : x; }
+
+    // magnitude, negated where sign is negative
+    template <typename T> T withSignOf (T magnitude, T sign) noexcept    { return sign < T (0) ? -magnitude : magnitude; }
+
+    // A lower bound on exp (x) for x in [-80, 0], off by at most 7%: x / log (2)
+    // scaled into the exponent field, so the mantissa interpolates 2^x linearly,
+    // which overshoots by up to 6.2%, and then lowered by 7%.
+    inline float expBelow (float x) noexcept
+    {
+        x = x < -80.0f ? -80.0f : x;
+        return FastMath::bitsToFloat (uint32_t (int32_t (x * 12102203.0f + 1064623216.0f)));
+    }
+
+    // The same in double precision through the upper 32 bits only
+    inline double expBelow (double x) noexcept
+    {
+        x = x < -80.0 ? -80.0 : x;
+        const auto bits = uint64_t (uint32_t (int32_t (x * 1512775.3951951857 + 1072601248.0))) << 32;
+
+        double result;
+        std::memcpy (&result, &bits, sizeof (result));
+        return result;
+    }
+
+    template <typename Scalar, size_t Width>
+    Lanes<Scalar, Width> log (const Lanes<Scalar, Width>& x) noexcept    { return x.apply ([] (Scalar v) { return log (v); }); }
+
+    template <typename Scalar, size_t Width>
+    Lanes<Scalar, Width> roughLog (const Lanes<Scalar, Width>& x) noexcept    { return x.apply ([] (Scalar v) { return roughLog (v); }); }
+
+    template <typename Scalar, size_t Width>
+    Lanes<Scalar, Width> expBelow (const Lanes<Scalar, Width>& x) noexcept    { return x.apply ([] (Scalar v) { return expBelow (v); }); }
+
+    template <typename Scalar, size_t Width>
+    Lanes<Scalar, Width> abs (const Lanes<Scalar, Width>& x) noexcept    { return x.apply ([] (Scalar v) { return abs (v); }); }
+
+    template <typename Scalar, size_t Width>
+    Lanes<Scalar, Width> min (const Lanes<Scalar, Width>& x, const Lanes<Scalar, Width>& y) noexcept
+    {
+        return x.apply (y, [] (Scalar a, Scalar b) { return min (a, b); });
+    }
+
+    template <typename Scalar, size_t Width>
+    Lanes<Scalar, Width> max (const Lanes<Scalar, Width>& x, const Lanes<Scalar, Width>& y) noexcept
+    {
+        return x.apply (y, [] (Scalar a, Scalar b) { return max (a, b); });
+    }
+
+    template <typename Scalar, size_t Width>
+    Lanes<Scalar, Width> withSignOf (const Lanes<Scalar, Width>& magnitude, const Lanes<Scalar, Width>& sign) noexcept
+    {
+        return magnitude.apply (sign, [] (Scalar m, Scalar s) { return withSignOf (m, s); });
+    }
+
+   #if TS_FAST_MATH_SSE2
+    //==============================================================================
+    // The compiler does not reliably keep the arrays above in registers through
+    // the whole tree, so the register widths are spelled out in SSE2.
+
+    template <>
+    struct Lanes<float, 4>
+    {
+        __m128 v;
+
+        Lanes() noexcept = default;
+        Lanes (float value) noexcept     : v (_mm_set1_ps (value)) {}
+        Lanes (__m128 value) noexcept    : v (value) {}
+
+        static Lanes load (const float* source) noexcept    { return _mm_loadu_ps (source); }
+        void store (float* destination) const noexcept      { _mm_storeu_ps (destination, v); }
+
+        Lanes operator-() const noexcept    { return _mm_xor_ps (v, _mm_set1_ps (-0.0f)); }
+
+        friend Lanes operator+ (Lanes a, Lanes b) noexcept    { return _mm_add_ps (a.v, b.v); }
+        friend Lanes operator- (Lanes a, Lanes b) noexcept    { return _mm_sub_ps (a.v, b.v); }
+        friend Lanes operator* (Lanes a, Lanes b) noexcept    { return _mm_mul_ps (a.v, b.v); }
+        friend Lanes operator/ (Lanes a, Lanes b) noexcept    { return _mm_div_ps (a.v, b.v); }
+    };
+
+    inline Lanes<float, 4> log (Lanes<float, 4> x) noexcept         { return FastMath::log (x.v); }
+    inline Lanes<float, 4> roughLog (Lanes<float, 4> x) noexcept    { return FastMath::log (x.v); }
+
+    inline Lanes<float, 4> expBelow (Lanes<float, 4> x) noexcept
+    {
+        const auto scaled = _mm_mul_ps (_mm_max_ps (x.v, _mm_set1_ps (-80.0f)), _mm_set1_ps (12102203.0f));
+        return _mm_castsi128_ps (_mm_cvttps_epi32 (_mm_add_ps (scaled, _mm_set1_ps (1064623216.0f))));
+    }
+
+    inline Lanes<float, 4> abs (Lanes<float, 4> x) noexcept                       { return _mm_andnot_ps (_mm_set1_ps (-0.0f), x.v); }
+    inline Lanes<float, 4> min (Lanes<float, 4> x, Lanes<float, 4> y) noexcept    { return _mm_min_ps (x.v, y.v); }
+    inline Lanes<float, 4> max (Lanes<float, 4> x, Lanes<float, 4> y) noexcept    { return _mm_max_ps (x.v, y.v); }
+
+    inline Lanes<float, 4> withSignOf (Lanes<float, 4> magnitude, Lanes<float, 4> sign) noexcept
+    {
+        return _mm_xor_ps (magnitude.v, _mm_and_ps (sign.v, _mm_set1_ps (-0.0f)));
+    }
+
+    template <>
+    struct Lanes<double, 2>
+    {
+        __m128d v;
+
+        Lanes() noexcept = default;
+        Lanes (double value) noexcept     : v (_mm_set1_pd (value)) {}
+        Lanes (__m128d value) noexcept    : v (value) {}
+
+        static Lanes load (const double* source) noexcept    { return _mm_loadu_pd (source); }
+        void store (double* destination) const noexcept      { _mm_storeu_pd (destination, v); }
+
+        Lanes operator-() const noexcept    { return _mm_xor_pd (v, _mm_set1_pd (-0.0)); }
+
+        friend Lanes operator+ (Lanes a, Lanes b) noexcept    { return _mm_add_pd (a.v, b.v); }
+        friend Lanes operator- (Lanes a, Lanes b) noexcept    { return _mm_sub_pd (a.v, b.v); }
+        friend Lanes operator* (Lanes a, Lanes b) noexcept    { return _mm_mul_pd (a.v, b.v); }
+        friend Lanes operator/ (Lanes a, Lanes b) noexcept    { return _mm_div_pd (a.v, b.v); }
+    };
+
+    // Double precision keeps the library log, a lane at a time
+    inline Lanes<double, 2> log (Lanes<double, 2> x) noexcept
+    {
+        double values[2];
+        x.store (values);
+        return _mm_setr_pd (std::log (values[0]), std::log (values[1]));
+    }
+
+    inline Lanes<double, 2> roughLog (Lanes<double, 2> x) noexcept
+    {
+        return _mm_cvtps_pd (FastMath::log (_mm_cvtpd_ps (x.v)));
+    }
+
+    inline Lanes<double, 2> expBelow (Lanes<double, 2> x) noexcept
+    {
+        const auto scaled = _mm_mul_pd (_mm_max_pd (x.v, _mm_set1_pd (-80.0)), _mm_set1_pd (1512775.3951951857));
+        const auto upper = _mm_cvttpd_epi32 (_mm_add_pd (scaled, _mm_set1_pd (1072601248.0)));
+        return _mm_castsi128_pd (_mm_unpacklo_epi32 (_mm_setzero_si128(), upper));
+    }
+
+    inline Lanes<double, 2> abs (Lanes<double, 2> x) noexcept                        { return _mm_andnot_pd (_mm_set1_pd (-0.0), x.v); }
+    inline Lanes<double, 2> min (Lanes<double, 2> x, Lanes<double, 2> y) noexcept    { return _mm_min_pd (x.v, y.v); }
+    inline Lanes<double, 2> max (Lanes<double, 2> x, Lanes<double, 2> y) noexcept    { return _mm_max_pd (x.v, y.v); }
+
+    inline Lanes<double, 2> withSignOf (Lanes<double, 2> magnitude, Lanes<double, 2> sign) noexcept
+    {
+        return _mm_xor_pd (magnitude.v, _mm_and_pd (sign.v, _mm_set1_pd (-0.0)));
+    }
+   #endif
+
+    //==============================================================================
+    // Leaves. Each reflects a wave b from its state, then takes the incident wave a.
+    // update() is there so adaptors can recurse through any child alike.
+
+    template <typename T>
+    class Resistor
+    {
+    public:
+        void setResistance (T newResistance) noexcept    { R = newResistance; }
+        T getPortResistance() const noexcept             { return R; }
+        void update() noexcept                           {}
+
+        T reflected() noexcept                           { return T (0); }
+        void incident (T) noexcept                       {}
+        void reset() noexcept                            {}
+
+    private:
+        T R = T (1);
+    };
+
+    // Bilinear transform capacitor: port resistance 1 / (2 C fs), a one sample delay of the wave
+    template <typename T>
+    class Capacitor
+    {
+    public:
+        void setCapacitance (T capacitance, T sampleRate) noexcept    { R = T (1) / (T (2) * capacitance * sampleRate); }
+        T getPortResistance() const noexcept                          { return R; }
+        void update() noexcept                                        {}
+
+        T reflected() noexcept                                        { return state; }
+        void incident (T a) noexcept                                  { state = a; }
+        void reset() noexcept                                         { state = T (0); }
+
+    private:
+        T R = T (1);
+        T state = T (0);
+    };
+
+    // Current source J in parallel with R (its Thevenin equivalent is a source R * J behind R)
+    template <typename T>
+    class ResistiveCurrentSource
+    {
+    public:
+        void setResistance (T newResistance) noexcept    { R = newResistance; }
+        void setCurrent (T newCurrent) noexcept          { J = newCurrent; }
+        T getPortResistance() const noexcept             { return R; }
+        void update() noexcept                           {}
+
+        T reflected() noexcept                           { return R * J; }
+        void incident (T) noexcept                       {}
+        void reset() noexcept                            { J = T (0); }
+
+    private:
+        T R = T (1);
+        T J = T (0);
+    };
+
+    //==============================================================================
+    // Three port adaptors with the upward facing port adapted, so their
+    // reflection towards the root never depends on the wave coming down.
+
+    template <typename T, typename Port1, typename Port2>
+    class SeriesAdaptor
+    {
+    public:
+        Port1 port1;
+        Port2 port2;
+
+        // Call after changing any resistance below this adaptor
+        void update() noexcept
+        {
+            port1.update();
+            port2.update();
+
+            R = port1.getPortResistance() + port2.getPortResistance();
+            ratio1 = port1.getPortResistance() / R;
+        }
+
+        T getPortResistance() const noexcept    { return R; }
+
+        T reflected() noexcept
+        {
+            b1 = port1.reflected();
+            b2 = port2.reflected();
+            return -(b1 + b2);
+        }
+
+        void incident (T a) noexcept
+        {
+            const auto sum = a + b1 + b2;
+            port1.incident (b1 - ratio1 * sum);
+            port2.incident (b2 - (T (1) - ratio1) * sum);
+        }
+
+        void reset() noexcept    { port1.reset(); port2.reset(); }
+
+    private:
+        T R = T (1), ratio1 = T (0.5);
+        T b1 = T (0), b2 = T (0);
+    };
+
+    template <typename T, typename Port1, typename Port2>
+    class ParallelAdaptor
+    {
+    public:
+        Port1 port1;
+        Port2 port2;
+
+        // Call after changing any resistance below this adaptor
+        void update() noexcept
+        {
+            port1.update();
+            port2.update();
+
+            const auto G1 = T (1) / port1.getPortResistance();
+            const auto G2 = T (1) / port2.getPortResistance();
+
+            R = T (1) / (G1 + G2);
+            ratio1 = G1 * R;
+        }
+
+        T getPortResistance() const noexcept    { return R; }
+
+        T reflected() noexcept
+        {
+            b1 = port1.reflected();
+            b2 = port2.reflected();
+            b = ratio1 * b1 + (T (1) - ratio1) * b2;
+            return b;
+        }
+
+        void incident (T a) noexcept
+        {
+            port1.incident (a + b - b1);
+            port2.incident (a + b - b2);
+        }
+
+        void reset() noexcept    { port1.reset(); port2.reset(); }
+
+    private:
+        T R = T (1), ratio1 = T (0.5);
+        T b = T (0), b1 = T (0), b2 = T (0);
+    };
+
+    //==============================================================================
+    // Roots
+
+    template <typename T, typename Child>
+    class IdealVoltageSource
+    {
+    public:
+        Child child;
+
+        // Call after changing any resistance in the tree
+        void update() noexcept
+        {
+            child.update();
+            halfConductance = T (1) / (T (2) * child.getPortResistance());
+        }
+
+        // Returns the current the source drives into the tree
+        T process (T voltage) noexcept
+        {
+            const auto b = child.reflected();
+            const auto a = T (2) * voltage - b;
+            child.incident (a);
+
+            return (a - b) * halfConductance;
+        }
+
+        void reset() noexcept    { child.reset(); }
+
+    private:
+        T halfConductance = T (0.5);
+    };
+
+    // Antiparallel diode pair, i = 2 Is sinh (v / nvt), with the clipper's diode
+    // constants. The root solves
+    //
+    //     a = v + 2 R Is sinh (v / nvt)
+    //
+    // for the port voltage v. Only the forward biased diode carries measurable
+    // current (the other contributes under R * Is, about 1e-9 V here), which
+    // leaves a = |v| + R Is exp (|v| / nvt) with the closed form solution
+    //
+    //     |v| = |a| - nvt * omega (log (R Is / nvt) + |a| / nvt)
+    //
+    // omega being the Wright omega function, omega + log (omega) = x, followed by
+    // NewtonIterations Newton steps on that equation, a fixed count so the cost
+    // per sample is constant.
+    //
+    // The steps start from the largest of several lower bounds. omega is convex,
+    // so every tangent to it lies below it: the tangent at the previous sample's
+    // solution, which tracks the signal closely from one sample to the next, and
+    // fixed tangents at omega = 4^k, k = -4 .. 3, which catch a fast rise through
+    // the diode knee where the previous tangent is far too flat. Left of those,
+    // omega is above u - u^2 for u a bit-manipulated lower bound on exp (x),
+    // which catches a fast fall into the quiet region. Newton's method on the
+    // concave omega + log (omega) - x climbs monotonically from any point below
+    // the root, so no start overshoots. Against a converged solution, one step
+    // is within 2e-4 V in float, and three (the first two on a single precision
+    // log) within 1e-11 V in double.
+    template <typename T, typename Child, int NewtonIterations = 1>
+    class DiodePairRoot
+    {
+    public:
+        static_assert (NewtonIterations >= 1, "The warm start needs at least one Newton step");
+
+        using Scalar = typename LaneTraits<T>::Scalar;
+
+        Child child;
+
+        // Call after changing any resistance in the tree
+        void update() noexcept
+        {
+            child.update();
+            logRIsOverNvt = WaveDigital::log (child.getPortResistance() * T (Is / nvt));
+        }
+
+        // Returns the voltage across the diodes
+        T process() noexcept
+        {
+            const auto a = child.reflected();
+            const auto magnitude = WaveDigital::abs (a);
+            const auto v = withSignOf (magnitude - T (nvt) * omega (logRIsOverNvt + magnitude * T (Scalar (1) / nvt)), a);
+            child.incident (T (2) * v - a);
+            incidentWave = a;
+            return v;
+        }
+
+        // The last wave from the child, the voltage across the diodes were they not conducting
+        T getIncidentWave() const noexcept    { return incidentWave; }
+
+        void reset() noexcept
+        {
+            child.reset();
+            incidentWave = T (Scalar (0));
+            tangentOmega = T (Scalar (0));
+            tangentX = T (Scalar (-100));
+            tangentSlope = T (Scalar (0));
+        }
+
+    private:
+        T omega (T x) noexcept
+        {
+            const auto one = T (Scalar (1));
+
+            const auto tangent = [&x] (size_t i) { return T (fixedTangents[i][0]) * (x + T (fixedTangents[i][1])); };
+
+            // Pairwise, so the maxima are four deep rather than nine
+            const auto low = WaveDigital::max (WaveDigital::max (tangent (0), tangent (1)), WaveDigital::max (tangent (2), tangent (3)));
+            const auto high = WaveDigital::max (WaveDigital::max (tangent (4), tangent (5)), WaveDigital::max (tangent (6), tangent (7)));
+
+            auto y = WaveDigital::max (tangentOmega + (x - tangentX) * tangentSlope, WaveDigital::max (low, high));
+
+            // Further left omega is near exp (x), and above u - u^2 for any u <= exp (x)
+            const auto u = expBelow (WaveDigital::min (x, T (Scalar (0))));
+            y = WaveDigital::max (y, u - u * u);
+
+            for (int i = 0; i < NewtonIterations; ++i)
+            {
+                // Each step squares the error, so only the last needs the full precision log
+                const auto logY = i < NewtonIterations - 1 ? roughLog (y) : WaveDigital::log (y);
+
+                // Taken apart so the division runs alongside the log
+                const auto slope = y / (one + y);
+
+                // The point on the curve this step starts from, whose tangent seeds the next sample
+                if (i == NewtonIterations - 1)
+                {
+                    tangentOmega = y;
+                    tangentX = y + logY;
+                    tangentSlope = slope;
+                }
+
+                y = slope * (one + x - logY);
+            }
+
+            return y;
+        }
+
+        // The tangent at omega = w is w / (1 + w) * (x + 1 - log (w)), here for
+        // w = 4^k, k = -4 .. 3, as { w / (1 + w), 1 - log (w) }
+        static constexpr size_t numFixedTangents = 8;
+
+        static constexpr Scalar fixedTangents[numFixedTangents][2] =
+        {
+            { Scalar (1.0 / 257.0),   Scalar (6.545177444479562) },
+            { Scalar (1.0 / 65.0),    Scalar (5.1588830833596715) },
+            { Scalar (1.0 / 17.0),    Scalar (3.772588722239781) },
+            { Scalar (1.0 / 5.0),     Scalar (2.386294361119891) },
+            { Scalar (1.0 / 2.0),     Scalar (1.0) },
+            { Scalar (4.0 / 5.0),     Scalar (-0.3862943611198906) },
+            { Scalar (16.0 / 17.0),   Scalar (-1.772588722239781) },
+            { Scalar (64.0 / 65.0),   Scalar (-3.1588830833596715) }
+        };
+
+        static constexpr Scalar Is = Scalar (DiodeClipper::Is);
+        static constexpr Scalar nvt = Scalar (DiodeClipper::nvt);
+
+        T logRIsOverNvt = T (Scalar (0));
+        T incidentWave = T (Scalar (0));
+
+        // Last solution as a point on the curve, (omega + log (omega), omega)
+        T tangentOmega = T (Scalar (0)), tangentX = T (Scalar (-100));
+
+        // Its slope, omega / (1 + omega), worked out while the rest of the tree settles
+        T tangentSlope = T (Scalar (0));
+    };
+
+    //==============================================================================
+    template <typename T, int NewtonIterations = 1>
+    class DriveStage
+    {
+    public:
+        using Scalar = typename LaneTraits<T>::Scalar;
+        static constexpr size_t width = LaneTraits<T>::width;
+
+        // Sets every component value, then clears the state
+        void prepare (const DriveStageValues& circuit, double sampleRate) noexcept
+        {
+            setCircuit (circuit, sampleRate);
+            setDrive (T (Scalar (0)));
+            reset();
+        }
+
+        // New component values, keeping the state, for switching between circuit
+        // variants while running. The drive resistance is left to setDrive().
+        void setCircuit (const DriveStageValues& circuit, double sampleRate) noexcept
+        {
+            values = circuit;
+
+            input.child.port1.setResistance (T (Scalar (values.R1)));
+            input.child.port2.setCapacitance (T (Scalar (values.C1)), T (Scalar (sampleRate)));
+            input.update();
+
+            feedback.child.port2.setCapacitance (T (Scalar (values.Cf)), T (Scalar (sampleRate)));
+            feedback.update();
+        }
+
+        // Cheap enough to call every few samples while drive is smoothing
+        void setDrive (T drive) noexcept
+        {
+            setDriveResistance (T (Scalar (values.Rf)) + drive * T (Scalar (values.Rpot)));
+        }
+
+        // Rf + drive * Rpot given directly, as when blending between circuits
+        void setDriveResistance (T resistance) noexcept
+        {
+            feedback.child.port1.setResistance (resistance);
+            feedback.update();
+        }
+
+        // The same for one lane, the others keeping theirs
+        void setDriveResistance (size_t lane, Scalar resistance) noexcept
+        {
+            Scalar resistances[width];
+            LaneTraits<T>::store (feedback.child.port1.getPortResistance(), resistances);
+            resistances[lane] = resistance;
+            setDriveResistance (LaneTraits<T>::load (resistances));
+        }
+
+        void reset() noexcept
+        {
+            input.reset();
+            feedback.reset();
+        }
+
+        T processSample (T x) noexcept
+        {
+            feedback.child.port1.setCurrent (input.process (x));
+            return x + feedback.process();
+        }
+
+        void process (const T* source, T* destination, size_t numSamples) noexcept
+        {
+            for (size_t i = 0; i < numSamples; ++i)
+                destination[i] = processSample (source[i]);
+        }
+
+        // In place over interleaved frames stride scalars apart, the lanes of
+        // this stage being the first width scalars of each
+        void processFrames (Scalar* frames, size_t numFrames, size_t stride) noexcept
+        {
+            for (size_t n = 0; n < numFrames; ++n, frames += stride)
+                LaneTraits<T>::store (processSample (LaneTraits<T>::load (frames)), frames);
+        }
+
+        // The voltage the feedback network drove across the diodes at the last
+        // sample, as if they did not conduct: the clipper input's counterpart
+        T getDiodeDrive() const noexcept    { return feedback.getIncidentWave(); }
+
+        // The resistance the diodes see, which takes R2's place in the clipper's
+        // limit voltage (DiodeClipper::getLimitVoltage())
+        Scalar getDiodeResistance (size_t lane) const noexcept
+        {
+            Scalar resistances[width];
+            LaneTraits<T>::store (feedback.child.getPortResistance(), resistances);
+            return resistances[lane];
+        }
+
+    private:
+        DriveStageValues values;
+
+        // R1 and C1 from the inverting input to ground
+        IdealVoltageSource<T, SeriesAdaptor<T, Resistor<T>, Capacitor<T>>> input;
+
+        // Rdrive || Cf || diodes between the output and the inverting input
+        DiodePairRoot<T, ParallelAdaptor<T, ResistiveCurrentSource<T>, Capacitor<T>>, NewtonIterations> feedback;
+    };
+}
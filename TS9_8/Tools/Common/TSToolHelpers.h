@@ -0,0 +1,58 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../Source/TSProcessor.h"
+
+// Helpers shared by the console tools for driving TSAudioProcessor without a host.
+namespace TSTools
+{
+    // Sets a parameter by ID from its plain (denormalised) value, as a host would
+    inline bool setParameter (juce::AudioProcessor& processor, const juce::String& parameterID, float plainValue)
+    {
+        for (auto* parameter : processor.getParameters())
+        {
+            if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (parameter))
+            {
+                if (ranged->paramID == parameterID)
+                {
+                    ranged->setValueNotifyingHost (ranged->convertTo0to1 (plainValue));
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    // Index of an oversampling factor (1, 2, 4, 8 or 16) in the "oversampling" choice, -1 if invalid
+    inline int getOversamplingIndex (int factor)
+    {
+        for (int index = 0; index <= 4; ++index)
+            if ((1 << index) == factor)
+                return index;
+
+        return -1;
+    }
+
+    // Matching input and output buses with the given number of channels
+    inline bool setChannelCount (juce::AudioProcessor& processor, int numChannels)
+    {
+        const auto channelSet = juce::AudioChannelSet::canonicalChannelSet (numChannels);
+
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add (channelSet);
+        layout.outputBuses.add (channelSet);
+
+        return processor.setBusesLayout (layout);
+    }
+
+    // Prepares the processor the way a host does before the first callback
+    inline void prepare (juce::AudioProcessor& processor, double sampleRate, int blockSize, bool nonRealtime,
+                         juce::AudioProcessor::ProcessingPrecision precision = juce::AudioProcessor::singlePrecision)
+    {
+        processor.setProcessingPrecision (precision);
+        processor.setNonRealtime (nonRealtime);
+        processor.setRateAndBufferSizeDetails (sampleRate, blockSize);
+        processor.prepareToPlay (sampleRate, blockSize);
+    }
+}
@@ -0,0 +1,200 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtilities.h"
+#include "../../Common/TSToolHelpers.h"
+#include "../../../Source/TSAllocationTrap.h"
+
+namespace
+{
+    struct CheckSettings
+    {
+        double sampleRate = 48000.0;
+        int blockSize = 256;
+        int numChannels = 2;
+        int blocksPerStep = 64;
+    };
+
+    // One change made the way a host makes it, then blocks run under the trap
+    struct Step
+    {
+        juce::String name;
+        std::function<void (TSAudioProcessor&, juce::MidiBuffer&, int block)> beforeBlock;
+
+        // Settings that rebuild the engine are picked up when the host prepares again
+        bool preparesAgain = false;
+    };
+
+    std::vector<Step> makeSteps()
+    {
+        std::vector<Step> steps;
+
+        steps.push_back ({ "steady", [] (TSAudioProcessor&, juce::MidiBuffer&, int) {} });
+
+        steps.push_back ({ "automation", [] (TSAudioProcessor& processor, juce::MidiBuffer&, int block)
+        {
+            const auto phase = float (block % 16) / 15.0f;
+            TSTools::setParameter (processor, "drive", phase);
+            TSTools::setParameter (processor, "tone", 1.0f - phase);
+            TSTools::setParameter (processor, "level", 0.2f + 0.6f * phase);
+        } });
+
+        for (int circuit = 0; circuit < numCircuitModels; ++circuit)
+            steps.push_back ({ "circuit " + juce::String (circuit), [circuit] (TSAudioProcessor& processor, juce::MidiBuffer&, int)
+            {
+                TSTools::setParameter (processor, "circuitModel", float (circuit));
+            } });
+
+        // The wave digital model only runs offline
+        steps.push_back ({ "wave digital", [] (TSAudioProcessor& processor, juce::MidiBuffer&, int block)
+        {
+            processor.setNonRealtime (true);
+            TSTools::setParameter (processor, "driveModel", 1.0f);
+            TSTools::setParameter (processor, "drive", float (block % 8) / 7.0f);
+        } });
+
+        steps.push_back ({ "filter and clipper", [] (TSAudioProcessor& processor, juce::MidiBuffer&, int)
+        {
+            processor.setNonRealtime (false);
+            TSTools::setParameter (processor, "driveModel", 0.0f);
+        } });
+
+        steps.push_back ({ "clipper table", [] (TSAudioProcessor& processor, juce::MidiBuffer&, int block)
+        {
+            processor.setUseClipperTable (block % 2 == 0);
+        } });
+
+        steps.push_back ({ "metering", [] (TSAudioProcessor& processor, juce::MidiBuffer&, int)
+        {
+            processor.setMeteringEnabled (true);
+
+            TSMeterReading reading;
+
+            while (processor.popMeterReading (reading)) {}
+        } });
+
+        steps.push_back ({ "bypass", [] (TSAudioProcessor& processor, juce::MidiBuffer&, int block)
+        {
+            TSTools::setParameter (processor, "bypass", (block / 8) % 2 == 0 ? 1.0f : 0.0f);
+        } });
+
+        steps.push_back ({ "midi controllers", [] (TSAudioProcessor& processor, juce::MidiBuffer& midi, int block)
+        {
+            processor.setMidiController (TSAudioProcessor::MidiTarget::drive, 20);
+            processor.setMidiController (TSAudioProcessor::MidiTarget::bypass, 21);
+
+            for (int i = 0; i < 8; ++i)
+                midi.addEvent (juce::MidiMessage::controllerEvent (1, 20, (block * 8 + i) % 128), i * 16);
+
+            midi.addEvent (juce::MidiMessage::controllerEvent (1, 21, (block / 8) % 2 == 0 ? 127 : 0), 100);
+        } });
+
+        steps.push_back ({ "midi learn", [] (TSAudioProcessor& processor, juce::MidiBuffer& midi, int block)
+        {
+            processor.learnMidiController (TSAudioProcessor::MidiTarget (block % TSAudioProcessor::numMidiTargets));
+            midi.addEvent (juce::MidiMessage::controllerEvent (1, 30 + block % 4, 64), 10);
+        } });
+
+        // A change to any of these rebuilds the engine off the audio thread; until
+        // then processBlock carries on with the engine it has
+        for (int stages = 0; stages <= 4; ++stages)
+            steps.push_back ({ juce::String (1 << stages) + "x", [stages] (TSAudioProcessor& processor, juce::MidiBuffer&, int)
+            {
+                TSTools::setParameter (processor, "oversampling", float (stages));
+            }, true });
+
+        for (int filter = 0; filter < 2; ++filter)
+            steps.push_back ({ filter == 0 ? "iir" : "fir", [filter] (TSAudioProcessor& processor, juce::MidiBuffer&, int)
+            {
+                TSTools::setParameter (processor, "oversamplingFilter", float (filter));
+            }, true });
+
+        for (int order = 0; order <= 2; ++order)
+            steps.push_back ({ "adaa " + juce::String (order), [order] (TSAudioProcessor& processor, juce::MidiBuffer&, int)
+            {
+                TSTools::setParameter (processor, "clipperAntiAliasing", float (order));
+            }, true });
+
+        steps.push_back ({ "tile size", [] (TSAudioProcessor& processor, juce::MidiBuffer&, int)
+        {
+            processor.setTileSize (64);
+        }, true });
+
+        return steps;
+    }
+
+    // Every step at one precision. Returns the trapped count of each step.
+    template <typename SampleType>
+    juce::var runSteps (const CheckSettings& settings, juce::AudioProcessor::ProcessingPrecision precision, int& totalViolations)
+    {
+        TSAudioProcessor processor;
+        TSTools::setChannelCount (processor, settings.numChannels);
+        TSTools::prepare (processor, settings.sampleRate, settings.blockSize, false, precision);
+
+        // Blocks up to twice the prepared size: the engine runs in tiles of its own
+        const auto largestBlock = settings.blockSize * 2;
+        juce::AudioBuffer<SampleType> block (settings.numChannels, largestBlock);
+        juce::MidiBuffer midi;
+        midi.ensureSize (4096);
+        juce::Random random (11);
+
+        auto* results = new juce::DynamicObject();
+
+        for (auto& step : makeSteps())
+        {
+            const auto before = AllocationTrap::getNumViolations();
+
+            for (int i = 0; i < settings.blocksPerStep; ++i)
+            {
+                midi.clear();
+                step.beforeBlock (processor, midi, i);
+
+                const auto numSamples = i % 4 == 3 ? 1 + random.nextInt (largestBlock) : settings.blockSize;
+
+                for (int channel = 0; channel < settings.numChannels; ++channel)
+                    for (int n = 0; n < numSamples; ++n)
+                        block.setSample (channel, n, SampleType (0.5 * std::sin (0.05 * double (i * numSamples + n) + channel)));
+
+                juce::AudioBuffer<SampleType> view (block.getArrayOfWritePointers(), settings.numChannels, numSamples);
+                processor.processBlock (view, midi);
+
+                // Halfway, the host prepares again as it would once the latency changed
+                if (step.preparesAgain && i == settings.blocksPerStep / 2)
+                    TSTools::prepare (processor, settings.sampleRate, settings.blockSize, false, precision);
+            }
+
+            const auto trapped = AllocationTrap::getNumViolations() - before;
+            results->setProperty (step.name, trapped);
+            totalViolations += trapped;
+
+            if (trapped > 0)
+                std::cerr << "allocations: " << trapped << " in step \"" << step.name << "\"" << std::endl;
+        }
+
+        processor.releaseResources();
+        return results;
+    }
+}
+
+void runAllocationCheck (const juce::ArgumentList& args)
+{
+    if (! AllocationTrap::isEnabled())
+        juce::ConsoleApplication::fail ("built without TS_TRAP_RT_ALLOCATIONS, use the Debug configuration");
+
+    CheckSettings settings;
+    settings.sampleRate = double (Bench::getInt (args, "--rate", 48000));
+    settings.blockSize = Bench::getInt (args, "--block", 256);
+    settings.numChannels = Bench::getInt (args, "--channels", 2);
+    settings.blocksPerStep = Bench::getInt (args, "--blocks", 64, 2);
+
+    int totalViolations = 0;
+
+    auto* results = new juce::DynamicObject();
+    results->setProperty ("blocksPerStep", settings.blocksPerStep);
+    results->setProperty ("float", runSteps<float> (settings, juce::AudioProcessor::singlePrecision, totalViolations));
+    results->setProperty ("double", runSteps<double> (settings, juce::AudioProcessor::doublePrecision, totalViolations));
+    results->setProperty ("violations", totalViolations);
+
+    Bench::writeReport (args, "allocations", results);
+
+    if (totalViolations > 0)
+        juce::ConsoleApplication::fail (juce::String (totalViolations) + " heap allocations or releases inside processBlock");
+}
@@ -0,0 +1,185 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtilities.h"
+#include "../../Common/TSToolHelpers.h"
+
+namespace
+{
+    // Keeps the optimiser from discarding the designs being timed
+    volatile float sink = 0.0f;
+
+    // The cost of one redesign: the closed form filter designs, from runtime
+    // component values and from a compile time circuit, against the
+    // precomputed tables the processor interpolates while a parameter moves
+    juce::var measureCoefficientDesign (double sampleRate, int overSamplingFactor)
+    {
+        const int numCalls = 1 << 20;
+        const DriveStageValues driveCircuit;
+        const ToneStageValues toneCircuit;
+        const auto overSampledRate = sampleRate * overSamplingFactor;
+
+        auto valueFor = [] (int i) { return float (i & 1023) / 1023.0f; };
+
+        const auto driveDesign = Bench::bestNanoseconds (1, [&]
+        {
+            for (int i = 0; i < numCalls; ++i)
+                sink = sink + float (designDriveFilter (driveCircuit, valueFor (i), overSampledRate).b1);
+        }) / numCalls;
+
+        const auto toneDesign = Bench::bestNanoseconds (1, [&]
+        {
+            for (int i = 0; i < numCalls; ++i)
+                sink = sink + float (designToneFilter (toneCircuit, valueFor (i), sampleRate).b1);
+        }) / numCalls;
+
+        const auto driveDesignFolded = Bench::bestNanoseconds (1, [&]
+        {
+            for (int i = 0; i < numCalls; ++i)
+                sink = sink + float (designDriveFilter<CustomCircuit> (valueFor (i), overSampledRate).b1);
+        }) / numCalls;
+
+        const auto toneDesignFolded = Bench::bestNanoseconds (1, [&]
+        {
+            for (int i = 0; i < numCalls; ++i)
+                sink = sink + float (designToneFilter<CustomCircuit> (valueFor (i), sampleRate).b1);
+        }) / numCalls;
+
+        CoefficientTable driveTable, toneTable;
+
+        const auto buildNs = Bench::bestNanoseconds (1, [&]
+        {
+            driveTable.build (0.0f, 1.0f, 0.001f, [&] (double drive) { return designDriveFilter (driveCircuit, drive, overSampledRate); });
+        });
+
+        toneTable.build (0.0f, 1.0f, 0.001f, [&] (double tone) { return designToneFilter (toneCircuit, tone, sampleRate); });
+
+        const auto driveInterpolate = Bench::bestNanoseconds (1, [&]
+        {
+            for (int i = 0; i < numCalls; ++i)
+                sink = sink + float (driveTable.interpolate (valueFor (i)).b1);
+        }) / numCalls;
+
+        const auto toneInterpolate = Bench::bestNanoseconds (1, [&]
+        {
+            for (int i = 0; i < numCalls; ++i)
+                sink = sink + float (toneTable.interpolate (valueFor (i)).b1);
+        }) / numCalls;
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("sampleRate", sampleRate);
+        result->setProperty ("oversampling", overSamplingFactor);
+        result->setProperty ("driveDesignNs", driveDesign);
+        result->setProperty ("toneDesignNs", toneDesign);
+        result->setProperty ("driveDesignFoldedNs", driveDesignFolded);
+        result->setProperty ("toneDesignFoldedNs", toneDesignFolded);
+        result->setProperty ("driveTableInterpolateNs", driveInterpolate);
+        result->setProperty ("toneTableInterpolateNs", toneInterpolate);
+        result->setProperty ("driveTableBuildMs", buildNs * 1.0e-6);
+        return result;
+    }
+
+    // processBlock with drive and tone swept by an LFO, a new host value every
+    // callback, so the smoothers never settle and the filters are redesigned
+    // every updateInterval samples throughout. updateInterval 0 leaves the
+    // parameters still, as the baseline.
+    juce::var measureAutomatedProcessing (double sampleRate, int blockSize, int overSamplingFactor,
+                                          int updateInterval, double seconds)
+    {
+        const int numChannels = 2;
+
+        TSAudioProcessor processor;
+        TSTools::setChannelCount (processor, numChannels);
+        TSTools::setParameter (processor, "oversampling", float (TSTools::getOversamplingIndex (overSamplingFactor)));
+        TSTools::setParameter (processor, "drive", 0.5f);
+        TSTools::setParameter (processor, "tone", 0.5f);
+        TSTools::prepare (processor, sampleRate, blockSize, false);
+
+        if (updateInterval > 0)
+            processor.setCoefficientUpdateInterval (updateInterval);
+
+        juce::AudioBuffer<float> source (numChannels, int (sampleRate) + blockSize);
+        Bench::fillTestSignal (source, sampleRate);
+
+        juce::AudioBuffer<float> block (numChannels, blockSize);
+        juce::MidiBuffer midi;
+
+        const auto numBlocks = juce::jmax (200, int (seconds * sampleRate / blockSize));
+        const auto lfoIncrement = juce::MathConstants<double>::twoPi * 2.0 * blockSize / sampleRate;
+
+        std::vector<double> callbackMicroseconds;
+        callbackMicroseconds.reserve (size_t (numBlocks));
+        juce::int64 totalTicks = 0;
+
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            const auto start = (i * blockSize) % (source.getNumSamples() - blockSize);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                block.copyFrom (channel, 0, source, channel, start, blockSize);
+
+            if (updateInterval > 0)
+            {
+                const auto lfo = float (0.5 + 0.45 * std::sin (lfoIncrement * i));
+                TSTools::setParameter (processor, "drive", lfo);
+                TSTools::setParameter (processor, "tone", 1.0f - lfo);
+            }
+
+            const auto startTicks = juce::Time::getHighResolutionTicks();
+            processor.processBlock (block, midi);
+            const auto ticks = juce::Time::getHighResolutionTicks() - startTicks;
+
+            totalTicks += ticks;
+            callbackMicroseconds.push_back (Bench::ticksToNanoseconds (ticks) * 1.0e-3);
+        }
+
+        processor.releaseResources();
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("updateInterval", updateInterval > 0 ? juce::var (updateInterval) : juce::var ("static"));
+        result->setProperty ("nsPerSample", Bench::ticksToNanoseconds (totalTicks) / (double (numBlocks) * blockSize * numChannels));
+        result->setProperty ("callbackMicroseconds", Bench::summarise (std::move (callbackMicroseconds)));
+        return result;
+    }
+}
+
+void runAutomationBenchmark (const juce::ArgumentList& args)
+{
+    const auto sampleRate = double (Bench::getInt (args, "--rate", 48000));
+    const auto blockSize = Bench::getInt (args, "--block", 256);
+    const auto factors = Bench::getOversamplingFactors (args, { 1, 2, 4, 8, 16 });
+    const auto intervals = Bench::getIntList (args, "--intervals", { 1, 4, 16, 32, 64, 256 });
+    const auto seconds = Bench::getSeconds (args, 2.0);
+
+    juce::Array<juce::var> design, processing;
+
+    for (auto factor : factors)
+    {
+        std::cerr << "automation: " << factor << "x" << std::endl;
+
+        design.add (measureCoefficientDesign (sampleRate, factor));
+
+        auto* entry = new juce::DynamicObject();
+        entry->setProperty ("oversampling", factor);
+
+        const auto baseline = measureAutomatedProcessing (sampleRate, blockSize, factor, 0, seconds);
+        const double baselineNs = baseline["nsPerSample"];
+        juce::Array<juce::var> runs { baseline };
+
+        for (auto interval : intervals)
+        {
+            auto run = measureAutomatedProcessing (sampleRate, blockSize, factor, juce::jmax (1, interval), seconds);
+            run.getDynamicObject()->setProperty ("overheadVsStatic", double (run["nsPerSample"]) / baselineNs - 1.0);
+            runs.add (run);
+        }
+
+        entry->setProperty ("runs", runs);
+        processing.add (entry);
+    }
+
+    auto* results = new juce::DynamicObject();
+    results->setProperty ("sampleRate", sampleRate);
+    results->setProperty ("blockSize", blockSize);
+    results->setProperty ("coefficientDesign", design);
+    results->setProperty ("automatedProcessing", processing);
+
+    Bench::writeReport (args, "automation", results);
+}
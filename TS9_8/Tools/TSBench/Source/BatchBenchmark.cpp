@@ -0,0 +1,143 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtilities.h"
+#include "../../Common/TSToolHelpers.h"
+
+namespace
+{
+    struct BatchSettings
+    {
+        TSEngineSettings engine;
+        size_t blockSize = 256;
+        double seconds = 1.0;
+    };
+
+    // Every stream gets its own parameters and its own channel of the test signal
+    TSEngine<float>::StreamParameters getStreamParameters (size_t stream)
+    {
+        const auto position = float (stream % 17) / 16.0f;
+        return { 0.2f + 0.6f * position, 0.9f - 0.5f * position, 0.5f };
+    }
+
+    template <typename Function>
+    double nanosecondsPerStreamSample (const BatchSettings& settings, size_t numStreams, Function&& processBlock)
+    {
+        const auto blockSize = settings.blockSize;
+        const auto numBlocks = juce::jmax (50, int (settings.seconds * settings.engine.sampleRate / double (blockSize)));
+
+        for (int i = 0; i < numBlocks / 10; ++i)
+            processBlock();
+
+        const auto nanoseconds = Bench::bestNanoseconds (1, [&]
+        {
+            for (int i = 0; i < numBlocks; ++i)
+                processBlock();
+        });
+
+        return nanoseconds / (double (numBlocks) * double (blockSize) * double (numStreams));
+    }
+
+    // One engine carrying every stream, against one engine per stream: what the
+    // struct of arrays layout buys over running the single stream path N times
+    juce::var measureBatch (const BatchSettings& settings, size_t numStreams)
+    {
+        const auto blockSize = settings.blockSize;
+
+        juce::AudioBuffer<float> signal (int (numStreams), int (blockSize));
+        Bench::fillTestSignal (signal, settings.engine.sampleRate);
+        const juce::AudioBuffer<float> source (signal);
+
+        auto batchSettings = settings.engine;
+        batchSettings.numStreams = numStreams;
+
+        TSEngine<float> batch;
+        batch.prepare (batchSettings);
+
+        for (size_t stream = 0; stream < numStreams; ++stream)
+            batch.setStreamParameters (stream, getStreamParameters (stream));
+
+        batch.reset();
+
+        const auto batchNs = nanosecondsPerStreamSample (settings, numStreams, [&]
+        {
+            signal.makeCopyOf (source, true);
+            batch.process (signal.getArrayOfReadPointers(), signal.getArrayOfWritePointers(), blockSize);
+        });
+
+        batch.release();
+
+        auto singleSettings = settings.engine;
+        singleSettings.numStreams = 1;
+
+        std::vector<TSEngine<float>> separate (numStreams);
+
+        for (size_t stream = 0; stream < numStreams; ++stream)
+        {
+            separate[stream].prepare (singleSettings);
+            separate[stream].setAllStreamParameters (getStreamParameters (stream));
+            separate[stream].reset();
+        }
+
+        const auto separateNs = nanosecondsPerStreamSample (settings, numStreams, [&]
+        {
+            signal.makeCopyOf (source, true);
+
+            for (size_t stream = 0; stream < numStreams; ++stream)
+            {
+                auto* channel = signal.getWritePointer (int (stream));
+                separate[stream].process (&channel, &channel, blockSize);
+            }
+        });
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("streams", (int) numStreams);
+        result->setProperty ("batchNsPerStreamSample", batchNs);
+        result->setProperty ("separateNsPerStreamSample", separateNs);
+        result->setProperty ("batchSpeedup", separateNs / batchNs);
+
+        // How many streams one core keeps up with in real time
+        result->setProperty ("realtimeStreamsPerCore", 1.0e9 / (batchNs * settings.engine.sampleRate));
+        return result;
+    }
+}
+
+void runBatchBenchmark (const juce::ArgumentList& args)
+{
+    BatchSettings settings;
+    settings.engine.sampleRate = double (Bench::getInt (args, "--rate", 48000));
+    settings.blockSize = size_t (Bench::getInt (args, "--block", 256));
+    settings.engine.tileSize = size_t (Bench::getInt (args, "--tile", int (TSEngineSettings::defaultTileSize)));
+
+    const auto factor = Bench::getOversamplingFactors (args, { 2 })[0];
+    settings.engine.overSamplingStages = TSTools::getOversamplingIndex (factor);
+
+    if (args.containsOption ("--filter"))
+        settings.engine.overSamplingFilter = Bench::isFIRFilter (args) ? OversamplingFilter::linearPhaseFIR
+                                                                       : OversamplingFilter::polyphaseIIR;
+
+    settings.seconds = Bench::getSeconds (args, settings.seconds);
+
+    const auto streamCounts = Bench::getIntList (args, "--streams", { 1, 2, 4, 8, 16, 32, 64, 128, 256 });
+
+    for (auto numStreams : streamCounts)
+        if (numStreams < 1)
+            juce::ConsoleApplication::fail ("--streams must be positive");
+
+    juce::Array<juce::var> runs;
+
+    for (auto numStreams : streamCounts)
+    {
+        std::cerr << "batch: " << numStreams << " streams" << std::endl;
+        runs.add (measureBatch (settings, size_t (numStreams)));
+    }
+
+    auto* results = new juce::DynamicObject();
+    results->setProperty ("sampleRate", settings.engine.sampleRate);
+    results->setProperty ("blockSize", (int) settings.blockSize);
+    results->setProperty ("tileSize", (int) settings.engine.tileSize);
+    results->setProperty ("oversampling", factor);
+    results->setProperty ("filter", settings.engine.overSamplingFilter == OversamplingFilter::linearPhaseFIR ? "fir" : "iir");
+    results->setProperty ("lanesPerRegister", (int) Oversampler<float>::laneWidth);
+    results->setProperty ("runs", runs);
+
+    Bench::writeReport (args, "batch", results);
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../../Source/TSClipper.h"
+
+#if defined (__x86_64__) || defined (_M_X64)
+ #if defined (_MSC_VER) && ! defined (__clang__)
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+ #define TS_BENCH_HAS_CYCLE_COUNTER 1
+#else
+ #define TS_BENCH_HAS_CYCLE_COUNTER 0
+#endif
+
+// Timing, statistics and JSON helpers shared by the benchmarks.
+namespace Bench
+{
+    // Time stamp counter reading. On current x86 CPUs it ticks at a constant
+    // reference rate, not the core clock, so it measures "reference cycles".
+    inline juce::uint64 readCycleCounter() noexcept
+    {
+       #if TS_BENCH_HAS_CYCLE_COUNTER
+        return (juce::uint64) __rdtsc();
+       #else
+        return 0;
+       #endif
+    }
+
+    inline double ticksToNanoseconds (juce::int64 ticks) noexcept
+    {
+        return juce::Time::highResolutionTicksToSeconds (ticks) * 1.0e9;
+    }
+
+    // Wall time of one call to function in nanoseconds, the fastest of numRuns,
+    // which leaves out first touches and preemption
+    template <typename Function>
+    double bestNanoseconds (int numRuns, Function&& function)
+    {
+        auto best = std::numeric_limits<double>::max();
+
+        for (int run = 0; run < juce::jmax (1, numRuns); ++run)
+        {
+            const auto start = juce::Time::getHighResolutionTicks();
+            function();
+            best = juce::jmin (best, ticksToNanoseconds (juce::Time::getHighResolutionTicks() - start));
+        }
+
+        return best;
+    }
+
+    // Percentiles of a set of timings, as returned in the JSON reports
+    inline juce::var summarise (std::vector<double> values)
+    {
+        auto* summary = new juce::DynamicObject();
+
+        if (values.empty())
+            return summary;
+
+        std::sort (values.begin(), values.end());
+
+        auto percentile = [&values] (double p)
+        {
+            const auto index = juce::jlimit (size_t (0), values.size() - 1, size_t (p * 0.01 * double (values.size() - 1) + 0.5));
+            return values[index];
+        };
+
+        double sum = 0.0;
+
+        for (auto v : values)
+            sum += v;
+
+        summary->setProperty ("mean", sum / double (values.size()));
+        summary->setProperty ("min", values.front());
+        summary->setProperty ("p50", percentile (50.0));
+        summary->setProperty ("p90", percentile (90.0));
+        summary->setProperty ("p99", percentile (99.0));
+        summary->setProperty ("p999", percentile (99.9));
+        summary->setProperty ("max", values.back());
+
+        return summary;
+    }
+
+    // Machine and build description, so results from different runs can be compared
+    inline juce::var describeEnvironment()
+    {
+        auto* environment = new juce::DynamicObject();
+
+        environment->setProperty ("cpu", juce::SystemStats::getCpuModel());
+        environment->setProperty ("cpuMHz", juce::SystemStats::getCpuSpeedInMegahertz());
+        environment->setProperty ("numCpus", juce::SystemStats::getNumCpus());
+        environment->setProperty ("os", juce::SystemStats::getOperatingSystemName());
+        environment->setProperty ("clipper", juce::String (DiodeClipper::getName (DiodeClipper::getBestImplementation())));
+        environment->setProperty ("simdLanes", (int) juce::dsp::SIMDRegister<float>::size());
+        environment->setProperty ("cycleCounter", TS_BENCH_HAS_CYCLE_COUNTER ? "tsc" : "none");
+        environment->setProperty ("juce", juce::SystemStats::getJUCEVersion());
+        environment->setProperty ("date", juce::Time::getCurrentTime().toISO8601 (true));
+       #if JUCE_DEBUG
+        environment->setProperty ("build", "debug");
+       #elif TS_PROFILE_STAGES
+        // Timings include the stage markers
+        environment->setProperty ("build", "profile");
+       #else
+        environment->setProperty ("build", "release");
+       #endif
+
+        return environment;
+    }
+
+    // Writes the report to --output=<file>, or stdout without it
+    inline void writeReport (const juce::ArgumentList& args, const juce::String& benchmarkName, const juce::var& results)
+    {
+        auto* report = new juce::DynamicObject();
+        report->setProperty ("benchmark", benchmarkName);
+        report->setProperty ("environment", describeEnvironment());
+        report->setProperty ("results", results);
+
+        const auto json = juce::JSON::toString (juce::var (report), false);
+
+        if (args.containsOption ("--output"))
+        {
+            const auto file = args.getFileForOption ("--output");
+
+            if (! file.replaceWithText (json + "\n"))
+                juce::ConsoleApplication::fail ("cannot write " + file.getFullPathName());
+
+            std::cerr << "wrote " << file.getFullPathName() << std::endl;
+        }
+        else
+        {
+            std::cout << json << std::endl;
+        }
+    }
+
+    // Comma separated integers from an option, or the defaults without it
+    inline juce::Array<int> getIntList (const juce::ArgumentList& args, const juce::String& option, juce::Array<int> defaults)
+    {
+        if (! args.containsOption (option))
+            return defaults;
+
+        juce::Array<int> values;
+
+        for (auto& token : juce::StringArray::fromTokens (args.getValueForOption (option), ",", {}))
+            if (token.trim().isNotEmpty())
+                values.add (token.trim().getIntValue());
+
+        if (values.isEmpty())
+            juce::ConsoleApplication::fail (option + " needs a comma separated list");
+
+        return values;
+    }
+
+    // A single integer option, no lower than minimum
+    inline int getInt (const juce::ArgumentList& args, const juce::String& option, int defaultValue, int minimum = 1)
+    {
+        return juce::jmax (minimum, getIntList (args, option, { defaultValue })[0]);
+    }
+
+    // --seconds of signal per measurement, at least a tenth of one
+    inline double getSeconds (const juce::ArgumentList& args, double defaultValue)
+    {
+        return args.containsOption ("--seconds") ? juce::jmax (0.1, args.getValueForOption ("--seconds").getDoubleValue())
+                                                 : defaultValue;
+    }
+
+    // --oversampling factors, failing on any the processor doesn't offer
+    inline juce::Array<int> getOversamplingFactors (const juce::ArgumentList& args, juce::Array<int> defaults)
+    {
+        const auto factors = getIntList (args, "--oversampling", defaults);
+
+        for (auto factor : factors)
+            if (factor < 1 || factor > 16 || ! juce::isPowerOfTwo (factor))
+                juce::ConsoleApplication::fail ("--oversampling factors must be 1, 2, 4, 8 or 16");
+
+        return factors;
+    }
+
+    // --filter=fir picks the linear phase oversampling filters, anything else the IIR ones
+    inline bool isFIRFilter (const juce::ArgumentList& args)
+    {
+        return args.getValueForOption ("--filter").equalsIgnoreCase ("fir");
+    }
+
+    // A guitar-like test signal: decaying plucked harmonics with a little noise,
+    // peaking around -6 dBFS, different in every channel
+    inline void fillTestSignal (juce::AudioBuffer<float>& buffer, double sampleRate)
+    {
+        juce::Random random (42);
+
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            auto* data = buffer.getWritePointer (channel);
+            const auto fundamental = 82.41 * std::pow (2.0, channel / 12.0);
+
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+            {
+                const auto t = double (i % int (sampleRate)) / sampleRate;
+                const auto envelope = std::exp (-3.0 * t);
+                double sample = 0.0;
+
+                for (int harmonic = 1; harmonic <= 6; ++harmonic)
+                    sample += std::sin (juce::MathConstants<double>::twoPi * fundamental * harmonic * t) / harmonic;
+
+                data[i] = float (0.3 * envelope * sample) + 1.0e-3f * (random.nextFloat() - 0.5f);
+            }
+        }
+    }
+}
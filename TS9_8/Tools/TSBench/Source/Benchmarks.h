@@ -0,0 +1,43 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Each benchmark reads its options from the command line and reports through
+// juce::ConsoleApplication::fail() when it cannot run.
+
+// Diode clipper kernels against the reference std::asinh loop: samples/second and worst case deviation
+void runClipperBenchmark (const juce::ArgumentList& args);
+
+// processBlock swept over block size, sample rate, oversampling and channel count: ns/sample,
+// callback time percentiles and the cost of each stage timed on its own, as JSON
+void runProcessorBenchmark (const juce::ArgumentList& args);
+
+// Filter redesign cost (closed form vs. table) and processBlock under continuous drive/tone automation, as JSON
+void runAutomationBenchmark (const juce::ArgumentList& args);
+
+// processBlock in float against double at each oversampling factor: ns/sample and output difference, as JSON
+void runPrecisionBenchmark (const juce::ArgumentList& args);
+
+// Wave digital drive stage against the drive filter + clipper path: ns per channel sample
+void runDriveStageBenchmark (const juce::ArgumentList& args);
+
+// TSEngine with N streams in one batch against N single stream engines: ns per stream sample, as JSON
+void runBatchBenchmark (const juce::ArgumentList& args);
+
+// processBlock at each internal tile size, fed fixed and irregular host block sizes: ns per channel sample, as JSON
+void runTileBenchmark (const juce::ArgumentList& args);
+
+// getStateInformation / setStateInformation over many instances, binary against the earlier XML format, as JSON
+void runStateBenchmark (const juce::ArgumentList& args);
+
+// Aliasing, THD, noise floor and deviation from a double precision 16x reference for each oversampling
+// factor, filter and precision, from FFTs of sine and multi tone signals, against the CPU cost, as JSON
+void runQualityBenchmark (const juce::ArgumentList& args);
+
+// Many processors in lock step across a pool of worker threads, like a host graph: cycle time percentiles
+// against the block deadline, scaling per thread and resident memory per instance, as JSON
+void runStressBenchmark (const juce::ArgumentList& args);
+
+// processBlock through every setting under the allocation trap (see TSAllocationTrap.h): heap activity per
+// step, as JSON. Fails if there was any.
+void runAllocationCheck (const juce::ArgumentList& args);
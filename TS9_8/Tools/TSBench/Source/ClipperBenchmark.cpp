@@ -0,0 +1,108 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtilities.h"
+#include "../../../Source/TSClipper.h"
+#include "../../../Source/TSCircuit.h"
+
+namespace
+{
+    // Drive filter output spans everything from near silence to several volts at
+    // full drive; sweep a sine over that range on a log scale.
+    std::vector<float> makeClipperInput (size_t numSamples)
+    {
+        std::vector<float> signal (numSamples);
+        juce::Random random (1234);
+
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            const auto position = double (i) / double (numSamples);
+            const auto amplitude = std::pow (10.0, -4.0 + 4.6 * position);
+            const auto phase = juce::MathConstants<double>::twoPi * 441.0 * double (i) / 44100.0;
+
+            signal[i] = float (amplitude * std::sin (phase)) + 1.0e-5f * (random.nextFloat() - 0.5f);
+        }
+
+        return signal;
+    }
+
+    struct KernelResult
+    {
+        double samplesPerSecond = 0.0;
+        float maxDeviation = 0.0f;
+    };
+
+    KernelResult measureKernel (DiodeClipper::Kernel kernel, const std::vector<float>& input,
+                                const std::vector<float>& referenceOutput, float R2, int numRuns)
+    {
+        std::vector<float> output (input.size());
+        KernelResult result;
+
+        const auto bestNanoseconds = Bench::bestNanoseconds (numRuns, [&]
+        {
+            kernel (input.data(), output.data(), input.size(), R2);
+        });
+
+        for (size_t i = 0; i < input.size(); ++i)
+            result.maxDeviation = juce::jmax (result.maxDeviation, std::abs (output[i] - referenceOutput[i]));
+
+        result.samplesPerSecond = double (input.size()) * 1.0e9 / bestNanoseconds;
+        return result;
+    }
+}
+
+void runClipperBenchmark (const juce::ArgumentList& args)
+{
+    auto samplesToUse = size_t (1 << 22);
+
+    if (args.containsOption ("--samples"))
+        samplesToUse = (size_t) juce::jmax (1024, args.getValueForOption ("--samples").getIntValue());
+
+    const int numRuns = 5;
+
+    const auto input = makeClipperInput (samplesToUse);
+    const DriveStageValues circuit;
+
+    const DiodeClipper::Implementation implementations[] = { DiodeClipper::Implementation::reference,
+                                                             DiodeClipper::Implementation::scalar,
+                                                             DiodeClipper::Implementation::sse2,
+                                                             DiodeClipper::Implementation::avx2,
+                                                             DiodeClipper::Implementation::tableScalar,
+                                                             DiodeClipper::Implementation::tableSse2,
+                                                             DiodeClipper::Implementation::tableAvx2 };
+
+    std::cout << "Diode clipper, " << samplesToUse << " samples, best of " << numRuns << " runs" << std::endl
+              << "best available kernel: " << DiodeClipper::getName (DiodeClipper::getBestImplementation()) << std::endl
+              << std::endl;
+
+    for (auto drive : { 0.0f, 0.5f, 1.0f })
+    {
+        const auto R2 = circuit.Rf + drive * circuit.Rpot;
+
+        std::vector<float> referenceOutput (input.size(), 0.0f);
+        DiodeClipper::processReference (input.data(), referenceOutput.data(), input.size(), R2);
+
+        const auto reference = measureKernel (DiodeClipper::processReference, input, referenceOutput, R2, numRuns);
+
+        std::cout << "drive " << juce::String (drive, 1) << std::endl;
+
+        for (auto implementation : implementations)
+        {
+            auto kernel = DiodeClipper::getKernel (implementation);
+
+            if (kernel == nullptr)
+            {
+                std::cout << "  " << juce::String (DiodeClipper::getName (implementation)).paddedRight (' ', 12)
+                          << "not supported" << std::endl;
+                continue;
+            }
+
+            const auto result = measureKernel (kernel, input, referenceOutput, R2, numRuns);
+
+            std::cout << "  " << juce::String (DiodeClipper::getName (implementation)).paddedRight (' ', 12)
+                      << juce::String (result.samplesPerSecond * 1.0e-6, 1).paddedLeft (' ', 8) << " Msamples/s"
+                      << juce::String (result.samplesPerSecond / reference.samplesPerSecond, 2).paddedLeft (' ', 8) << "x"
+                      << "   max |deviation| " << juce::String (result.maxDeviation, 9) << " V" << std::endl;
+        }
+
+        std::cout << std::endl;
+    }
+}
@@ -0,0 +1,122 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtilities.h"
+#include "../../../Source/TSBiquad.h"
+#include "../../../Source/TSOversampler.h"
+#include "../../../Source/TSWaveDigital.h"
+
+namespace
+{
+    // A second of input at the oversampled rate, swept from quiet to hard clipping
+    std::vector<float> makeDriveInput (double sampleRate)
+    {
+        const auto length = size_t (sampleRate);
+        std::vector<float> signal (length);
+
+        for (size_t i = 0; i < signal.size(); ++i)
+        {
+            const auto position = double (i) / double (signal.size());
+            const auto amplitude = std::pow (10.0, -2.0 + 2.3 * position);
+            signal[i] = float (amplitude * std::sin (juce::MathConstants<double>::twoPi * 220.0 * double (i) / sampleRate));
+        }
+
+        return signal;
+    }
+
+    // Interleaved frames of one register of lanes, every lane carrying the input
+    template <typename SampleType>
+    std::vector<SampleType> makeFrames (const std::vector<float>& input, size_t numLanes)
+    {
+        std::vector<SampleType> frames (input.size() * numLanes);
+
+        for (size_t i = 0; i < input.size(); ++i)
+            for (size_t lane = 0; lane < numLanes; ++lane)
+                frames[i * numLanes + lane] = SampleType (input[i]);
+
+        return frames;
+    }
+
+    // The engine's default path for one register of lanes: drive biquad then clipper
+    template <typename SampleType>
+    double measureFilterAndClipper (const std::vector<float>& input, double sampleRate, float drive, int numRuns)
+    {
+        const DriveStageValues circuit;
+        const auto numLanes = Oversampler<SampleType>::laneWidth;
+        const auto R2 = circuit.Rf + drive * circuit.Rpot;
+
+        BiquadBank<SampleType> filter;
+        filter.prepare (numLanes);
+
+        for (size_t lane = 0; lane < numLanes; ++lane)
+            filter.setCoefficients (lane, designDriveFilter (circuit, drive, sampleRate));
+
+        auto signal = makeFrames<SampleType> (input, numLanes);
+        std::vector<SampleType> driven (signal.size());
+
+        DiodeClipper::LaneParameters clipperLanes;
+        clipperLanes.resize (numLanes, R2);
+        const auto clipper = DiodeClipper::getFrameKernel (DiodeClipper::getBestImplementation());
+
+        std::vector<double> inverseK (numLanes, 1.0 / (2.0 * double (DiodeClipper::Is) * double (R2)));
+
+        // Every lane carries a channel, so the time is shared between that many channels
+        return Bench::bestNanoseconds (numRuns, [&]
+        {
+            filter.process (signal.data(), driven.data(), input.size());
+
+            if constexpr (std::is_same<SampleType, float>::value)
+                clipper (driven.data(), signal.data(), input.size(), numLanes, clipperLanes);
+            else
+                DiodeClipper::processDoubleFrames (driven.data(), signal.data(), input.size(), numLanes, inverseK.data());
+        }) / double (input.size() * numLanes);
+    }
+
+    // The same register of lanes through the wave digital stage, as the engine runs it
+    template <typename SampleType, int NewtonIterations>
+    double measureWaveDigital (const std::vector<float>& input, double sampleRate, float drive, int numRuns)
+    {
+        using Stage = WaveDigital::DriveStage<WaveDigital::Lanes<SampleType, Oversampler<SampleType>::laneWidth>, NewtonIterations>;
+
+        Stage stage;
+        stage.prepare (DriveStageValues(), sampleRate);
+        stage.setDrive (SampleType (drive));
+
+        auto frames = makeFrames<SampleType> (input, Stage::width);
+
+        return Bench::bestNanoseconds (numRuns, [&]
+        {
+            stage.processFrames (frames.data(), input.size(), Stage::width);
+        }) / double (input.size() * Stage::width);
+    }
+}
+
+void runDriveStageBenchmark (const juce::ArgumentList& args)
+{
+    const auto sampleRate = double (Bench::getInt (args, "--rate", 88200));
+    const int numRuns = 5;
+    const auto input = makeDriveInput (sampleRate);
+
+    std::cout << "Drive stage per channel sample at " << sampleRate << " Hz, best of " << numRuns << " runs" << std::endl
+              << std::endl;
+
+    for (auto drive : { 0.0f, 0.5f, 1.0f })
+    {
+        // Each model against filter + clipper at the same precision
+        auto report = [] (const char* name, double nanoseconds, double reference)
+        {
+            std::cout << "  " << juce::String (name).paddedRight (' ', 24)
+                      << juce::String (nanoseconds, 2).paddedLeft (' ', 8) << " ns"
+                      << juce::String (nanoseconds / reference, 2).paddedLeft (' ', 8) << "x" << std::endl;
+        };
+
+        const auto floatReference = measureFilterAndClipper<float> (input, sampleRate, drive, numRuns);
+        const auto doubleReference = measureFilterAndClipper<double> (input, sampleRate, drive, numRuns);
+
+        std::cout << "drive " << juce::String (drive, 1) << std::endl;
+        report ("filter + clipper", floatReference, floatReference);
+        report ("wave digital, 1 step", measureWaveDigital<float, 1> (input, sampleRate, drive, numRuns), floatReference);
+        report ("wave digital, 2 steps", measureWaveDigital<float, 2> (input, sampleRate, drive, numRuns), floatReference);
+        report ("double filter + clipper", doubleReference, doubleReference);
+        report ("double wave digital, 3", measureWaveDigital<double, 3> (input, sampleRate, drive, numRuns), doubleReference);
+        std::cout << std::endl;
+    }
+}
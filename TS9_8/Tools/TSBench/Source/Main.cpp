@@ -0,0 +1,125 @@
+#include <JuceHeader.h>
+#include "Benchmarks.h"
+
+// Headless benchmarks for the TubeSchemer DSP. Numbers are only meaningful
+// from the Release configuration.
+
+int main (int argc, char* argv[])
+{
+    // The processor's parameter state expects a message manager to exist
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ConsoleApplication app;
+    app.addHelpCommand ("--help|-h", "Usage:", true);
+
+    app.addCommand ({ "clipper",
+                      "clipper [--samples=N]",
+                      "Compares the diode clipper kernels against the reference loop",
+                      "Runs every clipper kernel the CPU supports over the same signal at several drive settings\n"
+                      "and reports samples/second and the worst case deviation from the std::asinh loop.",
+                      runClipperBenchmark });
+
+    app.addCommand ({ "processor",
+                      "processor [--blocks=16,32,..] [--rates=44100,..] [--oversampling=1,2,..] [--channels=1,2,..]\n"
+                      "    [--full] [--filter=iir|fir] [--seconds=N] [--profile=<file.json>] [--output=<file.json>]",
+                      "Times processBlock and each DSP stage over a sweep of configurations",
+                      "Sweeps block size, sample rate, oversampling factor and channel count one at a time around\n"
+                      "48 kHz / 512 samples / 2x / stereo (or all combinations with --full). Reports ns per channel\n"
+                      "sample, callback time percentiles against the buffer deadline, and ns and TSC cycles per sample\n"
+                      "for the upsampler, drive filter, clipper, downsampler and tone filter, each timed on its own.\n"
+                      "Writes JSON to stdout or --output, so runs can be compared between releases.\n"
+                      "From the Profile configuration, --profile also writes the engine's own stage profile of the\n"
+                      "measured blocks (see TSAudioProcessor::writeStageProfileReport), one file per configuration\n"
+                      "named after it when there are several.",
+                      runProcessorBenchmark });
+
+    app.addCommand ({ "automation",
+                      "automation [--rate=N] [--block=N] [--oversampling=1,2,..] [--intervals=1,4,..] [--seconds=N]\n"
+                      "    [--output=<file.json>]",
+                      "Measures coefficient recomputation under continuous automation",
+                      "Times the drive and tone filter designs against the coefficient table lookups, then runs\n"
+                      "processBlock with drive and tone moved every callback at each coefficient update interval\n"
+                      "and reports the overhead against static parameters, as JSON.",
+                      runAutomationBenchmark });
+
+    app.addCommand ({ "precision",
+                      "precision [--rate=N] [--block=N] [--channels=N] [--oversampling=1,2,..] [--filter=iir|fir]\n"
+                      "    [--seconds=N] [--output=<file.json>]",
+                      "Compares single and double precision processing at each oversampling factor",
+                      "Runs a float and a double processor side by side over the same input and reports ns per\n"
+                      "channel sample for each, the double/float cost ratio and the largest difference between\n"
+                      "their outputs, as JSON.",
+                      runPrecisionBenchmark });
+
+    app.addCommand ({ "drive",
+                      "drive [--rate=N]",
+                      "Compares the wave digital drive stage against the filter + clipper path",
+                      "Runs one register of lanes through the wave digital drive stage with one and two Newton\n"
+                      "steps, and in double precision, over a sine swept into hard clipping at the oversampled\n"
+                      "--rate (88200 by default), and reports ns per channel sample against the drive filter and\n"
+                      "clipper at the same precision.",
+                      runDriveStageBenchmark });
+
+    app.addCommand ({ "batch",
+                      "batch [--streams=1,2,..] [--rate=N] [--block=N] [--tile=N] [--oversampling=N] [--filter=iir|fir]\n"
+                      "    [--seconds=N] [--output=<file.json>]",
+                      "Measures the multi-stream engine against one engine per stream",
+                      "Runs TSEngine over each stream count, every stream with its own drive and tone, once as a\n"
+                      "single batch and once as separate single stream engines, and reports ns per stream sample\n"
+                      "for both and how many streams one core keeps up with in real time, as JSON.",
+                      runBatchBenchmark });
+
+    app.addCommand ({ "tiles",
+                      "tiles [--tiles=16,32,..] [--blocks=64,512,..] [--rate=N] [--channels=N] [--oversampling=N]\n"
+                      "    [--unfused] [--seconds=N] [--output=<file.json>]",
+                      "Measures the engine's internal tile size against host block sizes",
+                      "Runs processBlock with the engine at each tile size, fed host blocks of each --blocks size\n"
+                      "(0 for irregular blocks of 1 to 4096 samples), and reports ns per channel sample, as JSON,\n"
+                      "to pick the tile size that suits a CPU. --unfused also measures each tile stage by stage.",
+                      runTileBenchmark });
+
+    app.addCommand ({ "state",
+                      "state [--instances=N] [--runs=N] [--output=<file.json>]",
+                      "Times saving and restoring the plugin state across a session's worth of instances",
+                      "Creates --instances processors (500 by default), each with its own parameters, and times\n"
+                      "getStateInformation and setStateInformation over all of them in the binary format and in\n"
+                      "the earlier XML one, best of --runs. Reports milliseconds, microseconds and bytes per\n"
+                      "instance for each, as JSON. Then loads every instance's state in both formats into another\n"
+                      "processor, and a binary state cut short, and fails unless each restores what was saved.",
+                      runStateBenchmark });
+
+    app.addCommand ({ "quality",
+                      "quality [--oversampling=1,2,..] [--filter=iir|fir] [--rate=N] [--tones=N] [--drive=N]\n"
+                      "    [--drive-model=filter|wdf] [--max-aliasing=dB] [--max-deviation=dB] [--output=<file.json>]",
+                      "Measures aliasing and accuracy against the CPU cost of each quality setting",
+                      "Runs a stepped sine sweep and a multi tone through the processor at each oversampling factor\n"
+                      "and filter, in float, float with the clipper table, double and float with first and second\n"
+                      "order antiderivative anti-aliasing. From FFTs of the outputs it reports aliasing, THD and\n"
+                      "noise floor against the fundamental, the spectrum's deviation from a double precision 16x\n"
+                      "linear phase reference and ns per channel sample, and picks the cheapest configuration\n"
+                      "within --max-aliasing and --max-deviation (both -40 dB by default).",
+                      runQualityBenchmark });
+
+    app.addCommand ({ "stress",
+                      "stress [--instances=N] [--threads=1,2,..] [--rate=N] [--block=N] [--channels=N] [--oversampling=N]\n"
+                      "    [--seconds=N] [--output=<file.json>]",
+                      "Runs many plugin instances in lock step across a worker pool",
+                      "Prepares --instances processors (256 by default), each with its own drive and tone, and for each\n"
+                      "--threads count (1, 2, 4, .. up to every core by default) has the workers process a share of\n"
+                      "them per block and wait for each other, as a host graph does. Reports the cycle time\n"
+                      "percentiles and missed deadlines, ns per instance sample, how many instances run in real time,\n"
+                      "scaling efficiency per thread and resident memory per instance, as JSON.",
+                      runStressBenchmark });
+
+    app.addCommand ({ "allocations",
+                      "allocations [--rate=N] [--block=N] [--channels=N] [--blocks=N] [--output=<file.json>]",
+                      "Checks that processBlock never allocates, across every setting",
+                      "Needs the Debug configuration, built with TS_TRAP_RT_ALLOCATIONS=1. Runs processBlock in\n"
+                      "float and double through parameter automation, circuit, drive model, bypass and MIDI changes\n"
+                      "and every oversampling and anti-aliasing setting, --blocks blocks of fixed and irregular size\n"
+                      "for each, under the allocation trap. Reports what each step trapped, as JSON, and fails if\n"
+                      "any heap allocation or release happened inside processBlock.",
+                      runAllocationCheck });
+
+    return app.findAndRunCommand (argc, argv);
+}
@@ -0,0 +1,123 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtilities.h"
+#include "../../Common/TSToolHelpers.h"
+
+namespace
+{
+    struct PrecisionSettings
+    {
+        double sampleRate = 48000.0;
+        int blockSize = 512;
+        int numChannels = 2;
+        bool useFIR = false;
+        double seconds = 2.0;
+    };
+
+    void prepareProcessor (TSAudioProcessor& processor, const PrecisionSettings& settings, int overSamplingFactor,
+                           juce::AudioProcessor::ProcessingPrecision precision)
+    {
+        TSTools::setChannelCount (processor, settings.numChannels);
+        TSTools::setParameter (processor, "oversampling", float (TSTools::getOversamplingIndex (overSamplingFactor)));
+        TSTools::setParameter (processor, "oversamplingFilter", settings.useFIR ? 1.0f : 0.0f);
+        TSTools::setParameter (processor, "drive", 0.7f);
+        TSTools::setParameter (processor, "tone", 0.6f);
+        TSTools::prepare (processor, settings.sampleRate, settings.blockSize, false, precision);
+    }
+
+    // The same input through a float and a double processor, block by block, so
+    // both see the same cache and clock conditions. Besides the cost of each, the
+    // largest difference between their outputs shows what double buys.
+    juce::var measurePrecision (const PrecisionSettings& settings, int overSamplingFactor)
+    {
+        TSAudioProcessor floatProcessor, doubleProcessor;
+        prepareProcessor (floatProcessor, settings, overSamplingFactor, juce::AudioProcessor::singlePrecision);
+        prepareProcessor (doubleProcessor, settings, overSamplingFactor, juce::AudioProcessor::doublePrecision);
+
+        juce::AudioBuffer<float> source (settings.numChannels, int (settings.sampleRate) + settings.blockSize);
+        Bench::fillTestSignal (source, settings.sampleRate);
+
+        juce::AudioBuffer<float> floatBlock (settings.numChannels, settings.blockSize);
+        juce::AudioBuffer<double> doubleBlock (settings.numChannels, settings.blockSize);
+        juce::MidiBuffer midi;
+
+        const auto numBlocks = juce::jmax (200, int (settings.seconds * settings.sampleRate / settings.blockSize));
+        const auto numWarmUpBlocks = numBlocks / 10;
+
+        juce::int64 floatTicks = 0, doubleTicks = 0;
+        double maxDifference = 0.0;
+
+        for (int i = 0; i < numWarmUpBlocks + numBlocks; ++i)
+        {
+            const auto start = (i * settings.blockSize) % (source.getNumSamples() - settings.blockSize);
+
+            for (int channel = 0; channel < settings.numChannels; ++channel)
+                floatBlock.copyFrom (channel, 0, source, channel, start, settings.blockSize);
+
+            doubleBlock.makeCopyOf (floatBlock, true);
+
+            const auto floatStart = juce::Time::getHighResolutionTicks();
+            floatProcessor.processBlock (floatBlock, midi);
+            const auto doubleStart = juce::Time::getHighResolutionTicks();
+            doubleProcessor.processBlock (doubleBlock, midi);
+            const auto end = juce::Time::getHighResolutionTicks();
+
+            // Warm up caches, branch predictors and the smoothers before measuring
+            if (i < numWarmUpBlocks)
+                continue;
+
+            floatTicks += doubleStart - floatStart;
+            doubleTicks += end - doubleStart;
+
+            for (int channel = 0; channel < settings.numChannels; ++channel)
+                for (int n = 0; n < settings.blockSize; ++n)
+                    maxDifference = juce::jmax (maxDifference, std::abs (double (floatBlock.getSample (channel, n))
+                                                                         - doubleBlock.getSample (channel, n)));
+        }
+
+        floatProcessor.releaseResources();
+        doubleProcessor.releaseResources();
+
+        const auto numChannelSamples = double (numBlocks) * settings.blockSize * settings.numChannels;
+        const auto floatNs = Bench::ticksToNanoseconds (floatTicks) / numChannelSamples;
+        const auto doubleNs = Bench::ticksToNanoseconds (doubleTicks) / numChannelSamples;
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("oversampling", overSamplingFactor);
+        result->setProperty ("floatNsPerSample", floatNs);
+        result->setProperty ("doubleNsPerSample", doubleNs);
+        result->setProperty ("doubleCostRatio", doubleNs / floatNs);
+        result->setProperty ("maxDifference", maxDifference);
+        result->setProperty ("maxDifferenceDb", juce::Decibels::gainToDecibels (maxDifference, -300.0));
+        return result;
+    }
+}
+
+void runPrecisionBenchmark (const juce::ArgumentList& args)
+{
+    PrecisionSettings settings;
+    settings.sampleRate = double (Bench::getInt (args, "--rate", 48000));
+    settings.blockSize = Bench::getInt (args, "--block", 512);
+    settings.numChannels = Bench::getInt (args, "--channels", 2);
+    settings.seconds = Bench::getSeconds (args, settings.seconds);
+    settings.useFIR = Bench::isFIRFilter (args);
+
+    const auto factors = Bench::getOversamplingFactors (args, { 1, 2, 4, 8, 16 });
+
+    juce::Array<juce::var> runs;
+
+    for (auto factor : factors)
+    {
+        std::cerr << "precision: " << factor << "x" << std::endl;
+        runs.add (measurePrecision (settings, factor));
+    }
+
+    auto* results = new juce::DynamicObject();
+    results->setProperty ("sampleRate", settings.sampleRate);
+    results->setProperty ("blockSize", settings.blockSize);
+    results->setProperty ("channels", settings.numChannels);
+    results->setProperty ("filter", settings.useFIR ? "fir" : "iir");
+    results->setProperty ("doubleSimdLanes", (int) Oversampler<double>::laneWidth);
+    results->setProperty ("runs", runs);
+
+    Bench::writeReport (args, "precision", results);
+}
@@ -0,0 +1,349 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtilities.h"
+#include "../../Common/TSToolHelpers.h"
+
+namespace
+{
+    struct Configuration
+    {
+        double sampleRate;
+        int blockSize;
+        int overSamplingFactor;
+        int numChannels;
+
+        bool operator== (const Configuration& other) const noexcept
+        {
+            return sampleRate == other.sampleRate && blockSize == other.blockSize
+                && overSamplingFactor == other.overSamplingFactor && numChannels == other.numChannels;
+        }
+    };
+
+    struct Settings
+    {
+        double secondsPerConfiguration = 1.0;
+        bool useFIR = false;
+        float drive = 0.7f;
+        float tone = 0.6f;
+    };
+
+    int getStages (int overSamplingFactor)
+    {
+        return TSTools::getOversamplingIndex (overSamplingFactor);
+    }
+
+    int getNumBlocks (const Configuration& configuration, const Settings& settings)
+    {
+        return juce::jmax (200, int (settings.secondsPerConfiguration * configuration.sampleRate / configuration.blockSize));
+    }
+
+    // A second of test signal, looped over the measured blocks, and one more block
+    // of it so that a block may start anywhere in that second, however long it is
+    juce::AudioBuffer<float> makeSource (const Configuration& configuration)
+    {
+        juce::AudioBuffer<float> source (configuration.numChannels, int (configuration.sampleRate) + configuration.blockSize);
+        Bench::fillTestSignal (source, configuration.sampleRate);
+        return source;
+    }
+
+    void copyBlock (const juce::AudioBuffer<float>& source, juce::AudioBuffer<float>& block, int blockIndex)
+    {
+        const auto start = (blockIndex * block.getNumSamples()) % (source.getNumSamples() - block.getNumSamples());
+
+        for (int channel = 0; channel < block.getNumChannels(); ++channel)
+            block.copyFrom (channel, 0, source, channel, start, block.getNumSamples());
+    }
+
+    //==============================================================================
+    // The whole processBlock, timed per callback as a host would see it. Given a
+    // profileFile, the engine's own stage profile of the measured blocks is written to it.
+    juce::var measureProcessor (const Configuration& configuration, const Settings& settings, const juce::File& profileFile)
+    {
+        TSAudioProcessor processor;
+
+        if (! TSTools::setChannelCount (processor, configuration.numChannels))
+            juce::ConsoleApplication::fail ("unsupported channel count " + juce::String (configuration.numChannels));
+
+        TSTools::setParameter (processor, "oversampling", float (getStages (configuration.overSamplingFactor)));
+        TSTools::setParameter (processor, "oversamplingFilter", settings.useFIR ? 1.0f : 0.0f);
+        TSTools::setParameter (processor, "drive", settings.drive);
+        TSTools::setParameter (processor, "tone", settings.tone);
+        TSTools::prepare (processor, configuration.sampleRate, configuration.blockSize, false);
+
+        const auto source = makeSource (configuration);
+        juce::AudioBuffer<float> block (configuration.numChannels, configuration.blockSize);
+        juce::MidiBuffer midi;
+
+        const auto numBlocks = getNumBlocks (configuration, settings);
+        std::vector<double> callbackMicroseconds;
+        callbackMicroseconds.reserve (size_t (numBlocks));
+
+        // Warm up caches, branch predictors and the smoothers before measuring
+        for (int i = 0; i < numBlocks / 10; ++i)
+        {
+            copyBlock (source, block, i);
+            processor.processBlock (block, midi);
+        }
+
+        // Drops the warm up blocks from the profile
+        if (profileFile != juce::File())
+            processor.takeStageProfileReport();
+
+        juce::int64 totalTicks = 0;
+        juce::uint64 totalCycles = 0;
+
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            copyBlock (source, block, i);
+
+            const auto startCycles = Bench::readCycleCounter();
+            const auto startTicks = juce::Time::getHighResolutionTicks();
+            processor.processBlock (block, midi);
+            const auto ticks = juce::Time::getHighResolutionTicks() - startTicks;
+            totalCycles += Bench::readCycleCounter() - startCycles;
+
+            totalTicks += ticks;
+            callbackMicroseconds.push_back (Bench::ticksToNanoseconds (ticks) * 1.0e-3);
+        }
+
+        if (profileFile != juce::File() && ! processor.writeStageProfileReport (profileFile))
+            juce::ConsoleApplication::fail ("could not write " + profileFile.getFullPathName());
+
+        processor.releaseResources();
+
+        const auto numChannelSamples = double (numBlocks) * configuration.blockSize * configuration.numChannels;
+        const auto deadlineMicroseconds = 1.0e6 * configuration.blockSize / configuration.sampleRate;
+        const auto worstMicroseconds = *std::max_element (callbackMicroseconds.begin(), callbackMicroseconds.end());
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("latencySamples", processor.getLatencySamples());
+        result->setProperty ("nsPerSample", Bench::ticksToNanoseconds (totalTicks) / numChannelSamples);
+        result->setProperty ("cyclesPerSample", double (totalCycles) / numChannelSamples);
+        result->setProperty ("callbackMicroseconds", Bench::summarise (std::move (callbackMicroseconds)));
+        result->setProperty ("deadlineMicroseconds", deadlineMicroseconds);
+        result->setProperty ("worstCallbackOfDeadline", worstMicroseconds / deadlineMicroseconds);
+        return result;
+    }
+
+    //==============================================================================
+    // The same stages the engine runs, rebuilt here so each can be timed on its
+    // own: the oversampler's up and down paths, the drive filter, the clipper and
+    // the tone filter. Interleaving, smoothing and the level gain are what is left
+    // of the whole processBlock time once these are taken away.
+    class StageTimer
+    {
+    public:
+        enum Stage { upsample, driveFilter, clipper, downsample, toneFilter, numStages };
+
+        static const char* getStageName (int stage)
+        {
+            static const char* names[] = { "upsample", "driveFilter", "clipper", "downsample", "toneFilter" };
+            return names[stage];
+        }
+
+        template <typename Function>
+        void time (Stage stage, Function&& function)
+        {
+            const auto startCycles = Bench::readCycleCounter();
+            const auto startTicks = juce::Time::getHighResolutionTicks();
+            function();
+            ticks[stage] += juce::Time::getHighResolutionTicks() - startTicks;
+            cycles[stage] += Bench::readCycleCounter() - startCycles;
+        }
+
+        void reset()
+        {
+            std::fill (std::begin (ticks), std::end (ticks), juce::int64 (0));
+            std::fill (std::begin (cycles), std::end (cycles), juce::uint64 (0));
+        }
+
+        juce::int64 ticks[numStages] {};
+        juce::uint64 cycles[numStages] {};
+    };
+
+    // Channels into frames of numLanes, the padding lanes silent
+    void interleave (const juce::AudioBuffer<float>& source, float* frames, size_t numLanes)
+    {
+        for (size_t i = 0; i < size_t (source.getNumSamples()); ++i)
+            for (size_t lane = 0; lane < numLanes; ++lane)
+                frames[i * numLanes + lane] = lane < size_t (source.getNumChannels()) ? source.getSample (int (lane), int (i)) : 0.0f;
+    }
+
+    juce::var measureStages (const Configuration& configuration, const Settings& settings, double processorNsPerSample)
+    {
+        const auto blockSize = size_t (configuration.blockSize);
+        const auto factor = size_t (configuration.overSamplingFactor);
+
+        // Channels padded to whole registers, as TSEngine pads its streams
+        const auto width = Oversampler<float>::laneWidth;
+        const auto numLanes = (size_t (configuration.numChannels) + width - 1) / width * width;
+
+        Oversampler<float> overSampler;
+        overSampler.prepare (numLanes, getStages (configuration.overSamplingFactor),
+                             settings.useFIR ? OversamplingFilter::linearPhaseFIR : OversamplingFilter::polyphaseIIR, blockSize);
+
+        const DriveStageValues driveCircuit;
+        const ToneStageValues toneCircuit;
+        const auto R2 = driveCircuit.Rf + settings.drive * driveCircuit.Rpot;
+
+        BiquadBank<float> driveFilter, toneFilter;
+        driveFilter.prepare (numLanes);
+        toneFilter.prepare (numLanes);
+
+        DiodeClipper::LaneParameters clipperLanes;
+        clipperLanes.resize (numLanes, R2);
+
+        for (size_t lane = 0; lane < numLanes; ++lane)
+        {
+            driveFilter.setCoefficients (lane, designDriveFilter (driveCircuit, settings.drive, configuration.sampleRate * double (factor)));
+            toneFilter.setCoefficients (lane, designToneFilter (toneCircuit, settings.tone, configuration.sampleRate));
+        }
+
+        const auto clipperKernel = DiodeClipper::getFrameKernel (DiodeClipper::getBestImplementation());
+
+        std::vector<float> frames (blockSize * numLanes), driven (blockSize * factor * numLanes);
+
+        const auto source = makeSource (configuration);
+        juce::AudioBuffer<float> buffer (configuration.numChannels, configuration.blockSize);
+        const auto numBlocks = getNumBlocks (configuration, settings);
+
+        StageTimer timer;
+
+        for (int i = -numBlocks / 10; i < numBlocks; ++i)
+        {
+            if (i == 0)
+                timer.reset();
+
+            copyBlock (source, buffer, juce::jmax (0, i));
+            interleave (buffer, frames.data(), numLanes);
+
+            float* overSampled = nullptr;
+            const auto numOverSampled = blockSize * factor;
+
+            timer.time (StageTimer::upsample, [&] { overSampled = overSampler.processUp (frames.data(), blockSize); });
+            timer.time (StageTimer::driveFilter, [&] { driveFilter.process (overSampled, driven.data(), numOverSampled); });
+            timer.time (StageTimer::clipper, [&] { clipperKernel (driven.data(), overSampled, numOverSampled, numLanes, clipperLanes); });
+            timer.time (StageTimer::downsample, [&] { overSampler.processDown (frames.data(), blockSize); });
+            timer.time (StageTimer::toneFilter, [&] { toneFilter.process (frames.data(), frames.data(), blockSize); });
+        }
+
+        const auto numChannelSamples = double (numBlocks) * configuration.blockSize * configuration.numChannels;
+        auto* stages = new juce::DynamicObject();
+        double stagesNsPerSample = 0.0;
+
+        for (int stage = 0; stage < StageTimer::numStages; ++stage)
+        {
+            const auto nsPerSample = Bench::ticksToNanoseconds (timer.ticks[stage]) / numChannelSamples;
+            stagesNsPerSample += nsPerSample;
+
+            auto* entry = new juce::DynamicObject();
+            entry->setProperty ("nsPerSample", nsPerSample);
+            entry->setProperty ("cyclesPerSample", double (timer.cycles[stage]) / numChannelSamples);
+            entry->setProperty ("shareOfProcessBlock", nsPerSample / processorNsPerSample);
+            stages->setProperty (StageTimer::getStageName (stage), entry);
+        }
+
+        auto* remainder = new juce::DynamicObject();
+        remainder->setProperty ("nsPerSample", processorNsPerSample - stagesNsPerSample);
+        remainder->setProperty ("shareOfProcessBlock", (processorNsPerSample - stagesNsPerSample) / processorNsPerSample);
+        stages->setProperty ("other", remainder);
+
+        return stages;
+    }
+
+    //==============================================================================
+    // Each axis is swept on its own around the baseline, or with --full as a cross product
+    juce::Array<Configuration> makeConfigurations (const juce::ArgumentList& args)
+    {
+        const auto blockSizes = Bench::getIntList (args, "--blocks", { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 });
+        const auto sampleRates = Bench::getIntList (args, "--rates", { 44100, 48000, 96000, 192000 });
+        const auto factors = Bench::getOversamplingFactors (args, { 1, 2, 4, 8, 16 });
+        const auto channelCounts = Bench::getIntList (args, "--channels", { 1, 2, 6 });
+
+        for (auto blockSize : blockSizes)
+            if (blockSize < 1)
+                juce::ConsoleApplication::fail ("--blocks must be positive");
+
+        juce::Array<Configuration> configurations;
+        const Configuration baseline { 48000.0, 512, 2, 2 };
+
+        if (args.containsOption ("--full"))
+        {
+            for (auto rate : sampleRates)
+                for (auto blockSize : blockSizes)
+                    for (auto factor : factors)
+                        for (auto numChannels : channelCounts)
+                            configurations.add ({ double (rate), blockSize, factor, numChannels });
+
+            return configurations;
+        }
+
+        for (auto blockSize : blockSizes)
+            configurations.addIfNotAlreadyThere ({ baseline.sampleRate, blockSize, baseline.overSamplingFactor, baseline.numChannels });
+
+        for (auto rate : sampleRates)
+            configurations.addIfNotAlreadyThere ({ double (rate), baseline.blockSize, baseline.overSamplingFactor, baseline.numChannels });
+
+        for (auto factor : factors)
+            configurations.addIfNotAlreadyThere ({ baseline.sampleRate, baseline.blockSize, factor, baseline.numChannels });
+
+        for (auto numChannels : channelCounts)
+            configurations.addIfNotAlreadyThere ({ baseline.sampleRate, baseline.blockSize, baseline.overSamplingFactor, numChannels });
+
+        return configurations;
+    }
+
+    // The --profile file, or with several configurations one file each named after it
+    juce::File getProfileFile (const juce::ArgumentList& args, const Configuration& configuration, bool isOnlyConfiguration)
+    {
+        if (! args.containsOption ("--profile"))
+            return {};
+
+        const auto file = args.getFileForOption ("--profile");
+
+        if (isOnlyConfiguration)
+            return file;
+
+        return file.getSiblingFile (file.getFileNameWithoutExtension()
+                                      + "_" + juce::String (int (configuration.sampleRate)) + "Hz"
+                                      + "_" + juce::String (configuration.blockSize)
+                                      + "_" + juce::String (configuration.overSamplingFactor) + "x"
+                                      + "_" + juce::String (configuration.numChannels) + "ch"
+                                      + file.getFileExtension());
+    }
+}
+
+void runProcessorBenchmark (const juce::ArgumentList& args)
+{
+    Settings settings;
+
+    settings.secondsPerConfiguration = Bench::getSeconds (args, settings.secondsPerConfiguration);
+    settings.useFIR = Bench::isFIRFilter (args);
+
+    if (args.containsOption ("--profile") && ! TS_PROFILE_STAGES)
+        juce::ConsoleApplication::fail ("built without TS_PROFILE_STAGES, use the Profile configuration");
+
+    const auto configurations = makeConfigurations (args);
+    juce::Array<juce::var> results;
+
+    for (auto& configuration : configurations)
+    {
+        std::cerr << "processor: " << configuration.sampleRate << " Hz, block " << configuration.blockSize
+                  << ", " << configuration.overSamplingFactor << "x, " << configuration.numChannels << " ch" << std::endl;
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("sampleRate", configuration.sampleRate);
+        result->setProperty ("blockSize", configuration.blockSize);
+        result->setProperty ("oversampling", configuration.overSamplingFactor);
+        result->setProperty ("filter", settings.useFIR ? "fir" : "iir");
+        result->setProperty ("channels", configuration.numChannels);
+
+        const auto profileFile = getProfileFile (args, configuration, configurations.size() == 1);
+        const auto processBlock = measureProcessor (configuration, settings, profileFile);
+        result->setProperty ("processBlock", processBlock);
+        result->setProperty ("stages", measureStages (configuration, settings, processBlock["nsPerSample"]));
+
+        results.add (result);
+    }
+
+    Bench::writeReport (args, "processor", results);
+}
@@ -0,0 +1,388 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtilities.h"
+#include "../../Common/TSToolHelpers.h"
+
+namespace
+{
+    struct QualitySettings
+    {
+        double sampleRate = 48000.0;
+        int numChannels = 2;
+        int numTones = 8;
+        float drive = 0.7f;
+        float amplitude = 0.5f;
+        bool waveDigital = false;
+
+        // The quality bar: aliasing against the fundamental and deviation from the reference
+        double maxAliasingDb = -40.0;
+        double maxDeviationDb = -40.0;
+    };
+
+    constexpr int fftOrder = 14;
+    constexpr int fftSize = 1 << fftOrder;
+    constexpr int blockSize = 512;
+
+    // Each test signal runs this long before the analysed frame, so the smoothers,
+    // the filters and the previous signal's tail have settled
+    constexpr int settleSamples = 16384;
+
+    // Blackman-Harris leaks below -92 dB past this many bins either side of a tone
+    constexpr int toneHalfWidth = 4;
+
+    // One point of the quality / cost trade-off
+    struct Configuration
+    {
+        int overSamplingFactor = 1;
+        bool useFIR = false;
+        bool useDouble = false;
+        bool useClipperTable = false;
+        int antiAliasing = 0;  // DiodeClipper::AntiAliasing
+
+        juce::String getVariant() const
+        {
+            if (antiAliasing > 0)
+                return "adaa" + juce::String (antiAliasing);
+
+            return useDouble ? "double" : (useClipperTable ? "floatTable" : "float");
+        }
+    };
+
+    // Double precision with the exact clipper curve and the linear phase filters
+    // at the highest oversampling: as close to the analog model as the plugin gets
+    const Configuration referenceConfiguration { 16, true, true, false, 0 };
+
+    // A sine, or several at once, each at an odd FFT bin: the FFT size is a power
+    // of two, so no harmonic that folds back around Nyquist lands on a harmonic
+    struct TestSignal
+    {
+        std::vector<int> bins;
+        std::vector<float> samples;
+    };
+
+    // numBins odd bins log spaced from lowest to highest Hz
+    std::vector<int> getToneBins (double lowest, double highest, int numBins, double sampleRate)
+    {
+        std::vector<int> bins;
+
+        for (int i = 0; i < numBins; ++i)
+        {
+            const auto position = numBins > 1 ? double (i) / double (numBins - 1) : 0.0;
+            const auto frequency = lowest * std::pow (highest / lowest, position);
+            const auto bin = juce::roundToInt (frequency * fftSize / sampleRate) | 1;
+
+            if (bins.empty() || bin > bins.back())
+                bins.push_back (bin);
+        }
+
+        return bins;
+    }
+
+    TestSignal makeTestSignal (std::vector<int> bins, float amplitude)
+    {
+        TestSignal signal;
+        signal.bins = std::move (bins);
+        signal.samples.resize (size_t (settleSamples + fftSize));
+
+        const auto toneAmplitude = double (amplitude) / double (signal.bins.size());
+
+        for (size_t n = 0; n < signal.samples.size(); ++n)
+        {
+            double sample = 0.0;
+
+            for (auto bin : signal.bins)
+                sample += toneAmplitude * std::sin (juce::MathConstants<double>::twoPi * double (bin) * double (n) / fftSize);
+
+            signal.samples[n] = float (sample);
+        }
+
+        return signal;
+    }
+
+    // Power per bin of the windowed frame, DC to Nyquist
+    class Analyser
+    {
+    public:
+        std::vector<double> getPowerSpectrum (const float* frame)
+        {
+            std::copy (frame, frame + fftSize, data.begin());
+            std::fill (data.begin() + fftSize, data.end(), 0.0f);
+            window.multiplyWithWindowingTable (data.data(), size_t (fftSize));
+            fft.performFrequencyOnlyForwardTransform (data.data());
+
+            std::vector<double> power (size_t (fftSize / 2 + 1));
+
+            for (size_t bin = 0; bin < power.size(); ++bin)
+                power[bin] = double (data[bin]) * double (data[bin]);
+
+            return power;
+        }
+
+    private:
+        juce::dsp::FFT fft { fftOrder };
+        juce::dsp::WindowingFunction<float> window { size_t (fftSize), juce::dsp::WindowingFunction<float>::blackmanHarris, false };
+        std::vector<float> data = std::vector<float> (size_t (2 * fftSize));
+    };
+
+    double powerToDecibels (double ratio)
+    {
+        return 10.0 * std::log10 (juce::jmax (1.0e-30, ratio));
+    }
+
+    // A sine through the clipper: its harmonics below Nyquist are the circuit's
+    // distortion, everything else but DC is aliasing and noise. The noise floor is
+    // the median of those other bins, which the sparse alias products leave alone.
+    juce::var analyseTone (const std::vector<double>& power, int bin)
+    {
+        const auto numBins = int (power.size());
+        std::vector<bool> isHarmonic (power.size(), false);
+        double fundamental = 0.0, harmonics = 0.0;
+
+        for (int b = 0; b <= toneHalfWidth; ++b)
+            isHarmonic[size_t (b)] = true;
+
+        for (int harmonic = 1; harmonic * bin + toneHalfWidth < numBins; ++harmonic)
+        {
+            for (int b = harmonic * bin - toneHalfWidth; b <= harmonic * bin + toneHalfWidth; ++b)
+            {
+                isHarmonic[size_t (b)] = true;
+                (harmonic == 1 ? fundamental : harmonics) += power[size_t (b)];
+            }
+        }
+
+        double other = 0.0;
+        std::vector<double> otherBins;
+
+        for (size_t b = 0; b < power.size(); ++b)
+        {
+            if (! isHarmonic[b])
+            {
+                other += power[b];
+                otherBins.push_back (power[b]);
+            }
+        }
+
+        std::nth_element (otherBins.begin(), otherBins.begin() + std::ptrdiff_t (otherBins.size() / 2), otherBins.end());
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("aliasingDb", powerToDecibels (other / fundamental));
+        result->setProperty ("thdDb", powerToDecibels (harmonics / fundamental));
+        result->setProperty ("noiseFloorDb", powerToDecibels (otherBins[otherBins.size() / 2] / fundamental));
+        return result;
+    }
+
+    // Magnitude spectrum error against the reference, over its total power. Only
+    // magnitudes are compared, so the configurations' different latencies and
+    // phase responses do not count against them.
+    double getDeviationDb (const std::vector<double>& power, const std::vector<double>& reference)
+    {
+        double error = 0.0, total = 0.0;
+
+        for (size_t b = 0; b < power.size(); ++b)
+        {
+            const auto difference = std::sqrt (power[b]) - std::sqrt (reference[b]);
+            error += difference * difference;
+            total += reference[b];
+        }
+
+        return powerToDecibels (error / total);
+    }
+
+    void prepareProcessor (TSAudioProcessor& processor, const QualitySettings& settings, const Configuration& configuration)
+    {
+        TSTools::setChannelCount (processor, settings.numChannels);
+        TSTools::setParameter (processor, "oversampling", float (TSTools::getOversamplingIndex (configuration.overSamplingFactor)));
+        TSTools::setParameter (processor, "oversamplingFilter", configuration.useFIR ? 1.0f : 0.0f);
+        TSTools::setParameter (processor, "driveModel", settings.waveDigital ? 1.0f : 0.0f);
+        TSTools::setParameter (processor, "drive", settings.drive);
+        TSTools::setParameter (processor, "tone", 0.5f);
+        TSTools::setParameter (processor, "clipperAntiAliasing", float (configuration.antiAliasing));
+        processor.setUseClipperTable (configuration.useClipperTable);
+
+        // The wave digital model only runs offline; the swept factor holds either way
+        TSTools::setParameter (processor, "offlineQuality", 0.0f);
+        TSTools::prepare (processor, settings.sampleRate, blockSize, settings.waveDigital,
+                          configuration.useDouble ? juce::AudioProcessor::doublePrecision : juce::AudioProcessor::singlePrecision);
+    }
+
+    // Runs the signal through every channel block by block and keeps the analysed
+    // frame of the first. Returns the ticks spent in processBlock.
+    template <typename SampleType>
+    juce::int64 processSignal (TSAudioProcessor& processor, const TestSignal& signal, int numChannels, std::vector<float>& frame)
+    {
+        juce::AudioBuffer<SampleType> block (numChannels, blockSize);
+        juce::MidiBuffer midi;
+        juce::int64 ticks = 0;
+
+        frame.resize (size_t (fftSize));
+
+        for (int start = 0; start < int (signal.samples.size()); start += blockSize)
+        {
+            const auto numSamples = juce::jmin (blockSize, int (signal.samples.size()) - start);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                for (int n = 0; n < numSamples; ++n)
+                    block.setSample (channel, n, SampleType (signal.samples[size_t (start + n)]));
+
+            juce::AudioBuffer<SampleType> view (block.getArrayOfWritePointers(), numChannels, numSamples);
+
+            const auto blockStart = juce::Time::getHighResolutionTicks();
+            processor.processBlock (view, midi);
+            ticks += juce::Time::getHighResolutionTicks() - blockStart;
+
+            for (int n = 0; n < numSamples; ++n)
+                if (start + n >= settleSamples)
+                    frame[size_t (start + n - settleSamples)] = float (view.getSample (0, n));
+        }
+
+        return ticks;
+    }
+
+    struct Measurement
+    {
+        std::vector<std::vector<double>> spectra;
+        double nanosecondsPerChannelSample = 0.0;
+    };
+
+    // Every test signal through one processor in turn, timing the lot
+    Measurement measure (const QualitySettings& settings, const Configuration& configuration,
+                         const std::vector<TestSignal>& signals, Analyser& analyser)
+    {
+        TSAudioProcessor processor;
+        prepareProcessor (processor, settings, configuration);
+
+        Measurement measurement;
+        std::vector<float> frame;
+        juce::int64 ticks = 0, numSamples = 0;
+
+        for (auto& signal : signals)
+        {
+            ticks += configuration.useDouble ? processSignal<double> (processor, signal, settings.numChannels, frame)
+                                             : processSignal<float> (processor, signal, settings.numChannels, frame);
+            numSamples += juce::int64 (signal.samples.size());
+            measurement.spectra.push_back (analyser.getPowerSpectrum (frame.data()));
+        }
+
+        processor.releaseResources();
+        measurement.nanosecondsPerChannelSample = Bench::ticksToNanoseconds (ticks) / (double (numSamples) * settings.numChannels);
+        return measurement;
+    }
+}
+
+void runQualityBenchmark (const juce::ArgumentList& args)
+{
+    QualitySettings settings;
+    settings.sampleRate = double (Bench::getInt (args, "--rate", 48000));
+    settings.numTones = Bench::getInt (args, "--tones", 8);
+
+    const auto factors = Bench::getOversamplingFactors (args, { 1, 2, 4, 8, 16 });
+
+    juce::Array<bool> filters { false, true };
+
+    if (args.containsOption ("--filter"))
+    {
+        filters.clearQuick();
+        filters.add (Bench::isFIRFilter (args));
+    }
+
+    if (args.containsOption ("--drive"))
+        settings.drive = juce::jlimit (0.0f, 1.0f, args.getValueForOption ("--drive").getFloatValue());
+
+    if (args.containsOption ("--drive-model"))
+        settings.waveDigital = args.getValueForOption ("--drive-model").toLowerCase() == "wdf";
+
+    if (args.containsOption ("--max-aliasing"))
+        settings.maxAliasingDb = args.getValueForOption ("--max-aliasing").getDoubleValue();
+
+    if (args.containsOption ("--max-deviation"))
+        settings.maxDeviationDb = args.getValueForOption ("--max-deviation").getDoubleValue();
+
+    // A stepped sine sweep from 100 Hz to 0.15 fs, past where hard clipping's
+    // harmonics fold back at every factor, then a multi tone whose
+    // intermodulation the reference pins down
+    std::vector<TestSignal> signals;
+
+    for (auto bin : getToneBins (100.0, 0.15 * settings.sampleRate, settings.numTones, settings.sampleRate))
+        signals.push_back (makeTestSignal ({ bin }, settings.amplitude));
+
+    const auto numSines = signals.size();
+    signals.push_back (makeTestSignal (getToneBins (150.0, 6000.0, 6, settings.sampleRate), settings.amplitude));
+
+    Analyser analyser;
+
+    std::cerr << "quality: reference" << std::endl;
+    const auto reference = measure (settings, referenceConfiguration, signals, analyser);
+
+    juce::Array<juce::var> runs;
+    juce::var cheapest;
+    double cheapestNs = std::numeric_limits<double>::max();
+
+    for (auto factor : factors)
+    {
+        for (auto useFIR : filters)
+        {
+            for (auto configuration : { Configuration { factor, useFIR, false, false, 0 },
+                                        Configuration { factor, useFIR, false, true, 0 },
+                                        Configuration { factor, useFIR, true, false, 0 },
+                                        Configuration { factor, useFIR, false, false, 1 },
+                                        Configuration { factor, useFIR, false, false, 2 } })
+            {
+                std::cerr << "quality: " << factor << "x " << (useFIR ? "fir " : "iir ") << configuration.getVariant() << std::endl;
+
+                const auto measurement = measure (settings, configuration, signals, analyser);
+
+                juce::Array<juce::var> tones;
+                double worstAliasingDb = -300.0, worstDeviationDb = -300.0;
+
+                for (size_t i = 0; i < numSines; ++i)
+                {
+                    auto tone = analyseTone (measurement.spectra[i], signals[i].bins.front());
+                    const auto deviationDb = getDeviationDb (measurement.spectra[i], reference.spectra[i]);
+
+                    tone.getDynamicObject()->setProperty ("frequency", signals[i].bins.front() * settings.sampleRate / fftSize);
+                    tone.getDynamicObject()->setProperty ("deviationDb", deviationDb);
+
+                    worstAliasingDb = juce::jmax (worstAliasingDb, double (tone["aliasingDb"]));
+                    worstDeviationDb = juce::jmax (worstDeviationDb, deviationDb);
+                    tones.add (tone);
+                }
+
+                const auto multiToneDeviationDb = getDeviationDb (measurement.spectra.back(), reference.spectra.back());
+                worstDeviationDb = juce::jmax (worstDeviationDb, multiToneDeviationDb);
+
+                const bool meetsBar = worstAliasingDb <= settings.maxAliasingDb && worstDeviationDb <= settings.maxDeviationDb;
+
+                auto* run = new juce::DynamicObject();
+                run->setProperty ("oversampling", factor);
+                run->setProperty ("filter", useFIR ? "fir" : "iir");
+                run->setProperty ("variant", configuration.getVariant());
+                run->setProperty ("nsPerChannelSample", measurement.nanosecondsPerChannelSample);
+                run->setProperty ("worstAliasingDb", worstAliasingDb);
+                run->setProperty ("worstDeviationDb", worstDeviationDb);
+                run->setProperty ("multiToneDeviationDb", multiToneDeviationDb);
+                run->setProperty ("meetsBar", meetsBar);
+                run->setProperty ("tones", tones);
+                runs.add (run);
+
+                if (meetsBar && measurement.nanosecondsPerChannelSample < cheapestNs)
+                {
+                    cheapestNs = measurement.nanosecondsPerChannelSample;
+                    cheapest = run;
+                }
+            }
+        }
+    }
+
+    auto* results = new juce::DynamicObject();
+    results->setProperty ("sampleRate", settings.sampleRate);
+    results->setProperty ("channels", settings.numChannels);
+    results->setProperty ("fftSize", fftSize);
+    results->setProperty ("drive", settings.drive);
+    results->setProperty ("driveModel", settings.waveDigital ? "wdf" : "filter");
+    results->setProperty ("maxAliasingDb", settings.maxAliasingDb);
+    results->setProperty ("maxDeviationDb", settings.maxDeviationDb);
+    results->setProperty ("referenceNsPerChannelSample", reference.nanosecondsPerChannelSample);
+    results->setProperty ("cheapestMeetingBar", cheapest);
+    results->setProperty ("runs", runs);
+
+    Bench::writeReport (args, "quality", results);
+}
@@ -0,0 +1,141 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtilities.h"
+#include "../../Common/TSToolHelpers.h"
+
+namespace
+{
+    // Every instance at its own settings, so no two states are alike
+    void randomiseParameters (TSAudioProcessor& processor, juce::Random& random)
+    {
+        for (auto* parameter : processor.getParameters())
+            parameter->setValueNotifyingHost (random.nextFloat());
+
+        processor.setMidiController (TSAudioProcessor::MidiTarget::drive, random.nextInt (128));
+    }
+
+    // Saves and restores every instance in one format, as a host opening and
+    // autosaving a session does. The best of numRuns, to leave out first touches.
+    template <typename SaveFunction>
+    juce::var measureFormat (std::vector<std::unique_ptr<TSAudioProcessor>>& instances, int numRuns, SaveFunction&& save)
+    {
+        std::vector<juce::MemoryBlock> states (instances.size());
+
+        const auto saveMs = Bench::bestNanoseconds (numRuns, [&]
+        {
+            for (size_t i = 0; i < instances.size(); ++i)
+                save (*instances[i], states[i]);
+        }) * 1.0e-6;
+
+        const auto loadMs = Bench::bestNanoseconds (numRuns, [&]
+        {
+            for (size_t i = 0; i < instances.size(); ++i)
+                instances[i]->setStateInformation (states[i].getData(), int (states[i].getSize()));
+        }) * 1.0e-6;
+
+        size_t totalBytes = 0;
+
+        for (auto& state : states)
+            totalBytes += state.getSize();
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("saveMs", saveMs);
+        result->setProperty ("loadMs", loadMs);
+        result->setProperty ("saveMicrosecondsPerInstance", saveMs * 1.0e3 / double (instances.size()));
+        result->setProperty ("loadMicrosecondsPerInstance", loadMs * 1.0e3 / double (instances.size()));
+        result->setProperty ("bytesPerInstance", double (totalBytes) / double (instances.size()));
+        return result;
+    }
+
+    // Same parameter values, to float rounding, and the same controllers
+    bool hasSameState (TSAudioProcessor& a, TSAudioProcessor& b)
+    {
+        for (int i = 0; i < a.getParameters().size(); ++i)
+            if (std::abs (a.getParameters()[i]->getValue() - b.getParameters()[i]->getValue()) > 1.0e-6f)
+                return false;
+
+        for (int target = 0; target < TSAudioProcessor::numMidiTargets; ++target)
+            if (a.getMidiController (TSAudioProcessor::MidiTarget (target)) != b.getMidiController (TSAudioProcessor::MidiTarget (target)))
+                return false;
+
+        return true;
+    }
+
+    // Loads every instance's state, in both formats, into another processor and
+    // checks it restores what was saved. A binary state cut short anywhere must change nothing.
+    // Returns the number of instances that failed.
+    int countStatesNotRestored (std::vector<std::unique_ptr<TSAudioProcessor>>& instances, juce::Random& random)
+    {
+        TSAudioProcessor copy;
+        int numFailed = 0;
+
+        for (auto& instance : instances)
+        {
+            juce::MemoryBlock binary, xml;
+            instance->getStateInformation (binary);
+            instance->getXmlStateInformation (xml);
+
+            randomiseParameters (copy, random);
+            copy.setStateInformation (binary.getData(), int (binary.getSize()));
+            auto restored = hasSameState (*instance, copy);
+
+            randomiseParameters (copy, random);
+            copy.setStateInformation (xml.getData(), int (xml.getSize()));
+            restored = restored && hasSameState (*instance, copy);
+
+            copy.setStateInformation (binary.getData(), int (binary.getSize()));
+
+            for (int size = 0; size < int (binary.getSize()); ++size)
+                copy.setStateInformation (binary.getData(), size);
+
+            restored = restored && hasSameState (*instance, copy);
+
+            if (! restored)
+                ++numFailed;
+        }
+
+        return numFailed;
+    }
+}
+
+void runStateBenchmark (const juce::ArgumentList& args)
+{
+    const auto numInstances = Bench::getInt (args, "--instances", 500);
+    const auto numRuns = Bench::getInt (args, "--runs", 5);
+
+    juce::Random random (42);
+    std::vector<std::unique_ptr<TSAudioProcessor>> instances;
+
+    for (int i = 0; i < numInstances; ++i)
+    {
+        instances.push_back (std::make_unique<TSAudioProcessor>());
+        randomiseParameters (*instances.back(), random);
+    }
+
+    std::cerr << "state: " << numInstances << " instances" << std::endl;
+
+    const auto xml = measureFormat (instances, numRuns, [] (TSAudioProcessor& processor, juce::MemoryBlock& state)
+    {
+        processor.getXmlStateInformation (state);
+    });
+
+    const auto binary = measureFormat (instances, numRuns, [] (TSAudioProcessor& processor, juce::MemoryBlock& state)
+    {
+        processor.getStateInformation (state);
+    });
+
+    auto* results = new juce::DynamicObject();
+    results->setProperty ("instances", numInstances);
+    results->setProperty ("stateVersion", TSAudioProcessor::stateVersion);
+    results->setProperty ("xml", xml);
+    results->setProperty ("binary", binary);
+    results->setProperty ("saveSpeedup", double (xml["saveMs"]) / double (binary["saveMs"]));
+    results->setProperty ("loadSpeedup", double (xml["loadMs"]) / double (binary["loadMs"]));
+
+    const auto numNotRestored = countStatesNotRestored (instances, random);
+    results->setProperty ("statesNotRestored", numNotRestored);
+
+    Bench::writeReport (args, "state", results);
+
+    if (numNotRestored > 0)
+        juce::ConsoleApplication::fail (juce::String (numNotRestored) + " of " + juce::String (numInstances) + " states were not restored");
+}
@@ -0,0 +1,279 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtilities.h"
+#include "../../Common/TSToolHelpers.h"
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#if JUCE_LINUX
+ #include <unistd.h>
+#elif JUCE_MAC
+ #include <mach/mach.h>
+#endif
+
+namespace
+{
+    struct StressSettings
+    {
+        double sampleRate = 48000.0;
+        int blockSize = 128;
+        int numChannels = 2;
+        int overSamplingFactor = 2;
+        int numInstances = 256;
+        double seconds = 2.0;
+    };
+
+    // Resident memory of the process, -1 where it cannot be read
+    juce::int64 getResidentBytes()
+    {
+       #if JUCE_LINUX
+        juce::int64 pages = 0, residentPages = 0;
+
+        if (auto* file = std::fopen ("/proc/self/statm", "r"))
+        {
+            const auto numRead = std::fscanf (file, "%lld %lld", &pages, &residentPages);
+            std::fclose (file);
+
+            if (numRead == 2)
+                return residentPages * juce::int64 (sysconf (_SC_PAGESIZE));
+        }
+
+        return -1;
+       #elif JUCE_MAC
+        mach_task_basic_info info;
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+
+        if (task_info (mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t) &info, &count) == KERN_SUCCESS)
+            return juce::int64 (info.resident_size);
+
+        return -1;
+       #else
+        return -1;
+       #endif
+    }
+
+    // One plugin instance as a host graph holds it: the processor and its own buffer
+    struct Instance
+    {
+        TSAudioProcessor processor;
+        juce::AudioBuffer<float> buffer;
+        juce::MidiBuffer midi;
+    };
+
+    // Workers that each process their share of the instances once per cycle, the
+    // cycle ending when the last one is done, like a host running a graph's nodes
+    // in parallel for every buffer. The calling thread is worker 0; the others
+    // spin between cycles, as realtime audio thread pools do, so waking them
+    // costs no system call.
+    class LockStepPool
+    {
+    public:
+        template <typename Work>
+        LockStepPool (int numWorkers, Work&& work)  : ownWork (work)
+        {
+            for (int worker = 1; worker < numWorkers; ++worker)
+            {
+                threads.emplace_back ([this, worker, work]
+                {
+                    for (juce::uint64 seen = 0;;)
+                    {
+                        juce::uint64 current;
+
+                        while ((current = cycle.load (std::memory_order_acquire)) == seen)
+                            std::this_thread::yield();
+
+                        if (stopping.load (std::memory_order_relaxed))
+                            return;
+
+                        seen = current;
+                        work (worker);
+                        numDone.fetch_add (1, std::memory_order_acq_rel);
+                    }
+                });
+            }
+        }
+
+        ~LockStepPool()
+        {
+            stopping = true;
+            cycle.fetch_add (1, std::memory_order_release);
+
+            for (auto& thread : threads)
+                thread.join();
+        }
+
+        void runCycle()
+        {
+            numDone.store (0, std::memory_order_relaxed);
+            cycle.fetch_add (1, std::memory_order_release);
+            ownWork (0);
+
+            while (numDone.load (std::memory_order_acquire) < int (threads.size()))
+                std::this_thread::yield();
+        }
+
+    private:
+        std::function<void (int)> ownWork;
+        std::vector<std::thread> threads;
+        std::atomic<juce::uint64> cycle { 0 };
+        std::atomic<int> numDone { 0 };
+        std::atomic<bool> stopping { false };
+    };
+
+    // Every instance processes a block per cycle across numThreads workers, each
+    // worker taking a contiguous share. Reports the cycle times against the
+    // block's deadline and the throughput.
+    juce::var measureThreads (const StressSettings& settings, std::vector<std::unique_ptr<Instance>>& instances,
+                              const juce::AudioBuffer<float>& source, int numThreads)
+    {
+        const auto numInstances = int (instances.size());
+        const auto numSourceBlocks = source.getNumSamples() / settings.blockSize;
+        std::atomic<int> sourceBlock { 0 };
+
+        LockStepPool pool (numThreads, [&, numThreads] (int worker)
+        {
+            const auto first = worker * numInstances / numThreads;
+            const auto last = (worker + 1) * numInstances / numThreads;
+            const auto start = sourceBlock.load (std::memory_order_relaxed) * settings.blockSize;
+
+            for (int i = first; i < last; ++i)
+            {
+                auto& instance = *instances[size_t (i)];
+
+                for (int channel = 0; channel < settings.numChannels; ++channel)
+                    instance.buffer.copyFrom (channel, 0, source, channel, start, settings.blockSize);
+
+                instance.processor.processBlock (instance.buffer, instance.midi);
+            }
+        });
+
+        const auto deadlineMicroseconds = double (settings.blockSize) * 1.0e6 / settings.sampleRate;
+        const auto numCycles = juce::jmax (100, int (settings.seconds * settings.sampleRate / settings.blockSize));
+        const auto numWarmUpCycles = numCycles / 10;
+
+        std::vector<double> cycleMicroseconds;
+        cycleMicroseconds.reserve (size_t (numCycles));
+        juce::int64 totalTicks = 0;
+        int numMissed = 0;
+
+        for (int i = 0; i < numWarmUpCycles + numCycles; ++i)
+        {
+            sourceBlock = i % numSourceBlocks;
+
+            const auto start = juce::Time::getHighResolutionTicks();
+            pool.runCycle();
+            const auto ticks = juce::Time::getHighResolutionTicks() - start;
+
+            if (i < numWarmUpCycles)
+                continue;
+
+            const auto microseconds = Bench::ticksToNanoseconds (ticks) * 1.0e-3;
+            cycleMicroseconds.push_back (microseconds);
+            totalTicks += ticks;
+            numMissed += microseconds > deadlineMicroseconds ? 1 : 0;
+        }
+
+        const auto meanCycleMicroseconds = Bench::ticksToNanoseconds (totalTicks) * 1.0e-3 / double (numCycles);
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("threads", numThreads);
+        result->setProperty ("cycleMicroseconds", Bench::summarise (cycleMicroseconds));
+        result->setProperty ("deadlineMicroseconds", deadlineMicroseconds);
+        result->setProperty ("missedDeadlines", numMissed);
+        result->setProperty ("missedFraction", double (numMissed) / double (numCycles));
+        result->setProperty ("nsPerInstanceSample", meanCycleMicroseconds * 1.0e3 / (double (numInstances) * settings.blockSize));
+
+        // How many such instances would fill every worker's deadline on average
+        result->setProperty ("realtimeInstances", double (numInstances) * deadlineMicroseconds / meanCycleMicroseconds);
+        return result;
+    }
+}
+
+void runStressBenchmark (const juce::ArgumentList& args)
+{
+    StressSettings settings;
+    settings.sampleRate = double (Bench::getInt (args, "--rate", 48000));
+    settings.blockSize = Bench::getInt (args, "--block", 128);
+    settings.numChannels = Bench::getInt (args, "--channels", 2);
+    settings.overSamplingFactor = Bench::getOversamplingFactors (args, { 2 })[0];
+    settings.numInstances = Bench::getInt (args, "--instances", 256);
+    settings.seconds = Bench::getSeconds (args, settings.seconds);
+
+    // 1, 2, 4, ... up to every core by default
+    juce::Array<int> defaultThreads;
+
+    for (int threads = 1; threads < juce::SystemStats::getNumCpus(); threads *= 2)
+        defaultThreads.add (threads);
+
+    defaultThreads.add (juce::SystemStats::getNumCpus());
+
+    const auto threadCounts = Bench::getIntList (args, "--threads", defaultThreads);
+
+    for (auto threads : threadCounts)
+        if (threads < 1)
+            juce::ConsoleApplication::fail ("--threads must be at least 1");
+
+    juce::AudioBuffer<float> source (settings.numChannels, int (settings.sampleRate) + settings.blockSize);
+    Bench::fillTestSignal (source, settings.sampleRate);
+
+    std::cerr << "stress: preparing " << settings.numInstances << " instances" << std::endl;
+
+    // Every instance at its own settings, so none of them sleeps or shares a design
+    const auto residentBefore = getResidentBytes();
+    juce::Random random (3);
+    std::vector<std::unique_ptr<Instance>> instances;
+
+    for (int i = 0; i < settings.numInstances; ++i)
+    {
+        auto instance = std::make_unique<Instance>();
+        auto& processor = instance->processor;
+
+        TSTools::setChannelCount (processor, settings.numChannels);
+        TSTools::setParameter (processor, "oversampling", float (TSTools::getOversamplingIndex (settings.overSamplingFactor)));
+        TSTools::setParameter (processor, "drive", 0.2f + 0.6f * random.nextFloat());
+        TSTools::setParameter (processor, "tone", 0.2f + 0.6f * random.nextFloat());
+        TSTools::prepare (processor, settings.sampleRate, settings.blockSize, false);
+
+        instance->buffer.setSize (settings.numChannels, settings.blockSize);
+        instances.push_back (std::move (instance));
+    }
+
+    const auto residentAfter = getResidentBytes();
+
+    juce::Array<juce::var> runs;
+    double singleThreadNs = 0.0;
+
+    for (auto threads : threadCounts)
+    {
+        std::cerr << "stress: " << threads << " threads" << std::endl;
+
+        auto run = measureThreads (settings, instances, source, threads);
+        const auto ns = double (run["nsPerInstanceSample"]);
+
+        if (runs.isEmpty())
+            singleThreadNs = ns * threadCounts[0];
+
+        // Throughput against the first run's per thread rate: 1 scales perfectly,
+        // less shows contention, false sharing or memory bandwidth limits
+        run.getDynamicObject()->setProperty ("scalingEfficiency", singleThreadNs / (ns * threads));
+        runs.add (run);
+    }
+
+    for (auto& instance : instances)
+        instance->processor.releaseResources();
+
+    auto* results = new juce::DynamicObject();
+    results->setProperty ("sampleRate", settings.sampleRate);
+    results->setProperty ("blockSize", settings.blockSize);
+    results->setProperty ("channels", settings.numChannels);
+    results->setProperty ("oversampling", settings.overSamplingFactor);
+    results->setProperty ("instances", settings.numInstances);
+    results->setProperty ("processorBytes", (int) sizeof (TSAudioProcessor));
+    results->setProperty ("residentBytesPerInstance", residentBefore >= 0 && residentAfter >= 0
+                                                        ? double (residentAfter - residentBefore) / settings.numInstances
+                                                        : -1.0);
+    results->setProperty ("runs", runs);
+
+    Bench::writeReport (args, "stress", results);
+}
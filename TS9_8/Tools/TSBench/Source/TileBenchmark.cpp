@@ -0,0 +1,137 @@
+#include "Benchmarks.h"
+#include "BenchmarkUtilities.h"
+#include "../../Common/TSToolHelpers.h"
+
+namespace
+{
+    struct TileSettings
+    {
+        double sampleRate = 48000.0;
+        int numChannels = 2;
+        int overSamplingFactor = 4;
+        double seconds = 1.0;
+        bool fused = true;
+    };
+
+    // Host block sizes, 0 for irregular blocks of 1 to 4096 samples as some hosts
+    // send while rendering offline
+    juce::String describeBlockSize (int blockSize)
+    {
+        return blockSize > 0 ? juce::String (blockSize) : juce::String ("irregular");
+    }
+
+    // processBlock at one tile size, fed host blocks of blockSize samples
+    double nanosecondsPerChannelSample (const TileSettings& settings, int tileSize, int blockSize)
+    {
+        const int largestBlock = blockSize > 0 ? blockSize : 4096;
+
+        TSAudioProcessor processor;
+        TSTools::setChannelCount (processor, settings.numChannels);
+        TSTools::setParameter (processor, "oversampling", float (TSTools::getOversamplingIndex (settings.overSamplingFactor)));
+        TSTools::setParameter (processor, "drive", 0.7f);
+        TSTools::setParameter (processor, "tone", 0.6f);
+        processor.setTileSize (tileSize);
+        processor.setFusedProcessing (settings.fused);
+        TSTools::prepare (processor, settings.sampleRate, largestBlock, false);
+
+        juce::AudioBuffer<float> source (settings.numChannels, int (settings.sampleRate) + largestBlock);
+        Bench::fillTestSignal (source, settings.sampleRate);
+
+        juce::AudioBuffer<float> block (settings.numChannels, largestBlock);
+        juce::MidiBuffer midi;
+        juce::Random random (7);
+
+        const auto totalSamples = juce::int64 (settings.seconds * settings.sampleRate);
+        juce::int64 processed = 0, ticks = 0;
+        int position = 0;
+
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            // The first pass warms up and is not counted
+            const auto passSamples = pass == 0 ? totalSamples / 10 : totalSamples;
+
+            for (juce::int64 done = 0; done < passSamples;)
+            {
+                const auto numSamples = blockSize > 0 ? blockSize : 1 + random.nextInt (largestBlock);
+
+                if (position + numSamples > int (settings.sampleRate))
+                    position = 0;
+
+                for (int channel = 0; channel < settings.numChannels; ++channel)
+                    block.copyFrom (channel, 0, source, channel, position, numSamples);
+
+                juce::AudioBuffer<float> view (block.getArrayOfWritePointers(), settings.numChannels, numSamples);
+
+                const auto start = juce::Time::getHighResolutionTicks();
+                processor.processBlock (view, midi);
+
+                if (pass > 0)
+                {
+                    ticks += juce::Time::getHighResolutionTicks() - start;
+                    processed += numSamples;
+                }
+
+                position += numSamples;
+                done += numSamples;
+            }
+        }
+
+        processor.releaseResources();
+        return Bench::ticksToNanoseconds (ticks) / (double (processed) * double (settings.numChannels));
+    }
+}
+
+void runTileBenchmark (const juce::ArgumentList& args)
+{
+    TileSettings settings;
+    settings.sampleRate = double (Bench::getInt (args, "--rate", 48000));
+    settings.numChannels = Bench::getInt (args, "--channels", 2);
+    settings.overSamplingFactor = Bench::getOversamplingFactors (args, { 4 })[0];
+    settings.seconds = Bench::getSeconds (args, settings.seconds);
+
+    const bool compareUnfused = args.containsOption ("--unfused");
+    const auto tileSizes = Bench::getIntList (args, "--tiles", { 16, 32, 64, 128, 256, 512, 1024 });
+    const auto blockSizes = Bench::getIntList (args, "--blocks", { 64, 512, 4096, 0 });
+
+    for (auto tileSize : tileSizes)
+        if (tileSize < TSAudioProcessor::minTileSize || tileSize > TSAudioProcessor::maxTileSize)
+            juce::ConsoleApplication::fail ("--tiles must be between " + juce::String (TSAudioProcessor::minTileSize)
+                                              + " and " + juce::String (TSAudioProcessor::maxTileSize));
+
+    juce::Array<juce::var> runs;
+
+    for (auto tileSize : tileSizes)
+    {
+        std::cerr << "tiles: " << tileSize << " samples" << std::endl;
+
+        auto* run = new juce::DynamicObject();
+        run->setProperty ("tileSize", tileSize);
+
+        // Fused, and with --unfused also stage by stage over each tile
+        for (auto fused : { true, false })
+        {
+            if (! fused && ! compareUnfused)
+                continue;
+
+            settings.fused = fused;
+            auto* nanoseconds = new juce::DynamicObject();
+
+            for (auto blockSize : blockSizes)
+                nanoseconds->setProperty (describeBlockSize (blockSize), nanosecondsPerChannelSample (settings, tileSize, juce::jmax (0, blockSize)));
+
+            run->setProperty (fused ? "nsPerChannelSample" : "unfusedNsPerChannelSample", juce::var (nanoseconds));
+        }
+
+        runs.add (run);
+    }
+
+    auto* results = new juce::DynamicObject();
+    results->setProperty ("sampleRate", settings.sampleRate);
+    results->setProperty ("channels", settings.numChannels);
+    results->setProperty ("oversampling", settings.overSamplingFactor);
+    results->setProperty ("defaultTileSize", (int) TSEngineSettings::defaultTileSize);
+    results->setProperty ("fusedSliceBytes", (int) TSEngine<float>::fusedSliceBytes);
+    results->setProperty ("runs", runs);
+
+    Bench::writeReport (args, "tiles", results);
+}
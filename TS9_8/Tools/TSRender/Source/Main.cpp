@@ -0,0 +1,400 @@
+#include <JuceHeader.h>
+#include <map>
+#include <thread>
+#include "../../Common/TSToolHelpers.h"
+
+// Offline renderer: streams audio files through TSAudioProcessor without a host.
+// A directory input renders every WAV/FLAC file in it, spread over worker threads
+// that each keep one processor, prepared again only when the sample rate or
+// channel count changes and reset between files.
+
+namespace
+{
+    struct RenderSettings
+    {
+        float drive = -1.0f;          // < 0 leaves the parameter at its default
+        float tone = -1.0f;
+        float level = -1.0f;
+        int oversamplingIndex = -1;   // < 0 renders at the offline maximum quality
+        int oversamplingFilter = -1;
+        int antiAliasing = -1;
+        bool useWaveDigital = false;
+        int blockSize = 8192;
+        bool useClipperTable = false;
+        bool useDoublePrecision = false;
+        juce::String outputExtension; // empty keeps the input's format
+    };
+
+    void applySettings (TSAudioProcessor& processor, const RenderSettings& settings)
+    {
+        if (settings.drive >= 0.0f)  TSTools::setParameter (processor, "drive", settings.drive);
+        if (settings.tone >= 0.0f)   TSTools::setParameter (processor, "tone", settings.tone);
+        if (settings.level >= 0.0f)  TSTools::setParameter (processor, "level", settings.level);
+
+        if (settings.oversamplingIndex >= 0)
+        {
+            TSTools::setParameter (processor, "oversampling", float (settings.oversamplingIndex));
+            TSTools::setParameter (processor, "offlineQuality", 0.0f);
+        }
+
+        if (settings.oversamplingFilter >= 0)
+            TSTools::setParameter (processor, "oversamplingFilter", float (settings.oversamplingFilter));
+
+        if (settings.antiAliasing >= 0)
+            TSTools::setParameter (processor, "clipperAntiAliasing", float (settings.antiAliasing));
+
+        TSTools::setParameter (processor, "driveModel", settings.useWaveDigital ? 1.0f : 0.0f);
+    }
+
+    // One processor and its buffers, prepared once and reused for every file with
+    // the same sample rate and channel count, reset between files
+    class Renderer
+    {
+    public:
+        explicit Renderer (const RenderSettings& renderSettings)  : settings (renderSettings)
+        {
+            formatManager.registerBasicFormats();
+            processor.setUseClipperTable (settings.useClipperTable);
+            applySettings (processor, settings);
+        }
+
+        // Renders one file, returns an error message or an empty string
+        juce::String render (const juce::File& inputFile, const juce::File& outputFile)
+        {
+            std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (inputFile));
+
+            if (reader == nullptr)
+                return "cannot read " + inputFile.getFullPathName();
+
+            const auto numChannels = int (reader->numChannels);
+            const auto sampleRate = reader->sampleRate;
+            const auto blockSize = settings.blockSize;
+
+            if (numChannels != preparedChannels || sampleRate != preparedRate)
+            {
+                if (! TSTools::setChannelCount (processor, numChannels))
+                    return "unsupported channel count " + juce::String (numChannels);
+
+                TSTools::prepare (processor, sampleRate, blockSize, true,
+                                  settings.useDoublePrecision ? juce::AudioProcessor::doublePrecision
+                                                              : juce::AudioProcessor::singlePrecision);
+
+                buffer.setSize (numChannels, blockSize);
+                doubleBuffer.setSize (settings.useDoublePrecision ? numChannels : 0, blockSize);
+                preparedChannels = numChannels;
+                preparedRate = sampleRate;
+            }
+            else
+            {
+                // Nothing of the last file may ring into this one
+                processor.reset();
+            }
+
+            auto* format = formatManager.findFormatForFileExtension (outputFile.getFileExtension());
+
+            if (format == nullptr)
+                return "unknown output format " + outputFile.getFileExtension();
+
+            outputFile.deleteFile();
+            auto outputStream = outputFile.createOutputStream();
+
+            if (outputStream == nullptr)
+                return "cannot write " + outputFile.getFullPathName();
+
+            auto possibleDepths = format->getPossibleBitDepths();
+            const auto bitsPerSample = possibleDepths.contains (int (reader->bitsPerSample)) ? int (reader->bitsPerSample)
+                                                                                            : possibleDepths.getLast();
+
+            std::unique_ptr<juce::AudioFormatWriter> writer (format->createWriterFor (outputStream.get(), sampleRate,
+                                                                                      (unsigned int) numChannels,
+                                                                                      bitsPerSample, reader->metadataValues, 0));
+            if (writer == nullptr)
+                return "cannot create a writer for " + outputFile.getFullPathName();
+
+            outputStream.release(); // now owned by the writer
+
+            // The latency is trimmed from the start and flushed out with silence at the end,
+            // so the output lines up sample for sample with the input.
+            const auto latency = juce::int64 (processor.getLatencySamples());
+            const auto totalLength = reader->lengthInSamples;
+            juce::MidiBuffer midi;
+
+            for (juce::int64 position = 0; position < totalLength + latency; position += blockSize)
+            {
+                const auto numSamples = int (juce::jmin (juce::int64 (blockSize), totalLength + latency - position));
+
+                buffer.clear();
+
+                if (position < totalLength)
+                    reader->read (&buffer, 0, int (juce::jmin (juce::int64 (numSamples), totalLength - position)), position, true, true);
+
+                juce::AudioBuffer<float> block (buffer.getArrayOfWritePointers(), numChannels, numSamples);
+
+                // Files are read and written as float either way, double only covers the processing
+                if (settings.useDoublePrecision)
+                {
+                    juce::AudioBuffer<double> doubleBlock (doubleBuffer.getArrayOfWritePointers(), numChannels, numSamples);
+                    doubleBlock.makeCopyOf (block, true);
+                    processor.processBlock (doubleBlock, midi);
+                    block.makeCopyOf (doubleBlock, true);
+                }
+                else
+                {
+                    processor.processBlock (block, midi);
+                }
+
+                const auto skip = int (juce::jlimit (juce::int64 (0), juce::int64 (numSamples), latency - position));
+
+                if (! writer->writeFromAudioSampleBuffer (block, skip, numSamples - skip))
+                    return "write failed for " + outputFile.getFullPathName();
+            }
+
+            return {};
+        }
+
+    private:
+        const RenderSettings& settings;
+        juce::AudioFormatManager formatManager;
+        TSAudioProcessor processor;
+        juce::AudioBuffer<float> buffer;
+        juce::AudioBuffer<double> doubleBuffer;
+        double preparedRate = 0.0;
+        int preparedChannels = 0;
+    };
+
+    juce::File getOutputFileFor (const juce::File& inputFile, const juce::File& outputDirectory, const RenderSettings& settings)
+    {
+        const auto extension = settings.outputExtension.isNotEmpty() ? settings.outputExtension : inputFile.getFileExtension();
+        return outputDirectory.getChildFile (inputFile.getFileNameWithoutExtension() + extension);
+    }
+
+    RenderSettings parseSettings (const juce::ArgumentList& args)
+    {
+        RenderSettings settings;
+
+        auto readUnitValue = [&args] (const char* option, float& value)
+        {
+            if (args.containsOption (option))
+            {
+                value = args.getValueForOption (option).getFloatValue();
+
+                if (value < 0.0f || value > 1.0f)
+                    juce::ConsoleApplication::fail (juce::String (option) + " must be between 0 and 1");
+            }
+        };
+
+        readUnitValue ("--drive", settings.drive);
+        readUnitValue ("--tone", settings.tone);
+        readUnitValue ("--level", settings.level);
+
+        if (args.containsOption ("--oversampling"))
+        {
+            settings.oversamplingIndex = TSTools::getOversamplingIndex (args.getValueForOption ("--oversampling").getIntValue());
+
+            if (settings.oversamplingIndex < 0)
+                juce::ConsoleApplication::fail ("--oversampling must be 1, 2, 4, 8 or 16");
+        }
+
+        if (args.containsOption ("--filter"))
+        {
+            const auto filter = args.getValueForOption ("--filter").toLowerCase();
+
+            if (filter != "iir" && filter != "fir")
+                juce::ConsoleApplication::fail ("--filter must be iir or fir");
+
+            settings.oversamplingFilter = filter == "fir" ? 1 : 0;
+        }
+
+        if (args.containsOption ("--clipper"))
+        {
+            const auto clipper = args.getValueForOption ("--clipper").toLowerCase();
+
+            if (clipper != "analytic" && clipper != "table")
+                juce::ConsoleApplication::fail ("--clipper must be analytic or table");
+
+            settings.useClipperTable = clipper == "table";
+        }
+
+        if (args.containsOption ("--adaa"))
+        {
+            settings.antiAliasing = args.getValueForOption ("--adaa").getIntValue();
+
+            if (settings.antiAliasing < 0 || settings.antiAliasing > 2)
+                juce::ConsoleApplication::fail ("--adaa must be 0, 1 or 2");
+        }
+
+        if (args.containsOption ("--drive-model"))
+        {
+            const auto model = args.getValueForOption ("--drive-model").toLowerCase();
+
+            if (model != "filter" && model != "wdf")
+                juce::ConsoleApplication::fail ("--drive-model must be filter or wdf");
+
+            settings.useWaveDigital = model == "wdf";
+        }
+
+        if (args.containsOption ("--precision"))
+        {
+            const auto precision = args.getValueForOption ("--precision").toLowerCase();
+
+            if (precision != "float" && precision != "double")
+                juce::ConsoleApplication::fail ("--precision must be float or double");
+
+            settings.useDoublePrecision = precision == "double";
+        }
+
+        if (args.containsOption ("--block"))
+            settings.blockSize = juce::jlimit (16, 1 << 16, args.getValueForOption ("--block").getIntValue());
+
+        if (args.containsOption ("--format"))
+            settings.outputExtension = "." + args.getValueForOption ("--format").toLowerCase().trimCharactersAtStart (".");
+
+        return settings;
+    }
+
+    void renderBatch (const juce::File& inputDirectory, const juce::File& outputDirectory,
+                      const RenderSettings& settings, int numThreads)
+    {
+        const auto inputFiles = inputDirectory.findChildFiles (juce::File::findFiles, false, "*.wav;*.flac");
+
+        if (inputFiles.isEmpty())
+            juce::ConsoleApplication::fail ("no .wav or .flac files in " + inputDirectory.getFullPathName());
+
+        // With --format, a.wav and a.flac would both write a.<format> at once
+        std::map<juce::String, juce::File> outputOwners;
+
+        for (auto& inputFile : inputFiles)
+        {
+            const auto path = getOutputFileFor (inputFile, outputDirectory, settings).getFullPathName();
+            const auto key = juce::File::areFileNamesCaseSensitive() ? path : path.toLowerCase();
+            const auto owner = outputOwners.emplace (key, inputFile);
+
+            if (! owner.second)
+                juce::ConsoleApplication::fail (owner.first->second.getFileName() + " and " + inputFile.getFileName()
+                                                  + " would both render to " + path);
+        }
+
+        if (! outputDirectory.createDirectory())
+            juce::ConsoleApplication::fail ("cannot create " + outputDirectory.getFullPathName());
+
+        numThreads = juce::jmin (numThreads, inputFiles.size());
+
+        juce::CriticalSection outputLock;
+        std::atomic<int> nextFile { 0 }, numFailed { 0 };
+        const auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+        // Each worker keeps its own processor and takes the next file until none are left
+        auto work = [&]
+        {
+            Renderer renderer (settings);
+
+            for (int index; (index = nextFile++) < inputFiles.size();)
+            {
+                const auto& inputFile = inputFiles.getReference (index);
+                const auto outputFile = getOutputFileFor (inputFile, outputDirectory, settings);
+                const auto error = renderer.render (inputFile, outputFile);
+
+                const juce::ScopedLock sl (outputLock);
+
+                if (error.isEmpty())
+                {
+                    std::cout << "rendered " << outputFile.getFullPathName() << std::endl;
+                }
+                else
+                {
+                    ++numFailed;
+                    std::cerr << "failed: " << error << std::endl;
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+
+        for (int i = 1; i < numThreads; ++i)
+            workers.emplace_back (work);
+
+        work();
+
+        for (auto& worker : workers)
+            worker.join();
+
+        const auto seconds = (juce::Time::getMillisecondCounterHiRes() - startTime) * 0.001;
+        std::cout << inputFiles.size() - numFailed.load() << " of " << inputFiles.size() << " files in "
+                  << juce::String (seconds, 2) << " s on " << numThreads << " threads" << std::endl;
+
+        if (numFailed > 0)
+            juce::ConsoleApplication::fail (juce::String (numFailed.load()) + " files failed");
+    }
+
+    void runRender (const juce::ArgumentList& args)
+    {
+        juce::File input;
+
+        for (auto& argument : args.arguments)
+        {
+            if (! argument.isOption())
+            {
+                input = argument.resolveAsFile();
+                break;
+            }
+        }
+
+        if (input == juce::File())
+            juce::ConsoleApplication::fail ("no input file or directory given");
+
+        const auto settings = parseSettings (args);
+
+        if (input.isDirectory())
+        {
+            if (! args.containsOption ("--output"))
+                juce::ConsoleApplication::fail ("batch mode needs --output=<directory>");
+
+            const auto numThreads = args.containsOption ("--threads")
+                                  ? juce::jmax (1, args.getValueForOption ("--threads").getIntValue())
+                                  : juce::SystemStats::getNumCpus();
+
+            renderBatch (input, juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--output")),
+                         settings, numThreads);
+            return;
+        }
+
+        if (! input.existsAsFile())
+            juce::ConsoleApplication::fail ("cannot find " + input.getFullPathName());
+
+        const auto outputFile = args.containsOption ("--output")
+                              ? juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--output"))
+                              : input.getSiblingFile (input.getFileNameWithoutExtension() + "_ts")
+                                     .withFileExtension (settings.outputExtension.isNotEmpty() ? settings.outputExtension
+                                                                                               : input.getFileExtension());
+
+        const auto error = Renderer (settings).render (input, outputFile);
+
+        if (error.isNotEmpty())
+            juce::ConsoleApplication::fail (error);
+
+        std::cout << "rendered " << outputFile.getFullPathName() << std::endl;
+    }
+}
+
+int main (int argc, char* argv[])
+{
+    // The processor's parameter state and async updates expect a message manager to exist
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ConsoleApplication app;
+    app.addHelpCommand ("--help|-h", "Usage:", true);
+
+    app.addDefaultCommand ({ "",
+                             "<file or directory> [--output=<file or directory>] [--drive=0..1] [--tone=0..1] [--level=0..1]\n"
+                             "    [--oversampling=1|2|4|8|16] [--filter=iir|fir] [--clipper=analytic|table] [--adaa=0|1|2]\n"
+                             "    [--drive-model=filter|wdf] [--block=N] [--precision=float|double] [--format=wav|flac] [--threads=N]",
+                             "Renders audio files through the TubeSchemer processor",
+                             "A single file is written next to the input as <name>_ts unless --output is given. A directory renders every\n"
+                             "WAV/FLAC file in it into the --output directory on --threads workers (all cores by default), each\n"
+                             "reusing one processor. Two inputs that would render to the same output name are an error. Without\n"
+                             "--oversampling the offline maximum quality (16x FIR) is used. --drive-model=wdf renders with the\n"
+                             "wave digital drive stage, which the plugin only runs offline.",
+                             runRender });
+
+    return app.findAndRunCommand (argc, argv);
+}